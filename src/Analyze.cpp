@@ -0,0 +1,185 @@
+#include "Analyze.hpp"
+#include "Board.hpp"
+#include "Epd.hpp"
+#include "Evaluation.hpp"
+#include "ThreadPool.hpp"
+#include "UCI.hpp"
+#include "Parse.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// quotes a string for json, escaping quotes, backslashes and control characters
+static std::string jsonString(const std::string &text) {
+    std::string result = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') result += '\\';
+        if ((unsigned char)c < 0x20) c = ' ';
+        result += c;
+    }
+    return result + "\"";
+}
+
+// quotes a field for csv, quotes inside it are doubled
+static std::string csvString(const std::string &text) {
+    std::string result = "\"";
+    for (char c : text) {
+        if (c == '"') result += '"';
+        result += c;
+    }
+    return result + "\"";
+}
+
+// searches one input line and formats its result, empty if the line holds no position
+static std::string analyzeLine(const std::string &line, size_t lineNumber, const AnalyzeOptions &options,
+                               uint64_t &nodes, bool &analyzed) {
+    analyzed = false;
+
+    EpdEntry entry;
+    if (!Epd::parse(line, entry)) return "";
+
+    Board board;
+    const char *error = nullptr;
+    if (!board.setFen(entry.fen, &error)) {
+        std::cerr << "line " << lineNumber << ": invalid fen (" << error << ")" << std::endl;
+        return "";
+    }
+
+    SearchResult result = Search::analyze(board, options.limits);
+    nodes = result.nodes;
+    analyzed = true;
+
+    // the pv is written out move by move on a copy of the position
+    std::string bestMove = result.bestMove ? moveToString(result.bestMove, board) : "0000";
+    std::string pv;
+    Board pvBoard = board;
+    for (Move move : result.pv) {
+        if (!pv.empty()) pv += ' ';
+        pv += moveToString(move, pvBoard);
+        pvBoard.makeMove(move);
+    }
+
+    std::string id = entry.operation("id");
+    std::ostringstream out;
+
+    if (options.csv) {
+        out << lineNumber << ',' << csvString(id) << ',' << csvString(entry.fen) << ',' << bestMove << ','
+            << result.score << ',' << result.mateIn << ',' << result.depth << ',' << result.nodes << ','
+            << result.timeMs << ',' << csvString(pv);
+    } else {
+        out << "{\"line\": " << lineNumber << ", \"id\": " << jsonString(id) << ", \"fen\": " << jsonString(entry.fen)
+            << ", \"bestmove\": \"" << bestMove << "\", \"score\": " << result.score << ", \"mate\": " << result.mateIn
+            << ", \"depth\": " << result.depth << ", \"nodes\": " << result.nodes << ", \"time\": " << result.timeMs
+            << ", \"pv\": \"" << pv << "\"}";
+    }
+
+    return out.str();
+}
+
+int Analyze::run(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "usage: nice.exe analyze <positions|-> [output|-] [depth N] [nodes N] [movetime ms] [threads N] [hash MB] [format json|csv]" << std::endl;
+        return 1;
+    }
+
+    AnalyzeOptions options;
+    options.inputPath = argv[2];
+
+    // options come in name value pairs, so an even argument count means an output path was given
+    int i = 3;
+    if (argc % 2 == 0) options.outputPath = argv[i++];
+
+    for (; i + 1 < argc; i += 2) {
+        std::string name = argv[i];
+        std::string value = argv[i + 1];
+
+        bool valid = true;
+        if (name == "depth") valid = parseOption(name, value, 0, MAX_PLY, options.limits.depth);
+        else if (name == "nodes") valid = parseOption(name, value, (uint64_t)0, UINT64_MAX, options.limits.nodes);
+        else if (name == "movetime") valid = parseOption(name, value, (int64_t)0, INT64_MAX, options.limits.timeMs);
+        else if (name == "threads") valid = parseOption(name, value, 0, 128, options.threads);
+        else if (name == "hash") valid = parseOption(name, value, 0, 1024, options.hash);
+        else if (name == "format") options.csv = (value == "csv");
+        else std::cerr << "unknown option " << name << std::endl;
+        if (!valid) return 1;
+    }
+
+    if (!options.limits.depth && !options.limits.nodes && !options.limits.timeMs) options.limits.depth = ANALYZE_DEPTH;
+    int threads = options.threads > 0 ? options.threads : (int)std::max(1u, std::thread::hardware_concurrency());
+
+    std::ifstream inputFile;
+    if (options.inputPath != "-") {
+        inputFile.open(options.inputPath);
+        if (!inputFile) {
+            std::cerr << "could not read " << options.inputPath << std::endl;
+            return 1;
+        }
+    }
+    std::istream &input = (options.inputPath == "-") ? std::cin : inputFile;
+
+    std::ofstream outputFile;
+    if (options.outputPath != "-") {
+        outputFile.open(options.outputPath);
+        if (!outputFile) {
+            std::cerr << "could not write " << options.outputPath << std::endl;
+            return 1;
+        }
+    }
+    std::ostream &output = (options.outputPath == "-") ? std::cout : outputFile;
+
+    if (options.csv) output << "line,id,fen,bestmove,score,mate,depth,nodes,time_ms,pv\n";
+
+    Evaluation::setCacheSize(options.hash);
+
+    size_t lineNumber = 0, analyzed = 0;
+    uint64_t totalNodes = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    // lines are read a batch at a time so the input can be streamed, each batch is written in order once it is done
+    ThreadPool pool(threads);
+    std::vector<std::string> lines, results;
+    std::vector<uint64_t> nodes;
+    std::vector<char> done;
+    std::string line;
+
+    while (input) {
+        lines.clear();
+        while ((int)lines.size() < threads * ANALYZE_BATCH && std::getline(input, line)) lines.push_back(line);
+        if (lines.empty()) break;
+
+        results.assign(lines.size(), "");
+        nodes.assign(lines.size(), 0);
+        done.assign(lines.size(), 0);
+
+        for (size_t n = 0; n < lines.size(); n++) {
+            pool.submit([&, n, number = lineNumber + n + 1] {
+                bool ok;
+                results[n] = analyzeLine(lines[n], number, options, nodes[n], ok);
+                done[n] = ok;
+            });
+        }
+        pool.wait();
+        lineNumber += lines.size();
+
+        for (size_t n = 0; n < lines.size(); n++) {
+            if (!done[n]) continue;
+            output << results[n] << '\n';
+            analyzed++;
+            totalNodes += nodes[n];
+        }
+        output.flush();
+    }
+
+    double seconds = std::max(1e-9, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    std::cerr << "analyzed " << analyzed << " positions in " << seconds << "s, "
+              << (uint64_t)(analyzed / seconds) << " positions/s, "
+              << (uint64_t)(totalNodes / seconds) << " nodes/s, "
+              << threads << " threads" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef CHESS_ANALYZE_HPP
+#define CHESS_ANALYZE_HPP
+
+#include "Search.hpp"
+#include <string>
+
+// search depth when no limit is given
+#define ANALYZE_DEPTH 6
+
+// positions read from the input before they are handed to the workers, per thread
+#define ANALYZE_BATCH 16
+
+struct AnalyzeOptions {
+    std::string inputPath;          // "-" reads stdin
+    std::string outputPath = "-";   // "-" writes to stdout
+    SearchLimits limits;
+    int threads = 0;                // 0 = all cores
+    int hash = 4;                   // eval cache per thread in MB
+    bool csv = false;               // json lines otherwise
+};
+
+class Analyze {
+    public:
+        // entry point for "nice.exe analyze <positions|-> [output|-] [depth N] [nodes N] [movetime ms] [threads N] [hash MB] [format json|csv]"
+        // every fen or epd line is searched on its own worker, results are written in input order
+        static int run(int argc, char* argv[]);
+};
+
+#endif
@@ -0,0 +1,199 @@
+#include "Bench.hpp"
+#include "Board.hpp"
+#include "MoveGen.hpp"
+#include "Evaluation.hpp"
+#include "PackedPosition.hpp"
+#include "Search.hpp"
+#include "ThreadPool.hpp"
+#include "Parse.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
+
+// openings, middlegames and endgames (including a stalemate and a checkmate), keep the list fixed or the signature changes
+static const char* benchPositions[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+    "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+    "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/8 b - - 0 1",
+    "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+    "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+    "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+    "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+    "8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+    "8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+    "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+    "6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+    "r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 1",
+    "8/8/8/8/8/6k1/6p1/6K1 w - - 0 1",
+    "7k/7P/6K1/8/3B4/8/8/8 b - - 0 1",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "rnbqkb1r/pp1p1ppp/4pn2/2p5/2PP4/2N5/PP2PPPP/R1BQKBNR w KQkq - 0 4",
+    "r1bqk2r/pppp1ppp/2n2n2/2b1p3/2B1P3/2N2N2/PPPP1PPP/R1BQK2R w KQkq - 6 5",
+    "rnbqk2r/ppp1bppp/4pn2/3p4/2PP4/2N2N2/PP2PPPP/R1BQKB1R w KQkq - 4 5",
+    "rnbqkb1r/pp2pppp/3p1n2/8/3NP3/8/PPP2PPP/RNBQKB1R w KQkq - 1 5",
+    "rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkbnr/ppp1pppp/8/3p4/3P4/8/PPP1PPPP/RNBQKBNR w KQkq - 0 2",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4",
+    "rnb1kbnr/pp1ppppp/8/q1p5/3P4/2N5/PPP1PPPP/R1BQKBNR w KQkq - 2 3",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "2r3k1/5pp1/p3p2p/1p1pP3/3P1P2/P1R3P1/1P4KP/8 w - - 0 30",
+    "8/5pk1/6p1/7p/7P/5PK1/6P1/8 w - - 0 45",
+    "4k3/8/8/8/8/8/4P3/4K3 w - - 0 1",
+    "8/8/4k3/8/2R5/8/4K3/8 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "2kr3r/ppp2ppp/2n5/2b1p3/4P1b1/2NP1N2/PPP2PPP/R1B1KB1R w KQ - 2 9",
+    "r2q1rk1/pb1nbppp/1pp1pn2/3p4/2PP4/1PNBPN2/PB3PPP/R2Q1RK1 w - - 2 11",
+    "1k1r4/pp1b1R2/3q2pp/4p3/2B5/4Q3/PPP2B2/2K5 b - - 0 1",
+    "3rr1k1/pp3pp1/1qn2np1/8/3p4/PP1R1P2/2P1NQPP/R1B3K1 b - - 0 1",
+    "5rk1/pp3ppp/8/2p5/2P5/1P4P1/P4P1P/3R2K1 b - - 0 25"
+};
+
+// positions from random games, every position after the opening plies is kept
+static std::vector<PackedPosition> randomPositions(size_t count, uint32_t seed) {
+    std::vector<PackedPosition> positions;
+    positions.reserve(count);
+    std::mt19937 rng(seed);
+
+    while (positions.size() < count) {
+        Board board;
+        for (int ply = 0; ply < 120 && positions.size() < count; ++ply) {
+            std::vector<Move> moves = MoveGen::generateLegalMoves(board);
+            if (moves.empty()) break;
+
+            board.makeMove(moves[rng() % moves.size()]);
+            if (ply >= 8) positions.push_back(PackedPosition::pack(board));
+        }
+    }
+
+    return positions;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int Bench::evalBatch(int argc, char* argv[]) {
+    size_t count = 1000000;
+    int threads = 0;
+
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string name = argv[i];
+        std::string value = argv[i + 1];
+
+        bool ok = true;
+        if (name == "positions") ok = parseOption(name, value, (size_t)1, (size_t)100000000, count);
+        else if (name == "threads") ok = parseOption(name, value, 0, 128, threads);
+        else std::cout << "unknown option " << name << std::endl;
+        if (!ok) return 1;
+    }
+    if (threads <= 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<PackedPosition> positions = randomPositions(count, 1);
+    std::vector<int> expected(count), scores(count);
+
+    // the per board path, as used when labelling positions one at a time (without the eval cache)
+    Evaluation::setCacheSize(0);
+    Board board;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        positions[i].unpack(board);
+        int score = Evaluation::evaluate(board);
+        expected[i] = (positions[i].sideToMove() == WHITE) ? score : -score;
+    }
+    double perBoard = secondsSince(start);
+    std::cout << "per board         : " << (uint64_t)(count / perBoard) << " pos/s" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    Evaluation::evaluateBatch(positions.data(), count, scores.data(), 1);
+    double batched = secondsSince(start);
+    std::cout << "batch, 1 thread   : " << (uint64_t)(count / batched) << " pos/s (" << perBoard / batched << "x)" << std::endl;
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < count; ++i) mismatches += scores[i] != expected[i];
+
+    start = std::chrono::steady_clock::now();
+    Evaluation::evaluateBatch(positions.data(), count, scores.data(), threads);
+    double parallel = secondsSince(start);
+    std::cout << "batch, " << threads << " threads  : " << (uint64_t)(count / parallel) << " pos/s (" << perBoard / parallel << "x)" << std::endl;
+
+    for (size_t i = 0; i < count; ++i) mismatches += scores[i] != expected[i];
+
+    if (mismatches) {
+        std::cout << "error: " << mismatches << " batched scores differ from the per board evaluation" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+std::vector<std::string> Bench::positions() {
+    return std::vector<std::string>(std::begin(benchPositions), std::end(benchPositions));
+}
+
+uint64_t Bench::search(int depth, int threads, int hash) {
+    const int count = sizeof(benchPositions) / sizeof(benchPositions[0]);
+    std::vector<uint64_t> nodes(count);
+
+    Evaluation::setCacheSize(hash);
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        // positions run concurrently, each search is single threaded and starts from an empty eval cache,
+        // so the node counts don't depend on the thread count or on which thread ran which position
+        ThreadPool pool(threads);
+        for (int i = 0; i < count; ++i) {
+            pool.submit([i, depth, &nodes] {
+                Evaluation::clearThreadCache();
+                Search::searchPosition(Board(benchPositions[i]), depth, false);
+                nodes[i] = Search::nodes;
+            });
+        }
+        pool.wait();
+    }
+    double seconds = secondsSince(start);
+
+    uint64_t total = 0;
+    for (int i = 0; i < count; ++i) {
+        std::cerr << "position " << i + 1 << "/" << count << " nodes " << nodes[i] << std::endl;
+        total += nodes[i];
+    }
+
+    std::cout << "===========================" << std::endl;
+    std::cout << "Total time (ms) : " << (uint64_t)(seconds * 1000) << std::endl;
+    std::cout << "Nodes searched  : " << total << std::endl;
+    std::cout << "Nodes/second    : " << (uint64_t)(total / std::max(seconds, 1e-9)) << std::endl;
+
+    return total;
+}
+
+int Bench::run(int argc, char* argv[]) {
+    // same ranges as the uci bench command, but a bad value is an error here rather than the default
+    int depth = BENCH_DEPTH, threads = 1, hash = BENCH_HASH;
+    if (argc > 2 && !parseOption("depth", argv[2], 1, MAX_PLY, depth)) return 1;
+    if (argc > 3 && !parseOption("threads", argv[3], 1, 128, threads)) return 1;
+    if (argc > 4 && !parseOption("hash", argv[4], 0, 1024, hash)) return 1;
+
+    search(depth, threads, hash);
+    return 0;
+}
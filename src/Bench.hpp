@@ -0,0 +1,28 @@
+#ifndef CHESS_BENCH_HPP
+#define CHESS_BENCH_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// defaults of "bench", the node count is only a signature for the same depth and hash
+#define BENCH_DEPTH 5
+#define BENCH_HASH 4
+
+class Bench {
+    public:
+        // "nice.exe bench [depth] [threads] [hash]", hash is the eval cache size in MB
+        static int run(int argc, char* argv[]);
+
+        // searches the built in positions and prints the total nodes (the signature of the search), time and nps
+        static uint64_t search(int depth, int threads, int hash);
+
+        // fens of the built in positions (also the corpus of the microbenchmarks)
+        static std::vector<std::string> positions();
+
+        // "nice.exe evalbench [positions N] [threads N]"
+        // compares the batched evaluation with evaluating one Board at a time on random positions
+        static int evalBatch(int argc, char* argv[]);
+};
+
+#endif
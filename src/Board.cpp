@@ -1,108 +1,166 @@
 #include "Board.hpp"
 #include "Move.hpp"
 #include "BitUtils.hpp"
+#include "Zobrist.hpp"
+#include "Profile.hpp"
+#include "NNUE.hpp"
 #include <iostream>
-#include <sstream>
+#include <algorithm>
+#include <array>
+#include <charconv>
 
 
 // default constructor uses start position as starting config
 Board::Board(): Board("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"){}
 
-// will fill respective bitboards
+// will fill respective bitboards, an invalid fen is reported and replaced by the start position
 Board::Board(const std::string &fenConfig) {
+  const char *error = nullptr;
+  if (!setFen(fenConfig, &error)) {
+    std::cerr << "invalid fen (" << error << "): " << fenConfig << std::endl;
+    setFen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+  }
+}
 
-  // convert string to stream for processing
-  std::istringstream ss(fenConfig);
-
-  std::string position, colourStr, castlingStr, epStr;
+Board::~Board(){}
 
-  // extract relevant information from the fen string
-  ss >> position >> colourStr >> castlingStr >> epStr >> halfMoves >> fullMoves;
+static bool isFenSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
 
-  activeColour = (colourStr == "w") ? WHITE : BLACK;
+// takes the next whitespace separated field off the front of the fen, empty once there are none left
+static std::string_view nextField(std::string_view &fen) {
+  size_t start = 0;
+  while (start < fen.size() && isFenSpace(fen[start])) start++;
 
-  initBitBoards(position);
-
-  // Parse Castling Rights to Integer
-    castlingRights = 0;
-    if (castlingStr != "-") {
-        for (char c : castlingStr) {
-            switch(c) {
-                case 'K': castlingRights |= WK_CA; break;
-                case 'Q': castlingRights |= WQ_CA; break;
-                case 'k': castlingRights |= BK_CA; break;
-                case 'q': castlingRights |= BQ_CA; break;
-            }
-        }
-    }
-
-    // 3. Parse En Passant Target to Integer
-    if (epStr != "-") {
-        ep_target = convertCordToSquare(epStr);
-    } else {
-        ep_target = NO_SQ;
-    }
+  size_t end = start;
+  while (end < fen.size() && !isFenSpace(fen[end])) end++;
 
+  std::string_view field = fen.substr(start, end - start);
+  fen.remove_prefix(end);
+  return field;
 }
 
-Board::~Board(){}
-
-void Board::initBitBoards(const std::string &pos){
-
-  // initialize the bitboards to all zeros
-  for (size_t i = 0; i < 16; i++) {
-    bitboards[i] = 0;
-  }
+static bool parseNumber(std::string_view field, int &value) {
+  auto [end, ec] = std::from_chars(field.data(), field.data() + field.size(), value);
+  return ec == std::errc() && end == field.data() + field.size() && value >= 0;
+}
 
-  // Initialize boardArr to NO_PIECE
-  for (int i = 0; i < 64; i++) {
-      boardArr[i] = NO_PIECE;
-  }
+// piece code of every fen piece letter, NO_PIECE for anything else
+static constexpr std::array<uint8_t, 256> fenPieces = [] {
+  std::array<uint8_t, 256> table{};
+  table.fill(NO_PIECE);
+  const char letters[] = "PNBRQKpnbrqk";
+  for (int piece = WP; piece <= BK; piece++) table[(unsigned char)letters[piece]] = piece;
+  return table;
+}();
+
+bool Board::setFen(std::string_view fen, const char **error) {
+  auto fail = [&](const char *message) {
+    if (error) *error = message;
+    return false;
+  };
+
+  // everything is parsed into locals first so a bad fen leaves the board as it was,
+  // the bitboards and piece keys are filled in as the pieces are read
+  int squares[64];
+  std::fill(squares, squares + 64, (int)NO_PIECE);
+  U64 pieces[16] = {};
+  U64 key = 0;
+
+  std::string_view field = nextField(fen);
+  if (field.empty()) return fail("empty fen");
 
   int rank = 7; // Start at Top Rank
   int file = 0; // Start at File A
 
-  // for each character in the fen string
-  for (char c : pos) {
+  for (char c : field) {
     if (c == '/') {
-      rank--; // Move down one rank
-      file = 0; // Reset file
-      continue;
-    }
-
-    if (std::isdigit(c)) {
-      int skips = c - '0';
-      file += skips; // Skip empty squares
+      if (file != 8) return fail("rank without 8 squares");
+      if (rank == 0) return fail("more than 8 ranks");
+      rank--;
+      file = 0;
+    } else if (c >= '1' && c <= '8') {
+      file += c - '0'; // Skip empty squares
+      if (file > 8) return fail("rank without 8 squares");
     } else {
-      // Calculate Square Index: A1=0, H8=63
-      int square = rank * 8 + file;
-      
-      int piece = NO_PIECE;
+      int piece = fenPieces[(unsigned char)c];
+      if (piece == NO_PIECE) return fail("unknown piece");
+      if (file == 8) return fail("rank without 8 squares");
+
+      int square = rank * 8 + file++;
+      squares[square] = piece;
+      pieces[piece] |= 1ULL << square;
+      key ^= zobristKeys.pieces[piece][square];
+    }
+  }
+  if (rank != 0) return fail("fewer than 8 ranks");
+  if (file != 8) return fail("rank without 8 squares");
+
+  if (popCount(pieces[WK]) != 1 || popCount(pieces[BK]) != 1) return fail("each side needs exactly one king");
+
+  // a legal position never has more, and packed records only have room for 32
+  U64 occupied = 0;
+  for (int piece = WP; piece <= BK; piece++) occupied |= pieces[piece];
+  if (popCount(occupied) > 32) return fail("more than 32 pieces");
+  if ((pieces[WP] | pieces[BP]) & 0xFF000000000000FFULL) return fail("pawn on the first or last rank");
+
+  field = nextField(fen);
+  int colour;
+  if (field == "w") colour = WHITE;
+  else if (field == "b") colour = BLACK;
+  else return fail("side to move isn't w or b");
+
+  field = nextField(fen);
+  if (field.empty()) return fail("missing castling rights");
+
+  int castling = 0;
+  if (field != "-") {
+    for (char c : field) {
+      int right = 0;
       switch(c) {
-          case 'P': piece = WP; break;
-          case 'N': piece = WN; break;
-          case 'B': piece = WB; break;
-          case 'R': piece = WR; break;
-          case 'Q': piece = WQ; break;
-          case 'K': piece = WK; break;
-          case 'p': piece = BP; break;
-          case 'n': piece = BN; break;
-          case 'b': piece = BB; break;
-          case 'r': piece = BR; break;
-          case 'q': piece = BQ; break;
-          case 'k': piece = BK; break;
+          case 'K': right = WK_CA; break;
+          case 'Q': right = WQ_CA; break;
+          case 'k': right = BK_CA; break;
+          case 'q': right = BQ_CA; break;
+          default: return fail("invalid castling rights");
       }
+      if (castling & right) return fail("invalid castling rights");
+      castling |= right;
+    }
+  }
 
-      if (piece != NO_PIECE) {
-          setBit(bitboards[piece], square);
-          boardArr[square] = piece;
-      }
-      
-      file++; // Move to next file
+  // move generation trusts the rights, so the king and rook have to be where castling needs them
+  if (((castling & (WK_CA | WQ_CA)) && squares[SQ_E1] != WK) || ((castling & (BK_CA | BQ_CA)) && squares[SQ_E8] != BK)
+      || ((castling & WK_CA) && squares[SQ_H1] != WR) || ((castling & WQ_CA) && squares[SQ_A1] != WR)
+      || ((castling & BK_CA) && squares[SQ_H8] != BR) || ((castling & BQ_CA) && squares[SQ_A8] != BR)) {
+    return fail("castling rights without king and rook on their squares");
+  }
+
+  field = nextField(fen);
+  int epSquare = NO_SQ;
+  if (field.empty()) return fail("missing en passant square");
+  if (field != "-") {
+    if (field.size() != 2 || field[0] < 'a' || field[0] > 'h' || field[1] < '1' || field[1] > '8') {
+      return fail("invalid en passant square");
     }
+    epSquare = (field[1] - '1') * 8 + (field[0] - 'a');
+    if (field[1] != (colour == WHITE ? '6' : '3')) return fail("en passant square on the wrong rank");
+  }
+
+  // the move counters are optional (epd positions leave them out)
+  int halfMoveClock = 0, fullMoveNumber = 1;
+  field = nextField(fen);
+  if (!field.empty()) {
+    if (!parseNumber(field, halfMoveClock)) return fail("invalid halfmove clock");
 
+    field = nextField(fen);
+    if (!field.empty() && !parseNumber(field, fullMoveNumber)) return fail("invalid fullmove number");
   }
+  if (!nextField(fen).empty()) return fail("unexpected text after the fen");
 
+  std::copy(pieces, pieces + 16, bitboards);
+  std::copy(squares, squares + 64, boardArr);
 
   // geneerate occupance bitboards
   bitboards[BLACK_OCC] = bitboards[BP] | bitboards[BN] | bitboards[BB] | bitboards[BR] | bitboards[BQ] | bitboards[BK];
@@ -110,9 +168,69 @@ void Board::initBitBoards(const std::string &pos){
 
   bitboards[ALL_OCC] = bitboards[BLACK_OCC] | bitboards[WHITE_OCC];
 
+  activeColour = colour;
+  castlingRights = castling;
+  ep_target = epSquare;
+  halfMoves = halfMoveClock;
+  fullMoves = fullMoveNumber;
+  // same key computeHash gives, the pieces are already in it
+  key ^= zobristKeys.castling[castling];
+  if (epSquare != NO_SQ) key ^= zobristKeys.enPassant[epSquare % 8];
+  if (colour == BLACK) key ^= zobristKeys.side;
+  hashKey = key;
+
+  return true;
 }
 
-void Board::makeMove(Move m){
+int Board::toFen(char *buffer) const {
+  char *out = buffer;
+
+  for (int rank = 7; rank >= 0; rank--) {
+    int empty = 0;
+    for (int file = 0; file < 8; file++) {
+      int piece = boardArr[rank * 8 + file];
+      if (piece == NO_PIECE) {
+        empty++;
+        continue;
+      }
+      if (empty) *out++ = '0' + empty;
+      empty = 0;
+      *out++ = "PNBRQKpnbrqk"[piece];
+    }
+    if (empty) *out++ = '0' + empty;
+    if (rank) *out++ = '/';
+  }
+
+  *out++ = ' ';
+  *out++ = (activeColour == WHITE) ? 'w' : 'b';
+  *out++ = ' ';
+
+  if (!castlingRights) *out++ = '-';
+  if (castlingRights & WK_CA) *out++ = 'K';
+  if (castlingRights & WQ_CA) *out++ = 'Q';
+  if (castlingRights & BK_CA) *out++ = 'k';
+  if (castlingRights & BQ_CA) *out++ = 'q';
+  *out++ = ' ';
+
+  if (ep_target == NO_SQ) {
+    *out++ = '-';
+  } else {
+    *out++ = 'a' + ep_target % 8;
+    *out++ = '1' + ep_target / 8;
+  }
+
+  *out++ = ' ';
+  out = std::to_chars(out, buffer + MAX_FEN_LENGTH, halfMoves).ptr;
+  *out++ = ' ';
+  out = std::to_chars(out, buffer + MAX_FEN_LENGTH, fullMoves).ptr;
+  *out = '\0';
+
+  return (int)(out - buffer);
+}
+
+void Board::makeMove(Move m, FeatureDelta *delta){
+  PROFILE_SCOPE(PROFILE_MAKE_MOVE);
+
   // extract move data
   int from = fromSq(m);
   int to = toSq(m);
@@ -121,8 +239,20 @@ void Board::makeMove(Move m){
   int capturedPiece = captured(m);
   int promotionPiece = promo(m);
 
+  // take the old castling rights and en passant square out of the hash, they are added back at the end
+  hashKey ^= zobristKeys.castling[castlingRights];
+  if (ep_target != NO_SQ) hashKey ^= zobristKeys.enPassant[ep_target % 8];
+
+  // features to update in the nnue accumulator, written to a scratch delta when the caller keeps none
+  FeatureDelta scratch;
+  if (!delta) delta = &scratch;
+  delta->removedCount = 0;
+  delta->addedCount = 0;
+
   // remove piece from src square
   bitboards[piece] &= ~(1ULL << from);
+  hashKey ^= zobristKeys.pieces[piece][from];
+  delta->removedPiece[delta->removedCount] = piece; delta->removedSquare[delta->removedCount++] = from;
   
   // update mailbox
   boardArr[from] = NO_PIECE;
@@ -143,8 +273,12 @@ void Board::makeMove(Move m){
       int capSq = (activeColour == WHITE) ? to - 8: to + 8;
       bitboards[capturedPiece] &= ~(1ULL << capSq);
       boardArr[capSq] = NO_PIECE;
+      hashKey ^= zobristKeys.pieces[capturedPiece][capSq];
+      delta->removedPiece[delta->removedCount] = capturedPiece; delta->removedSquare[delta->removedCount++] = capSq;
     } else {
       bitboards[capturedPiece] &= ~(1ULL << to);
+      hashKey ^= zobristKeys.pieces[capturedPiece][to];
+      delta->removedPiece[delta->removedCount] = capturedPiece; delta->removedSquare[delta->removedCount++] = to;
     }
   }
 
@@ -176,6 +310,9 @@ void Board::makeMove(Move m){
       // Move the Rook on the Bitboard
       bitboards[rookPiece] &= ~(1ULL << rookFrom); // Remove from corner
       bitboards[rookPiece] |= (1ULL << rookTo);   // Place next to King
+      hashKey ^= zobristKeys.pieces[rookPiece][rookFrom] ^ zobristKeys.pieces[rookPiece][rookTo];
+      delta->removedPiece[delta->removedCount] = rookPiece; delta->removedSquare[delta->removedCount++] = rookFrom;
+      delta->addedPiece[delta->addedCount] = rookPiece; delta->addedSquare[delta->addedCount++] = rookTo;
 
       // Update the Mailbox
       boardArr[rookFrom] = NO_PIECE;        // Empty the corner
@@ -211,9 +348,13 @@ void Board::makeMove(Move m){
   if (flags & PROMOTION) {
     bitboards[promotionPiece] |= (1ULL << to);
     boardArr[to] = promotionPiece; // update mailbox with promoted piece
+    hashKey ^= zobristKeys.pieces[promotionPiece][to];
+    delta->addedPiece[delta->addedCount] = promotionPiece; delta->addedSquare[delta->addedCount++] = to;
   } else {
     bitboards[piece] |= (1ULL << to);
     boardArr[to] = piece;
+    hashKey ^= zobristKeys.pieces[piece][to];
+    delta->addedPiece[delta->addedCount] = piece; delta->addedSquare[delta->addedCount++] = to;
 
   }
 
@@ -230,12 +371,36 @@ void Board::makeMove(Move m){
   // update active colour
   activeColour = (activeColour == WHITE) ? BLACK : WHITE;
 
+  // add the new castling rights, en passant square and side to move to the hash
+  hashKey ^= zobristKeys.castling[castlingRights] ^ zobristKeys.side;
+  if (ep_target != NO_SQ) hashKey ^= zobristKeys.enPassant[ep_target % 8];
+
   // update occupancy bitboards
   bitboards[BLACK_OCC] = bitboards[BP] | bitboards[BN] | bitboards[BB] | bitboards[BR] | bitboards[BQ] | bitboards[BK];
   bitboards[WHITE_OCC] = bitboards[WP] | bitboards[WN] | bitboards[WB] | bitboards[WR] | bitboards[WQ] | bitboards[WK];
 
   bitboards[ALL_OCC] = bitboards[BLACK_OCC] | bitboards[WHITE_OCC];
-  
+}
+
+// hash the position from scratch, makeMove keeps hashKey up to date incrementally
+U64 Board::computeHash() const {
+  U64 key = 0;
+
+  for (int square = 0; square < 64; square++) {
+    if (boardArr[square] != NO_PIECE) key ^= zobristKeys.pieces[boardArr[square]][square];
+  }
+
+  key ^= zobristKeys.castling[castlingRights];
+  if (ep_target != NO_SQ) key ^= zobristKeys.enPassant[ep_target % 8];
+  if (activeColour == BLACK) key ^= zobristKeys.side;
+
+  return key;
+}
+
+bool Board::insufficientMaterial() const {
+  U64 pawnsAndMajors = bitboards[WP] | bitboards[BP] | bitboards[WR] | bitboards[BR] | bitboards[WQ] | bitboards[BQ];
+  U64 minors = bitboards[WN] | bitboards[BN] | bitboards[WB] | bitboards[BB];
+  return !pawnsAndMajors && popCount(minors) <= 1;
 }
 
 // Converts an index (0-63) to algebraic notation (e.g., 60 -> "e8")
@@ -4,19 +4,31 @@
 
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <cstdint>
 
 #include "Types.hpp"
 #include "Move.hpp"
 
+struct FeatureDelta;
 
+// buffer size toFen needs, the longest fen with its move counters fits with room to spare
+#define MAX_FEN_LENGTH 128
 
 class Board {
   friend class MoveGen;
   friend class Perft;
   friend class Evaluation;
   friend class Search;
+  friend class NNUE;
+  friend class Trainer;
+  friend class Tuner;
+  friend struct PackedPosition;
+  friend class Polyglot;
+  friend class Tablebase;
+  friend class TbGen;
+  friend class Syzygy;
   private:
     U64 bitboards[16]; // represents the entrire board with an array of bitboards
     int activeColour;
@@ -24,13 +36,10 @@ class Board {
     int ep_target;
     int halfMoves;
     int fullMoves;
+    U64 hashKey; // zobrist key of the position
 
     int boardArr[64]; 
 
-    void initBitBoards(const std::string &pos);
-
-    
-
   public:
 
     // defualt contructor
@@ -41,9 +50,28 @@ class Board {
 
     // destructor
     ~Board();
+
+    // loads a fen (the move counters may be left out), without allocating; an invalid fen leaves the
+    // board unchanged and returns false with error pointing at a short description of the problem
+    bool setFen(std::string_view fen, const char **error = nullptr);
+
+    // writes the fen and a terminating zero into buffer (MAX_FEN_LENGTH chars), returns its length
+    int toFen(char *buffer) const;
     
-    // move a piece form one place to another place
-    void makeMove(Move m);
+    // move a piece form one place to another place, delta (if given) receives the nnue features the move changed
+    void makeMove(Move m, FeatureDelta *delta = nullptr);
+
+    // zobrist key of the current position
+    U64 getHash() const { return hashKey; }
+
+    // piece code on a square (NO_PIECE if it is empty), the side to move and the fifty move counter
+    int pieceOn(int square) const { return boardArr[square]; }
+    int sideToMove() const { return activeColour; }
+    int getHalfMoves() const { return halfMoves; }
+    U64 computeHash() const;
+
+    // only kings left, or a king and a single minor piece against a bare king
+    bool insufficientMaterial() const;
 
     std::string convertSquareToCord(int square) const;
 
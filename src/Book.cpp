@@ -0,0 +1,298 @@
+#include "Book.hpp"
+#include "Board.hpp"
+#include "PackedPosition.hpp"
+#include "Pgn.hpp"
+#include "Polyglot.hpp"
+#include "ThreadPool.hpp"
+#include "UCI.hpp"
+#include "Parse.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+bool Book::open(const std::string &path, const char **error) {
+    close();
+    auto fail = [&](const char *message) {
+        close();
+        if (error) *error = message;
+        return false;
+    };
+
+    // probes jump around the file, reading ahead would only waste the page cache
+    if (!file.open(path, false)) return fail("could not map the file");
+
+    entries = file.size() / POLYGLOT_ENTRY_SIZE;
+    if (!entries) return fail("no entries");
+    if (file.size() % POLYGLOT_ENTRY_SIZE) {
+        std::cerr << "warning: " << path << " ends with a partial entry, it is ignored" << std::endl;
+    }
+    return true;
+}
+
+size_t Book::lowerBound(U64 key) const {
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(file.data());
+    size_t low = 0, high = entries;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (Polyglot::readEntry(data + middle * POLYGLOT_ENTRY_SIZE).key < key) low = middle + 1;
+        else high = middle;
+    }
+    return low;
+}
+
+void Book::close() {
+    file.close();
+    entries = 0;
+}
+
+Move Book::probe(const Board &board, bool best, std::mt19937 &rng) const {
+    if (!entries) return 0;
+
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(file.data());
+    auto entryAt = [&](size_t index) { return Polyglot::readEntry(data + index * POLYGLOT_ENTRY_SIZE); };
+
+    U64 key = Polyglot::key(board);
+    size_t low = lowerBound(key);
+
+    // weights of the moves that are legal here, a book may hold moves of another position with the same key
+    uint32_t total = 0;
+    Move bestMove = 0;
+    uint16_t bestWeight = 0;
+    size_t last = low;
+    for (; last < entries; last++) {
+        PolyglotEntry entry = entryAt(last);
+        if (entry.key != key) break;
+
+        Move move = Polyglot::decodeMove(entry.move, board);
+        if (!move || !entry.weight) continue;
+
+        total += entry.weight;
+        if (!bestMove || entry.weight > bestWeight) {
+            bestMove = move;
+            bestWeight = entry.weight;
+        }
+    }
+    if (best || total == 0) return bestMove;
+
+    uint32_t pick = std::uniform_int_distribution<uint32_t>(0, total - 1)(rng);
+    for (size_t i = low; i < last; i++) {
+        PolyglotEntry entry = entryAt(i);
+        Move move = Polyglot::decodeMove(entry.move, board);
+        if (!move || !entry.weight) continue;
+
+        if (pick < entry.weight) return move;
+        pick -= entry.weight;
+    }
+    return bestMove;
+}
+
+enum BookResults {
+    BOOK_ALL,       // every finished game
+    BOOK_WINS,      // only the moves of the side that won
+    BOOK_NO_LOSSES  // the winner's moves and both sides of drawn games
+};
+
+struct BookMoveKey {
+    U64 key;
+    uint16_t move;
+
+    bool operator==(const BookMoveKey &other) const { return key == other.key && move == other.move; }
+};
+
+struct BookMoveHash {
+    size_t operator()(const BookMoveKey &k) const { return k.key ^ (k.move * 0x9E3779B97F4A7C15ULL); }
+};
+
+struct BookMoveStats {
+    uint32_t games = 0;
+    uint32_t wins = 0;  // for the side that played the move
+    uint32_t draws = 0;
+};
+
+using BookStats = std::unordered_map<BookMoveKey, BookMoveStats, BookMoveHash>;
+
+struct BookOptions {
+    int depth = BOOK_DEPTH;
+    int minGames = BOOK_MIN_GAMES;
+    int results = BOOK_ALL;
+};
+
+struct BookCounters {
+    std::atomic<uint64_t> games{0};
+    std::atomic<uint64_t> unfinished{0}; // no result, they can't weigh the moves
+    std::atomic<uint64_t> invalid{0};    // bad fen or an undecodable move within the book depth
+};
+
+// adds the first plies of one game to the statistics
+static void addGame(const PgnGame &game, const BookOptions &options, BookStats &stats, BookCounters &counters) {
+    counters.games++;
+    if (game.result == RESULT_UNKNOWN) {
+        counters.unfinished++;
+        return;
+    }
+
+    Board board;
+    if (!game.fen.empty() && !board.setFen(game.fen)) {
+        counters.invalid++;
+        return;
+    }
+
+    int plies = std::min<int>(options.depth, (int)game.moves.size());
+    for (int ply = 0; ply < plies; ply++) {
+        Move move = parseSan(game.moves[ply], board);
+        if (!move) {
+            counters.invalid++;
+            return;
+        }
+
+        bool won = game.result == (board.sideToMove() == WHITE ? RESULT_WHITE_WIN : RESULT_BLACK_WIN);
+        bool drawn = game.result == RESULT_DRAW;
+
+        if (options.results == BOOK_ALL || won || (options.results == BOOK_NO_LOSSES && drawn)) {
+            BookMoveStats &entry = stats[BookMoveKey{Polyglot::key(board), Polyglot::encodeMove(move)}];
+            entry.games++;
+            entry.wins += won;
+            entry.draws += drawn;
+        }
+
+        board.makeMove(move);
+    }
+}
+
+int Book::make(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cout << "usage: nice.exe makebook <games.pgn> <book.bin> [depth N] [mingames N] [results all|wins|nolosses] [threads N]" << std::endl;
+        return 1;
+    }
+
+    std::string pgnPath = argv[2];
+    std::string bookPath = argv[3];
+    BookOptions options;
+    int threads = 0;
+
+    for (int i = 4; i + 1 < argc; i += 2) {
+        std::string name = argv[i];
+        std::string value = argv[i + 1];
+
+        if (name == "depth") { if (!parseOption(name, value, 1, INT_MAX, options.depth)) return 1; }
+        else if (name == "mingames") { if (!parseOption(name, value, 1, INT_MAX, options.minGames)) return 1; }
+        else if (name == "threads") { if (!parseOption(name, value, 0, 128, threads)) return 1; }
+        else if (name == "results") {
+            if (value == "all") options.results = BOOK_ALL;
+            else if (value == "wins") options.results = BOOK_WINS;
+            else if (value == "nolosses") options.results = BOOK_NO_LOSSES;
+            else {
+                std::cerr << "unknown results filter " << value << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "unknown option " << name << std::endl;
+        }
+    }
+    if (threads <= 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+
+    PgnReader reader;
+    if (!reader.open(pgnPath)) {
+        std::cerr << "could not read " << pgnPath << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // every thread takes the next chunk until none are left and keeps its own statistics, merged at the end
+    std::vector<std::string_view> chunks = reader.chunks(PGN_CHUNK);
+    std::vector<BookStats> threadStats(threads);
+    std::atomic<size_t> nextChunk{0};
+    BookCounters counters;
+    {
+        ThreadPool pool(threads);
+        for (int t = 0; t < threads; t++) {
+            pool.submit([&, t]() {
+                for (size_t c = nextChunk++; c < chunks.size(); c = nextChunk++) {
+                    if (c + 1 < chunks.size()) reader.prefetch(chunks[c + 1]);
+                    PgnReader::parse(chunks[c], [&](const PgnGame &game) { addGame(game, options, threadStats[t], counters); });
+                }
+            });
+        }
+        pool.wait();
+    }
+    double parseSeconds = std::max(1e-9, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+    BookStats &stats = threadStats[0];
+    for (int t = 1; t < threads; t++) {
+        for (const auto &[key, moveStats] : threadStats[t]) {
+            BookMoveStats &entry = stats[key];
+            entry.games += moveStats.games;
+            entry.wins += moveStats.wins;
+            entry.draws += moveStats.draws;
+        }
+        threadStats[t] = BookStats();
+    }
+
+    // a move needs enough games and at least one point to be worth playing
+    struct Candidate {
+        U64 key;
+        uint16_t move;
+        uint64_t score;
+    };
+    std::vector<Candidate> candidates;
+    for (const auto &[key, moveStats] : stats) {
+        uint64_t score = 2ULL * moveStats.wins + moveStats.draws;
+        if (moveStats.games >= (uint32_t)options.minGames && score > 0) candidates.push_back({key.key, key.move, score});
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+        return a.key != b.key ? a.key < b.key : (a.score != b.score ? a.score > b.score : a.move < b.move);
+    });
+
+    std::ofstream out(bookPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "could not write " << bookPath << std::endl;
+        return 1;
+    }
+
+    // weights only compare moves of the same position, a position whose best score doesn't fit 16 bits is scaled down
+    uint64_t positions = 0;
+    std::vector<unsigned char> buffer;
+    buffer.reserve(candidates.size() * POLYGLOT_ENTRY_SIZE);
+    for (size_t first = 0; first < candidates.size();) {
+        size_t last = first;
+        while (last < candidates.size() && candidates[last].key == candidates[first].key) last++;
+
+        uint64_t best = candidates[first].score;
+        for (size_t i = first; i < last; i++) {
+            uint64_t weight = best > 65535 ? std::max<uint64_t>(1, candidates[i].score * 65535 / best) : candidates[i].score;
+
+            unsigned char bytes[POLYGLOT_ENTRY_SIZE];
+            Polyglot::writeEntry(PolyglotEntry{candidates[i].key, candidates[i].move, (uint16_t)weight, 0}, bytes);
+            buffer.insert(buffer.end(), bytes, bytes + POLYGLOT_ENTRY_SIZE);
+        }
+        positions++;
+        first = last;
+    }
+    out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    if (!out) {
+        std::cerr << "could not write " << bookPath << std::endl;
+        return 1;
+    }
+
+    double seconds = std::max(1e-9, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    uint64_t games = counters.games;
+
+    std::cout << "===========================" << std::endl;
+    std::cout << "Games           : " << games << " (" << counters.unfinished << " without result, " << counters.invalid << " with invalid moves)" << std::endl;
+    std::cout << "Parse (s)       : " << parseSeconds << " (" << (uint64_t)(games / parseSeconds) << " games/s, "
+              << reader.size() / parseSeconds / 1e6 << " MB/s, " << threads << " threads)" << std::endl;
+    std::cout << "Book            : " << positions << " positions, " << candidates.size() << " moves" << std::endl;
+    std::cout << "Time (s)        : " << seconds << " (" << (uint64_t)(games / seconds) << " games/s)" << std::endl;
+    std::cout << "===========================" << std::endl;
+    return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef CHESS_BOOK_HPP
+#define CHESS_BOOK_HPP
+
+#include "MappedFile.hpp"
+#include "Move.hpp"
+#include "Types.hpp"
+#include <cstddef>
+#include <random>
+#include <string>
+
+class Board;
+
+// plies from the start of every game that go into a book
+#define BOOK_DEPTH 20
+
+// a move has to be played in this many games to get into the book
+#define BOOK_MIN_GAMES 3
+
+// pgn text is handed to the parsing threads in pieces of about this many bytes
+#define PGN_CHUNK (4 << 20)
+
+// memory mapped polyglot book, a probe binary searches the mapping so it neither reads the whole file nor allocates
+class Book {
+    public:
+        // false (with the reason in error) if the file can't be mapped or holds no entries
+        bool open(const std::string &path, const char **error = nullptr);
+        void close();
+
+        bool isOpen() const { return entries > 0; }
+        size_t size() const { return entries; }
+
+        // a book move of the position, 0 if it has none; best picks the highest weight,
+        // otherwise the moves are drawn with a probability proportional to their weight
+        Move probe(const Board &board, bool best, std::mt19937 &rng) const;
+
+        // entry point for "nice.exe makebook <games.pgn> <book.bin> [depth N] [mingames N] [results all|wins|nolosses] [threads N]"
+        // counts every position -> move of the games' first plies and writes the moves as a polyglot book
+        // weighted 2 per win and 1 per draw for the side that played them, results picks the games a move is counted from
+        static int make(int argc, char* argv[]);
+
+    private:
+        MappedFile file;
+        size_t entries = 0;
+
+        // first entry with a key not below key
+        size_t lowerBound(U64 key) const;
+};
+
+#endif
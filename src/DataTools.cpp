@@ -0,0 +1,448 @@
+#include "DataTools.hpp"
+#include "Board.hpp"
+#include "Epd.hpp"
+#include "PackedPosition.hpp"
+#include "PackedReader.hpp"
+#include "ThreadPool.hpp"
+#include "Parse.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+// records are handed to the os a block at a time when reading and writing
+#define DATA_BLOCK 65536
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::max(1e-9, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
+
+static int parseResultText(std::string text) {
+    text.erase(std::remove_if(text.begin(), text.end(), [](char c) { return c == ' ' || c == '"' || c == ';' || c == '[' || c == ']'; }), text.end());
+
+    if (text == "1-0" || text == "1.0" || text == "1") return RESULT_WHITE_WIN;
+    if (text == "0-1" || text == "0.0" || text == "0") return RESULT_BLACK_WIN;
+    if (text == "1/2-1/2" || text == "0.5") return RESULT_DRAW;
+    return RESULT_UNKNOWN;
+}
+
+static const char* resultText(int result) {
+    switch (result) {
+        case RESULT_WHITE_WIN: return "1-0";
+        case RESULT_BLACK_WIN: return "0-1";
+        case RESULT_DRAW: return "1/2-1/2";
+    }
+    return "*";
+}
+
+// reads one text line into a record, false if it holds no valid position
+static bool parseTextLine(const std::string &line, PackedPosition &packed) {
+    Board board;
+    int score = 0;
+    int result = RESULT_UNKNOWN;
+
+    size_t first = line.find('|');
+    if (first != std::string::npos) {
+        size_t second = line.find('|', first + 1);
+        if (second == std::string::npos || !board.setFen(std::string_view(line).substr(0, first))) return false;
+
+        score = std::atoi(line.c_str() + first + 1);
+        result = parseResultText(line.substr(second + 1));
+    } else {
+        EpdEntry entry;
+        if (!Epd::parse(line, entry) || !board.setFen(entry.fen)) return false;
+
+        // epd evaluations are from the side to move's point of view
+        std::string ce = entry.operation("ce");
+        if (!ce.empty()) score = (board.sideToMove() == WHITE) ? std::atoi(ce.c_str()) : -std::atoi(ce.c_str());
+        result = parseResultText(entry.operation("c9"));
+    }
+
+    packed = PackedPosition::pack(board, std::clamp(score, -32000, 32000), result);
+    return true;
+}
+
+int DataTools::convert(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cout << "usage: nice.exe convert <input> <output>, one of them a .bin file of packed positions" << std::endl;
+        return 1;
+    }
+
+    std::string inputPath = argv[2];
+    std::string outputPath = argv[3];
+    bool packedInput = PackedReader::isPackedPath(inputPath);
+    bool packedOutput = PackedReader::isPackedPath(outputPath);
+
+    std::ofstream out(outputPath, packedOutput ? std::ios::binary : std::ios::out);
+    if (!out) {
+        std::cerr << "could not write " << outputPath << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t converted = 0, skipped = 0;
+
+    if (packedInput) {
+        PackedReader reader;
+        if (!reader.open(inputPath)) {
+            std::cerr << "could not read " << inputPath << std::endl;
+            return 1;
+        }
+
+        Board board;
+        char fen[MAX_FEN_LENGTH];
+        std::string text;
+
+        for (size_t i = 0; i < reader.size(); i++) {
+            if (i % DATA_BLOCK == 0) reader.prefetch(i + DATA_BLOCK, DATA_BLOCK);
+
+            const PackedPosition &packed = reader[i];
+            if (!packed.valid()) {
+                skipped++;
+                continue;
+            }
+
+            if (packedOutput) {
+                out.write(reinterpret_cast<const char*>(&packed), sizeof(PackedPosition));
+            } else {
+                packed.unpack(board);
+                board.toFen(fen);
+                text.assign(fen);
+                text += " | ";
+                text += std::to_string(packed.score);
+                text += " | ";
+                text += resultText(packed.result());
+                text += '\n';
+                out << text;
+            }
+            converted++;
+        }
+    } else {
+        std::ifstream in(inputPath);
+        if (!in) {
+            std::cerr << "could not read " << inputPath << std::endl;
+            return 1;
+        }
+
+        std::vector<PackedPosition> block;
+        block.reserve(DATA_BLOCK);
+        std::string line;
+        char fen[MAX_FEN_LENGTH];
+        Board board;
+
+        while (std::getline(in, line)) {
+            // blank and comment lines aren't worth a mention
+            size_t text = line.find_first_not_of(" \t\r");
+            if (text == std::string::npos || line[text] == '#') continue;
+
+            PackedPosition packed;
+            if (!parseTextLine(line, packed)) {
+                skipped++;
+                continue;
+            }
+
+            if (packedOutput) {
+                block.push_back(packed);
+                if (block.size() == DATA_BLOCK) {
+                    out.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(PackedPosition));
+                    block.clear();
+                }
+            } else {
+                packed.unpack(board);
+                board.toFen(fen);
+                out << fen << " | " << packed.score << " | " << resultText(packed.result()) << '\n';
+            }
+            converted++;
+        }
+        out.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(PackedPosition));
+    }
+
+    out.flush();
+    if (!out) {
+        std::cerr << "could not write " << outputPath << std::endl;
+        return 1;
+    }
+
+    double seconds = secondsSince(start);
+    std::cout << "converted " << converted << " positions in " << seconds << "s (" << (uint64_t)(converted / seconds)
+              << " pos/s)" << std::endl;
+    if (skipped) std::cout << "skipped " << skipped << (packedInput ? " records" : " lines") << " without a valid position" << std::endl;
+
+    // nothing valid at all is more likely the wrong file than bad luck
+    return (converted == 0 && skipped) ? 1 : 0;
+}
+
+// a record and the seeded hash it is sorted by
+struct KeyedRecord {
+    U64 key;
+    PackedPosition position;
+};
+
+static U64 mixBits(U64 x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// a position is the pieces, side to move, castling rights and en passant file; clocks, score, result and move don't count
+static U64 positionIdentity(const PackedPosition &position) {
+    return (position.state & 0x79) | ((U64)(position.fullMovesEp >> 10) << 8);
+}
+
+static U64 shuffleKey(const PackedPosition &position, U64 seed) {
+    U64 pieces[2];
+    std::memcpy(pieces, position.pieces, sizeof(pieces));
+
+    U64 key = mixBits(seed ^ position.occupancy);
+    key = mixBits(key ^ pieces[0]);
+    key = mixBits(key ^ pieces[1]);
+    return mixBits(key ^ positionIdentity(position));
+}
+
+static bool samePosition(const PackedPosition &a, const PackedPosition &b) {
+    return a.occupancy == b.occupancy && std::memcmp(a.pieces, b.pieces, sizeof(a.pieces)) == 0
+        && positionIdentity(a) == positionIdentity(b);
+}
+
+// buffered record output that drops a record equal to the one written before it (sorted input has duplicates adjacent)
+class DedupeWriter {
+    public:
+        explicit DedupeWriter(const std::string &path) : out(path, std::ios::binary) {
+            buffer.reserve(DATA_BLOCK);
+        }
+
+        bool ok() const { return (bool)out; }
+
+        void add(U64 key, const PackedPosition &position) {
+            if (written && key == lastKey && samePosition(position, last)) {
+                duplicates++;
+                return;
+            }
+            lastKey = key;
+            last = position;
+            written++;
+
+            buffer.push_back(position);
+            if (buffer.size() == DATA_BLOCK) flush();
+        }
+
+        void flush() {
+            out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(PackedPosition));
+            buffer.clear();
+        }
+
+        uint64_t written = 0;
+        uint64_t duplicates = 0;
+
+    private:
+        std::ofstream out;
+        std::vector<PackedPosition> buffer;
+        U64 lastKey = 0;
+        PackedPosition last{};
+};
+
+// sequential reader of a sorted run, the key of the current record is recomputed from the record
+class RunReader {
+    public:
+        RunReader(const std::string &path, size_t bufferRecords, U64 seed)
+            : in(path, std::ios::binary), buffer(std::max<size_t>(1, bufferRecords)), seed(seed) {}
+
+        // moves to the next record, false at the end of the run
+        bool next() {
+            if (position == length) {
+                in.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(PackedPosition));
+                length = (size_t)in.gcount() / sizeof(PackedPosition);
+                position = 0;
+                if (length == 0) return false;
+            }
+            current = buffer[position++];
+            key = shuffleKey(current, seed);
+            return true;
+        }
+
+        PackedPosition current;
+        U64 key = 0;
+
+    private:
+        std::ifstream in;
+        std::vector<PackedPosition> buffer;
+        size_t position = 0, length = 0;
+        U64 seed;
+};
+
+// sorts the chunk by key with every thread, each part is sorted on its own and the parts are merged pairwise
+static void sortChunk(std::vector<KeyedRecord> &chunk, ThreadPool &pool) {
+    auto byKey = [](const KeyedRecord &a, const KeyedRecord &b) { return a.key < b.key; };
+    size_t count = chunk.size();
+    size_t part = std::max<size_t>(1, (count + pool.size() - 1) / pool.size());
+
+    for (size_t from = 0; from < count; from += part) {
+        pool.submit([&chunk, from, part, count, byKey] {
+            std::sort(chunk.begin() + from, chunk.begin() + std::min(from + part, count), byKey);
+        });
+    }
+    pool.wait();
+
+    for (size_t width = part; width < count; width *= 2) {
+        for (size_t from = 0; from + width < count; from += 2 * width) {
+            pool.submit([&chunk, from, width, count, byKey] {
+                std::inplace_merge(chunk.begin() + from, chunk.begin() + from + width,
+                                   chunk.begin() + std::min(from + 2 * width, count), byKey);
+            });
+        }
+        pool.wait();
+    }
+}
+
+int DataTools::shuffle(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cout << "usage: nice.exe shuffle <output.bin> <input.bin>... [memory MB] [threads N] [seed N] [tmp path prefix]" << std::endl;
+        return 1;
+    }
+
+    std::string outputPath = argv[2];
+    std::string tmpPrefix = outputPath;
+    std::vector<std::string> inputs;
+    size_t memoryMB = 1024;
+    int threads = 0;
+    U64 seed = 1;
+
+    // anything that isn't an option name followed by its value is an input file
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        bool valid = true;
+        if (arg == "memory" && hasValue) valid = parseOption(arg, argv[++i], (size_t)1, (size_t)1 << 20, memoryMB);
+        else if (arg == "threads" && hasValue) valid = parseOption(arg, argv[++i], 0, 128, threads);
+        else if (arg == "seed" && hasValue) valid = parseOption(arg, argv[++i], (U64)0, UINT64_MAX, seed);
+        else if (arg == "tmp" && hasValue) tmpPrefix = argv[++i];
+        else inputs.push_back(arg);
+        if (!valid) return 1;
+    }
+    if (threads <= 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+
+    // half of the budget holds the chunk, std::inplace_merge may use up to the other half
+    size_t chunkRecords = std::max<size_t>(1024, memoryMB * 1024 * 1024 / 2 / sizeof(KeyedRecord));
+
+    // the chunk is allocated once at its full size (or the whole input if that is smaller), growing it would copy
+    // every record again and briefly need twice the memory
+    uintmax_t inputBytes = 0;
+    for (const std::string &path : inputs) {
+        std::error_code error;
+        uintmax_t size = std::filesystem::file_size(path, error);
+        if (!error) inputBytes += size;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ThreadPool pool(threads);
+    std::vector<KeyedRecord> chunk;
+    chunk.reserve(std::min<uintmax_t>(chunkRecords, inputBytes / sizeof(PackedPosition)));
+    std::vector<std::string> runs;
+    uint64_t inputRecords = 0, runDuplicates = 0, invalidRecords = 0;
+
+    auto spill = [&]() -> bool {
+        if (chunk.empty()) return true;
+        sortChunk(chunk, pool);
+
+        std::string path = tmpPrefix + ".run" + std::to_string(runs.size());
+        DedupeWriter writer(path);
+        for (const KeyedRecord &record : chunk) writer.add(record.key, record.position);
+        writer.flush();
+        if (!writer.ok()) {
+            std::cerr << "could not write " << path << std::endl;
+            return false;
+        }
+
+        runDuplicates += writer.duplicates;
+        runs.push_back(path);
+        chunk.clear();
+        return true;
+    };
+
+    // phase 1: read the inputs into chunks, sort them and write them out as runs
+    for (const std::string &path : inputs) {
+        PackedReader reader;
+        if (!reader.open(path)) {
+            std::cerr << "could not read " << path << std::endl;
+            return 1;
+        }
+
+        for (size_t i = 0; i < reader.size(); i++) {
+            if (i % DATA_BLOCK == 0) reader.prefetch(i + DATA_BLOCK, DATA_BLOCK);
+
+            if (!reader[i].valid()) {
+                invalidRecords++;
+                continue;
+            }
+
+            chunk.push_back(KeyedRecord{shuffleKey(reader[i], seed), reader[i]});
+            if (chunk.size() == chunkRecords && !spill()) return 1;
+        }
+        inputRecords += reader.size();
+    }
+    if (!spill()) return 1;
+    double sortSeconds = secondsSince(start);
+
+    // phase 2: k-way merge of the runs, every run gets an equal share of the budget as read buffer
+    auto mergeStart = std::chrono::steady_clock::now();
+    DedupeWriter writer(outputPath);
+    if (!writer.ok()) {
+        std::cerr << "could not write " << outputPath << std::endl;
+        return 1;
+    }
+
+    size_t bufferRecords = memoryMB * 1024 * 1024 / (runs.size() + 1) / sizeof(PackedPosition);
+    std::vector<std::unique_ptr<RunReader>> readers;
+    using Head = std::pair<U64, size_t>; // key of the run's current record, run index
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+
+    for (size_t r = 0; r < runs.size(); r++) {
+        readers.push_back(std::make_unique<RunReader>(runs[r], bufferRecords, seed));
+        if (readers[r]->next()) heads.push({readers[r]->key, r});
+    }
+
+    while (!heads.empty()) {
+        size_t r = heads.top().second;
+        heads.pop();
+
+        writer.add(readers[r]->key, readers[r]->current);
+        if (readers[r]->next()) heads.push({readers[r]->key, r});
+    }
+    writer.flush();
+
+    readers.clear();
+    for (const std::string &run : runs) std::remove(run.c_str());
+
+    if (!writer.ok()) {
+        std::cerr << "could not write " << outputPath << std::endl;
+        return 1;
+    }
+
+    double mergeSeconds = secondsSince(mergeStart);
+    double seconds = secondsSince(start);
+    double gigabytes = inputRecords * sizeof(PackedPosition) / 1e9;
+
+    std::cout << "===========================" << std::endl;
+    std::cout << "Input positions : " << inputRecords << " (" << gigabytes << " GB in " << inputs.size() << " files)" << std::endl;
+    std::cout << "Output positions: " << writer.written << " (" << runDuplicates + writer.duplicates << " duplicates, " << invalidRecords << " invalid records removed)" << std::endl;
+    std::cout << "Runs            : " << runs.size() << " of up to " << chunkRecords << " positions" << std::endl;
+    std::cout << "Sort (s)        : " << sortSeconds << " (" << gigabytes / sortSeconds << " GB/s)" << std::endl;
+    std::cout << "Merge (s)       : " << mergeSeconds << " (" << gigabytes / mergeSeconds << " GB/s)" << std::endl;
+    std::cout << "Total (s)       : " << seconds << " (" << gigabytes / seconds << " GB/s, " << threads << " threads)" << std::endl;
+
+    return 0;
+}
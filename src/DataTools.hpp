@@ -0,0 +1,17 @@
+#ifndef CHESS_DATATOOLS_HPP
+#define CHESS_DATATOOLS_HPP
+
+// conversions and maintenance of training data sets
+class DataTools {
+    public:
+        // "nice.exe convert <input> <output>", a .bin side is read or written as PackedPosition records
+        // text is "fen | score | result" (score from white's point of view) or epd lines with ce and c9 opcodes
+        static int convert(int argc, char* argv[]);
+
+        // "nice.exe shuffle <output.bin> <input.bin>... [memory MB] [threads N] [seed N] [tmp path prefix]"
+        // shuffles and dedupes .bin files of any size: chunks that fit the memory budget are sorted in parallel by
+        // a seeded position hash and spilled to temporary runs, which a k-way merge then combines into the output
+        static int shuffle(int argc, char* argv[]);
+};
+
+#endif
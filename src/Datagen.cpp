@@ -0,0 +1,158 @@
+#include "Datagen.hpp"
+#include "Board.hpp"
+#include "BitUtils.hpp"
+#include "Evaluation.hpp"
+#include "MoveGen.hpp"
+#include "PackedPosition.hpp"
+#include "ThreadPool.hpp"
+#include "Parse.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+// plays random legal moves from the start position, false if the game ended before they were all played
+static bool randomOpening(Board &board, int plies, std::mt19937_64 &rng) {
+    board = Board();
+    for (int ply = 0; ply < plies; ply++) {
+        std::vector<Move> moves = MoveGen::generateLegalMoves(board);
+        if (moves.empty()) return false;
+        board.makeMove(moves[rng() % moves.size()]);
+    }
+    return !MoveGen::generateLegalMoves(board).empty();
+}
+
+// plays one game and appends its usable positions to records, returns the number added
+static size_t playGame(const DatagenOptions &options, uint64_t game, std::vector<PackedPosition> &records) {
+    std::mt19937_64 rng(options.seed * 0x9E3779B97F4A7C15ULL + game);
+
+    Board board;
+    while (!randomOpening(board, options.randomPlies, rng)) {}
+
+    size_t first = records.size();
+    std::vector<U64> history{board.getHash()};
+    int result = RESULT_DRAW;
+
+    for (int ply = 0; ply < DATAGEN_MAX_PLIES; ply++) {
+        if (MoveGen::generateLegalMoves(board).empty()) {
+            if (MoveGen::inCheck(board)) result = (board.sideToMove() == WHITE) ? RESULT_BLACK_WIN : RESULT_WHITE_WIN;
+            break;
+        }
+        if (board.getHalfMoves() >= 100 || board.insufficientMaterial()) break;
+        if (std::count(history.begin(), history.end(), board.getHash()) >= 3) break;
+
+        SearchResult search = Search::analyze(board, options.limits);
+
+        // once a mate is found the game is decided, its remaining positions say nothing about the evaluation
+        if (search.mateIn != 0) {
+            bool whiteWins = (search.mateIn > 0) == (board.sideToMove() == WHITE);
+            result = whiteWins ? RESULT_WHITE_WIN : RESULT_BLACK_WIN;
+            break;
+        }
+
+        // positions in check or before a capture (or promotion) aren't quiet, the score only holds after the tactics
+        bool tactical = moveFlags(search.bestMove) & (CAPTURE | PROMOTION);
+        if (!tactical && !MoveGen::inCheck(board)) {
+            int score = std::clamp(search.score, -32000, 32000);
+            records.push_back(PackedPosition::pack(board, (board.sideToMove() == WHITE) ? score : -score, RESULT_UNKNOWN, search.bestMove));
+        }
+
+        board.makeMove(search.bestMove);
+        history.push_back(board.getHash());
+    }
+
+    // the result is only known once the game is over
+    for (size_t i = first; i < records.size(); i++) records[i].setResult(result);
+    return records.size() - first;
+}
+
+int Datagen::run(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "usage: nice.exe datagen <output prefix> [games N] [threads N] [depth N] [nodes N] [plies N] [seed N] [hash MB]" << std::endl;
+        return 1;
+    }
+
+    DatagenOptions options;
+    options.outputPrefix = argv[2];
+
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string name = argv[i];
+        std::string value = argv[i + 1];
+
+        bool valid = true;
+        if (name == "games") valid = parseOption(name, value, (uint64_t)1, UINT64_MAX, options.games);
+        else if (name == "threads") valid = parseOption(name, value, 0, 128, options.threads);
+        else if (name == "depth") valid = parseOption(name, value, 0, MAX_PLY, options.limits.depth);
+        else if (name == "nodes") valid = parseOption(name, value, (uint64_t)0, UINT64_MAX, options.limits.nodes);
+        else if (name == "plies") valid = parseOption(name, value, 0, DATAGEN_MAX_PLIES, options.randomPlies);
+        else if (name == "seed") valid = parseOption(name, value, (uint64_t)0, UINT64_MAX, options.seed);
+        else if (name == "hash") valid = parseOption(name, value, 0, 1024, options.hash);
+        else std::cerr << "unknown option " << name << std::endl;
+        if (!valid) return 1;
+    }
+
+    if (!options.limits.depth && !options.limits.nodes) options.limits.nodes = 5000;
+    int threads = options.threads > 0 ? options.threads : (int)std::max(1u, std::thread::hardware_concurrency());
+
+    Evaluation::setCacheSize(options.hash);
+
+    std::atomic<uint64_t> nextGame{0}, positions{0};
+    std::atomic<int64_t> lastReport{0};
+    std::atomic<bool> failed{false};
+    auto start = std::chrono::steady_clock::now();
+
+    auto elapsed = [&] {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // every worker plays games until they run out and writes each finished game to its own file
+    {
+        ThreadPool pool(threads);
+        for (int t = 0; t < threads; t++) {
+            pool.submit([&, t] {
+                std::string path = options.outputPrefix + "_" + std::to_string(t) + ".bin";
+                std::ofstream out(path, std::ios::binary);
+                if (!out) {
+                    std::cerr << "could not write " << path << std::endl;
+                    failed = true;
+                    return;
+                }
+
+                std::vector<PackedPosition> records;
+                for (uint64_t game = nextGame++; game < options.games && !failed; game = nextGame++) {
+                    records.clear();
+                    playGame(options, game, records);
+                    out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(PackedPosition));
+                    positions += records.size();
+
+                    // progress every 10 seconds from whichever worker gets there first
+                    int64_t now = (int64_t)elapsed();
+                    int64_t last = lastReport;
+                    if (now >= last + 10 && lastReport.compare_exchange_strong(last, now)) {
+                        std::cout << "games " << std::min(nextGame.load(), options.games) << " positions " << positions
+                                  << " (" << (uint64_t)(positions / elapsed()) << " pos/s)" << std::endl;
+                    }
+                }
+            });
+        }
+        pool.wait();
+    }
+
+    if (failed) return 1;
+
+    double seconds = std::max(elapsed(), 1e-9);
+    std::cout << "===========================" << std::endl;
+    std::cout << "Games           : " << options.games << std::endl;
+    std::cout << "Positions       : " << positions << std::endl;
+    std::cout << "Total time (s)  : " << seconds << std::endl;
+    std::cout << "Positions/second: " << (uint64_t)(positions / seconds) << " (" << (uint64_t)(positions / seconds / threads)
+              << " per thread, " << threads << " threads)" << std::endl;
+    std::cout << "written to " << options.outputPrefix << "_<thread>.bin" << std::endl;
+
+    return 0;
+}
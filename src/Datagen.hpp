@@ -0,0 +1,29 @@
+#ifndef CHESS_DATAGEN_HPP
+#define CHESS_DATAGEN_HPP
+
+#include "Search.hpp"
+#include <cstdint>
+#include <string>
+
+// games are drawn after this many plies
+#define DATAGEN_MAX_PLIES 400
+
+struct DatagenOptions {
+    std::string outputPrefix;   // every thread writes <prefix>_<thread>.bin
+    uint64_t games = 1000;
+    int threads = 0;            // 0 = all cores
+    int randomPlies = 8;        // random legal moves played before the search takes over
+    uint64_t seed = 1;
+    int hash = 4;               // eval cache per thread in MB
+    SearchLimits limits;        // per move, 5000 nodes if nothing is given
+};
+
+class Datagen {
+    public:
+        // entry point for "nice.exe datagen <output prefix> [games N] [threads N] [depth N] [nodes N] [plies N] [seed N] [hash MB]"
+        // writes the quiet positions of self play games as PackedPosition records
+        // (score and result from white's point of view, and the move the search played)
+        static int run(int argc, char* argv[]);
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include "Epd.hpp"
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool isNumber(std::string_view field) {
+    if (field.empty()) return false;
+    for (char c : field) {
+        if (c < '0' || c > '9') return false;
+    }
+    return true;
+}
+
+// takes the next whitespace separated field off the front of the line
+static std::string_view nextField(std::string_view &line) {
+    size_t start = 0;
+    while (start < line.size() && isSpace(line[start])) start++;
+
+    size_t end = start;
+    while (end < line.size() && !isSpace(line[end])) end++;
+
+    std::string_view field = line.substr(start, end - start);
+    line.remove_prefix(end);
+    return field;
+}
+
+std::string EpdEntry::operation(std::string_view opcode) const {
+    for (const auto &op : operations) {
+        if (op.first == opcode) return op.second;
+    }
+    return "";
+}
+
+bool Epd::parse(std::string_view line, EpdEntry &entry) {
+    entry.fen.clear();
+    entry.operations.clear();
+
+    std::string_view rest = line;
+    for (int i = 0; i < 4; i++) {
+        std::string_view field = nextField(rest);
+        if (field.empty() || (i == 0 && field[0] == '#')) return false;
+
+        if (i) entry.fen += ' ';
+        entry.fen += field;
+    }
+
+    // fen style move counters, only taken when both are there
+    std::string_view afterCounters = rest;
+    std::string_view halfMoves = nextField(afterCounters);
+    std::string_view fullMoves = nextField(afterCounters);
+    if (isNumber(halfMoves) && isNumber(fullMoves)) {
+        entry.fen += ' ';
+        entry.fen += halfMoves;
+        entry.fen += ' ';
+        entry.fen += fullMoves;
+        rest = afterCounters;
+    }
+
+    // operations are "opcode operand...;", a quoted operand may contain ';'
+    size_t i = 0;
+    while (i < rest.size()) {
+        while (i < rest.size() && (isSpace(rest[i]) || rest[i] == ';')) i++;
+        if (i == rest.size()) break;
+
+        size_t opcodeStart = i;
+        while (i < rest.size() && !isSpace(rest[i]) && rest[i] != ';') i++;
+        std::string opcode(rest.substr(opcodeStart, i - opcodeStart));
+
+        while (i < rest.size() && isSpace(rest[i])) i++;
+
+        size_t operandStart = i;
+        bool quoted = false;
+        while (i < rest.size() && (quoted || rest[i] != ';')) {
+            if (rest[i] == '"') quoted = !quoted;
+            i++;
+        }
+
+        std::string_view operand = rest.substr(operandStart, i - operandStart);
+        while (!operand.empty() && isSpace(operand.back())) operand.remove_suffix(1);
+        if (operand.size() >= 2 && operand.front() == '"' && operand.back() == '"') {
+            operand = operand.substr(1, operand.size() - 2);
+        }
+
+        entry.operations.emplace_back(opcode, std::string(operand));
+    }
+
+    return true;
+}
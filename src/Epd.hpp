@@ -0,0 +1,25 @@
+#ifndef CHESS_EPD_HPP
+#define CHESS_EPD_HPP
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// one line of an epd file (a plain fen line is an epd line without operations)
+struct EpdEntry {
+    std::string fen;    // the four position fields, plus the move counters if the line has them
+    std::vector<std::pair<std::string, std::string>> operations;   // opcode and operand text, e.g. {"bm", "Nf3 Qe2"}
+
+    // operand of the first operation with this opcode, empty if there is none
+    std::string operation(std::string_view opcode) const;
+};
+
+class Epd {
+    public:
+        // splits a line into its fen and operations, false for blank and comment (#) lines
+        // the fen isn't validated, that is left to Board::setFen
+        static bool parse(std::string_view line, EpdEntry &entry);
+};
+
+#endif
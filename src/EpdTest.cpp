@@ -0,0 +1,164 @@
+#include "EpdTest.hpp"
+#include "Board.hpp"
+#include "Epd.hpp"
+#include "Evaluation.hpp"
+#include "ThreadPool.hpp"
+#include "UCI.hpp"
+#include "Parse.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+// moves of a bm/am operand, in san or uci notation; false if one of them isn't legal here
+static bool parseMoveList(const std::string &operand, const Board &board, std::vector<Move> &moves) {
+    std::istringstream ss(operand);
+    std::string token;
+    while (ss >> token) {
+        Move move = parseSan(token, board);
+        if (!move) move = parseMove(token, board);
+        if (!move) return false;
+        moves.push_back(move);
+    }
+    return true;
+}
+
+void EpdTest::solve(EpdTestCase &test, const SearchLimits &limits) {
+    Board board(test.fen);
+
+    auto isRight = [&](Move move) {
+        if (!test.bestMoves.empty() && std::find(test.bestMoves.begin(), test.bestMoves.end(), move) == test.bestMoves.end()) return false;
+        return std::find(test.avoidMoves.begin(), test.avoidMoves.end(), move) == test.avoidMoves.end();
+    };
+
+    // a wrong iteration resets the solution, so what is left is the start of the final run of right answers
+    test.solved = false;
+    Search::analyze(board, limits, [&](const SearchResult &result) {
+        test.played = result.bestMove;
+
+        if (!isRight(result.bestMove)) {
+            test.solved = false;
+        } else if (!test.solved) {
+            test.solved = true;
+            test.solvedDepth = result.depth;
+            test.solvedTime = result.timeMs;
+            test.solvedNodes = result.nodes;
+        }
+    });
+}
+
+int EpdTest::run(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "usage: nice.exe epdtest <suite.epd> [movetime ms] [nodes N] [depth N] [threads N] [hash MB]" << std::endl;
+        return 1;
+    }
+
+    std::string path = argv[2];
+    SearchLimits limits;
+    int threads = 0;
+    int hash = 4;
+
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string name = argv[i];
+        std::string value = argv[i + 1];
+
+        bool valid = true;
+        if (name == "movetime") valid = parseOption(name, value, (int64_t)0, INT64_MAX, limits.timeMs);
+        else if (name == "nodes") valid = parseOption(name, value, (uint64_t)0, UINT64_MAX, limits.nodes);
+        else if (name == "depth") valid = parseOption(name, value, 0, MAX_PLY, limits.depth);
+        else if (name == "threads") valid = parseOption(name, value, 0, 128, threads);
+        else if (name == "hash") valid = parseOption(name, value, 0, 1024, hash);
+        else std::cerr << "unknown option " << name << std::endl;
+        if (!valid) return 1;
+    }
+
+    if (!limits.depth && !limits.nodes && !limits.timeMs) limits.timeMs = EPDTEST_MOVETIME;
+    if (threads <= 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "could not read " << path << std::endl;
+        return 1;
+    }
+
+    // only positions with a bm or am can be scored
+    std::vector<EpdTestCase> tests;
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+
+        EpdEntry entry;
+        if (!Epd::parse(line, entry)) continue;
+
+        Board board;
+        const char *error = nullptr;
+        if (!board.setFen(entry.fen, &error)) {
+            std::cerr << "line " << lineNumber << ": invalid fen (" << error << ")" << std::endl;
+            continue;
+        }
+
+        EpdTestCase test;
+        test.fen = entry.fen;
+        test.id = entry.operation("id");
+        if (test.id.empty()) test.id = "line " + std::to_string(lineNumber);
+
+        if (!parseMoveList(entry.operation("bm"), board, test.bestMoves) || !parseMoveList(entry.operation("am"), board, test.avoidMoves)) {
+            std::cerr << test.id << ": bm/am move isn't legal in the position" << std::endl;
+            continue;
+        }
+        if (test.bestMoves.empty() && test.avoidMoves.empty()) continue;
+
+        tests.push_back(test);
+    }
+
+    Evaluation::setCacheSize(hash);
+
+    // positions run concurrently, each search is single threaded
+    auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(threads);
+        for (EpdTestCase &test : tests) {
+            pool.submit([&test, &limits] { solve(test, limits); });
+        }
+        pool.wait();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<int64_t> times;
+    uint64_t solvedNodes = 0;
+    for (EpdTestCase &test : tests) {
+        Board board(test.fen);
+        std::string played = test.played ? moveToString(test.played, board) : "0000";
+
+        std::cout << (test.solved ? "solved " : "failed ") << test.id << "  played " << played;
+        if (test.solved) {
+            std::cout << "  depth " << test.solvedDepth << "  time " << test.solvedTime << " ms  nodes " << test.solvedNodes;
+            times.push_back(test.solvedTime);
+            solvedNodes += test.solvedNodes;
+        }
+        std::cout << std::endl;
+    }
+
+    double mean = 0, median = 0;
+    if (!times.empty()) {
+        for (int64_t t : times) mean += t;
+        mean /= times.size();
+
+        std::sort(times.begin(), times.end());
+        size_t middle = times.size() / 2;
+        median = (times.size() % 2) ? times[middle] : (times[middle - 1] + times[middle]) / 2.0;
+    }
+
+    std::cout << "===========================" << std::endl;
+    std::cout << "Solved          : " << times.size() << " / " << tests.size() << std::endl;
+    std::cout << "Mean time (ms)  : " << mean << std::endl;
+    std::cout << "Median time (ms): " << median << std::endl;
+    std::cout << "Mean nodes      : " << (times.empty() ? 0 : solvedNodes / times.size()) << std::endl;
+    std::cout << "Total time (s)  : " << seconds << " with " << threads << " threads" << std::endl;
+
+    return 0;
+}
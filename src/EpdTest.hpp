@@ -0,0 +1,35 @@
+#ifndef CHESS_EPDTEST_HPP
+#define CHESS_EPDTEST_HPP
+
+#include "Search.hpp"
+#include <string>
+#include <vector>
+
+// time per position when no limit is given
+#define EPDTEST_MOVETIME 1000
+
+// one position of a test suite and how the search did on it
+struct EpdTestCase {
+    std::string id;
+    std::string fen;
+    std::vector<Move> bestMoves;    // bm, one of them has to be played
+    std::vector<Move> avoidMoves;   // am, none of them may be played
+
+    bool solved = false;
+    Move played = 0;
+    int solvedDepth = 0;            // iteration from which on the search kept a right move
+    int64_t solvedTime = 0;         // ms
+    uint64_t solvedNodes = 0;
+};
+
+class EpdTest {
+    public:
+        // entry point for "nice.exe epdtest <suite.epd> [movetime ms] [nodes N] [depth N] [threads N] [hash MB]"
+        static int run(int argc, char* argv[]);
+
+    private:
+        // searches one position and records when the right move became best and stayed best
+        static void solve(EpdTestCase &test, const SearchLimits &limits);
+};
+
+#endif
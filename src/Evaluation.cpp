@@ -1,8 +1,140 @@
 #include "Evaluation.hpp"
+#include "MoveGen.hpp"
+#include "NNUE.hpp"
 #include "BitUtils.hpp"
 #include "Types.hpp"
+#include "Profile.hpp"
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <algorithm>
 
-int Evaluation::evaluate(Board &board) {
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define MAX_EVAL 1000000
+
+#define FILE_A_MASK 0x0101010101010101ULL
+#define RANK_1_MASK 0xFFULL
+
+// batched evaluation works on blocks of positions laid out as structure of arrays
+#define BATCH_BLOCK 64
+#define BATCH_SLOTS 32 // at most 32 pieces on the board
+
+static thread_local EvalStats evalStats;
+
+// direct mapped cache of full static evaluations, indexed by the low bits of the zobrist key
+struct EvalCacheEntry {
+    U64 key;
+    int score; // from white's point of view
+};
+
+// the size and generation are set by the uci thread while search threads read them, relaxed atomics are enough
+// as a thread only has to see the change before its next evaluation, not in any order with other memory
+static std::atomic<size_t> evalCacheEntries{(4 * 1024 * 1024) / sizeof(EvalCacheEntry)}; // 4 MB default
+static thread_local std::vector<EvalCacheEntry> evalCache;
+
+// bumped by clearCache, a thread clears its cache when its generation is out of date
+static std::atomic<int> evalCacheGeneration{0};
+static thread_local int threadCacheGeneration = 0;
+
+// file masks of the neighbouring files, used for isolated and passed pawns
+static U64 adjacentFiles(int file) {
+    U64 mask = 0;
+    if (file > 0) mask |= FILE_A_MASK << (file - 1);
+    if (file < 7) mask |= FILE_A_MASK << (file + 1);
+    return mask;
+}
+
+// all squares in front of a pawn on the same and neighbouring files
+static U64 passedPawnMask(int square, int colour) {
+    int file = square % 8;
+    int rank = square / 8;
+    U64 files = adjacentFiles(file) | (FILE_A_MASK << file);
+
+    if (colour == WHITE) {
+        return (rank == 7) ? 0 : files & (~0ULL << (8 * (rank + 1)));
+    }
+    return (rank == 0) ? 0 : files & (~0ULL >> (8 * (8 - rank)));
+}
+
+static constexpr int absolute(int value) {
+    return value < 0 ? -value : value;
+}
+
+// the lazy evaluation may only skip a stage when it can't bring the score back into the window, so the
+// margins below are the most a stage can add for the pieces on the board, taken from the parameters
+// rather than guessed: a margin that is too small changes the search result
+
+// a side's pawn terms are at most every pawn passed on its rank, or every pawn isolated and doubled on one file
+int Evaluation::pawnMargin(const Board &board) {
+    int margin = 0;
+
+    for (int colour = WHITE; colour <= BLACK; ++colour) {
+        U64 pawns = board.bitboards[(colour == WHITE) ? WP : BP];
+        int count = popCount(pawns);
+        if (count == 0) continue;
+
+        margin += count * absolute(isolatedPawnPenalty) + (count - 1) * absolute(doubledPawnPenalty);
+        for (int rank = 1; rank < 7; ++rank) {
+            int relativeRank = (colour == WHITE) ? rank : 7 - rank;
+            margin += popCount(pawns & (RANK_1_MASK << (8 * rank))) * absolute(passedPawnBonus[relativeRank]);
+        }
+    }
+
+    return margin;
+}
+
+// most squares a knight, bishop, rook or queen can reach on an empty board, at most 8 of them next to the enemy king
+static constexpr int maxReach[] = {0, 8, 13, 14, 27};
+
+int Evaluation::mobilityMargin(const Board &board) {
+    int margin = 0;
+
+    for (int colour = WHITE; colour <= BLACK; ++colour) {
+        int offset = (colour == WHITE) ? 0 : 6;
+
+        for (int piece = WN; piece <= WQ; ++piece) {
+            int reach = absolute(mobilityWeights[piece]) * maxReach[piece] + absolute(kingAttackWeight) * std::min(maxReach[piece], 8);
+            margin += popCount(board.bitboards[piece + offset]) * reach;
+        }
+
+        // the shield is the three squares in front of the king
+        if (board.bitboards[(colour == WHITE) ? BQ : WQ]) margin += 3 * absolute(pawnShieldBonus);
+    }
+
+    return margin;
+}
+
+// material + PST of every piece on every square with black pieces negated, so a position's
+// stage 1 score is the sum of one entry per piece. rows 12 and 13 are the kings once the enemy queen is gone
+// and the extra entry at the end is 0, it pads positions with fewer pieces than the rest of their block
+struct BatchTable {
+    int values[14 * 64 + 1];
+};
+
+#define BATCH_PAD (14 * 64)
+
+constexpr BatchTable generateBatchTable() {
+    BatchTable table{};
+    const int* tables[] = {pawnTable, knightTable, bishopTable, rookTable, queenTable, kingTable, kingEndgameTable};
+
+    for (int square = 0; square < 64; ++square) {
+        for (int piece = WP; piece <= WK; ++piece) {
+            table.values[piece * 64 + square] = pieceValues[piece] + tables[piece][square];
+            table.values[(piece + 6) * 64 + square] = -(pieceValues[piece] + tables[piece][square ^ 56]);
+        }
+        table.values[12 * 64 + square] = pieceValues[WK] + kingEndgameTable[square];
+        table.values[13 * 64 + square] = -(pieceValues[WK] + kingEndgameTable[square ^ 56]);
+    }
+
+    return table;
+}
+
+static constexpr BatchTable batchTable = generateBatchTable();
+
+int Evaluation::materialAndPST(const Board &board) {
     int score = 0;
 
     // --- white evaluation --
@@ -99,6 +231,386 @@ int Evaluation::evaluate(Board &board) {
         score -= pieceValues[BQ-6] + queenTable[piecePosition^56]; // material score + PST score
     }
 
+    return score;
+}
+
+int Evaluation::pawnStructure(const Board &board) {
+    int score = 0;
+
+    for (int colour = WHITE; colour <= BLACK; ++colour) {
+        int sign = (colour == WHITE) ? 1 : -1;
+        U64 ownPawns = board.bitboards[(colour == WHITE) ? WP : BP];
+        U64 enemyPawns = board.bitboards[(colour == WHITE) ? BP : WP];
+
+        // doubled and isolated pawns are scored per file
+        for (int file = 0; file < 8; ++file) {
+            int pawnsOnFile = popCount(ownPawns & (FILE_A_MASK << file));
+            if (pawnsOnFile == 0) continue;
+
+            if (pawnsOnFile > 1) score -= sign * doubledPawnPenalty * (pawnsOnFile - 1);
+            if (!(ownPawns & adjacentFiles(file))) score -= sign * isolatedPawnPenalty * pawnsOnFile;
+        }
+
+        // passed pawns get a bonus that grows as they advance
+        U64 bitboard = ownPawns;
+        while (bitboard) {
+            int square = popLSB(bitboard);
+            if (!(passedPawnMask(square, colour) & enemyPawns)) {
+                int relativeRank = (colour == WHITE) ? square / 8 : 7 - square / 8;
+                score += sign * passedPawnBonus[relativeRank];
+            }
+        }
+    }
+
+    return score;
+}
+
+int Evaluation::mobilityAndKingSafety(const Board &board) {
+    int score = 0;
+    U64 occupancy = board.bitboards[ALL_OCC];
+
+    for (int colour = WHITE; colour <= BLACK; ++colour) {
+        int sign = (colour == WHITE) ? 1 : -1;
+        int offset = (colour == WHITE) ? 0 : 6;
+        U64 ownPieces = board.bitboards[(colour == WHITE) ? WHITE_OCC : BLACK_OCC];
+
+        // squares around the enemy king, attacks on these count towards king pressure
+        int enemyKing = getLSB(board.bitboards[(colour == WHITE) ? BK : WK]);
+        U64 kingZone = MoveGen::kingAttacksFrom(enemyKing);
+        int kingAttacks = 0;
+
+        // mobility is the number of pseudo legal target squares (N, B, R, Q)
+        for (int piece = WN; piece <= WQ; ++piece) {
+            U64 bitboard = board.bitboards[piece + offset];
+            while (bitboard) {
+                int square = popLSB(bitboard);
+                U64 attacks;
+
+                switch (piece) {
+                    case WN: attacks = MoveGen::knightAttacksFrom(square); break;
+                    case WB: attacks = MoveGen::bishopAttacks(square, occupancy); break;
+                    case WR: attacks = MoveGen::rookAttacks(square, occupancy); break;
+                    default: attacks = MoveGen::bishopAttacks(square, occupancy) | MoveGen::rookAttacks(square, occupancy); break;
+                }
+
+                score += sign * mobilityWeights[piece] * popCount(attacks & ~ownPieces);
+                kingAttacks += popCount(attacks & kingZone);
+            }
+        }
+
+        score += sign * kingAttackWeight * kingAttacks;
+
+        // pawn shield in front of our own king, only relevant while the enemy queen is on the board
+        if (board.bitboards[(colour == WHITE) ? BQ : WQ]) {
+            int ownKing = getLSB(board.bitboards[(colour == WHITE) ? WK : BK]);
+            U64 ownPawns = board.bitboards[(colour == WHITE) ? WP : BP];
+            U64 shield = MoveGen::kingAttacksFrom(ownKing) & passedPawnMask(ownKing, colour);
+            score += sign * pawnShieldBonus * popCount(shield & ownPawns);
+        }
+    }
+
+    return score;
+}
+
+int Evaluation::evaluate(Board &board) {
+    return evaluate(board, -MAX_EVAL, MAX_EVAL);
+}
+
+int Evaluation::evaluate(Board &board, int alpha, int beta, const Accumulator *accumulator) {
+    PROFILE_SCOPE(PROFILE_EVALUATE);
+    evalStats.calls++;
+
+    // convert to the side to move's point of view after each stage
+    int sign = (board.activeColour == WHITE) ? 1 : -1;
+
+    // the cache is resized lazily so every thread picks up the current setting
+    size_t entries = evalCacheEntries.load(std::memory_order_relaxed);
+    int generation = evalCacheGeneration.load(std::memory_order_relaxed);
+    if (evalCache.size() != entries || threadCacheGeneration != generation) {
+        evalCache.assign(entries, EvalCacheEntry{0, 0});
+        threadCacheGeneration = generation;
+    }
+
+    EvalCacheEntry* entry = nullptr;
+    if (!evalCache.empty()) {
+        evalStats.cacheProbes++;
+        entry = &evalCache[board.hashKey & (evalCache.size() - 1)];
+
+        if (entry->key == board.hashKey) {
+            evalStats.cacheHits++;
+            return sign * entry->score;
+        }
+    }
+
+    // the network replaces all of the stages below
+    if (NNUE::isEnabled()) {
+        int relative = accumulator ? NNUE::evaluate(board, *accumulator) : NNUE::evaluate(board);
+        if (entry) {
+            entry->key = board.hashKey;
+            entry->score = sign * relative;
+        }
+        return relative;
+    }
+
+    // stage 1: material and piece square tables
+    int score = materialAndPST(board);
+
+    int relative = sign * score;
+    int mobility = mobilityMargin(board);
+    int margin = pawnMargin(board) + mobility;
+    if (relative + margin <= alpha || relative - margin >= beta) {
+        evalStats.skippedPawns++;
+        return relative;
+    }
+
+    // stage 2: pawn structure
+    score += pawnStructure(board);
+
+    relative = sign * score;
+    if (relative + mobility <= alpha || relative - mobility >= beta) {
+        evalStats.skippedMobility++;
+        return relative;
+    }
+
+    // stage 3: mobility and king safety
+    score += mobilityAndKingSafety(board);
+
+    // only complete evaluations are cached, early exits are just bounds
+    if (entry) {
+        entry->key = board.hashKey;
+        entry->score = score;
+    }
+
     // return positive score for white and negative for black
-    return (board.activeColour == WHITE) ? score : -score;
-}
\ No newline at end of file
+    return sign * score;
+}
+
+// mirrors the three stages above, keep the two in sync
+void Evaluation::trace(const Board &board, EvalTrace &trace) {
+    trace = EvalTrace{};
+
+    int* traceTables[] = {trace.pawnTable, trace.knightTable, trace.bishopTable, trace.rookTable, trace.queenTable};
+
+    U64 occupancy = board.bitboards[ALL_OCC];
+
+    for (int colour = WHITE; colour <= BLACK; ++colour) {
+        int sign = (colour == WHITE) ? 1 : -1;
+        int offset = (colour == WHITE) ? 0 : 6;
+        int flip = (colour == WHITE) ? 0 : 56;
+
+        // material and piece square tables
+        for (int piece = WP; piece <= WK; ++piece) {
+            U64 bitboard = board.bitboards[piece + offset];
+            while (bitboard) {
+                int square = popLSB(bitboard) ^ flip;
+                trace.pieceValues[piece] += sign;
+
+                if (piece != WK) {
+                    traceTables[piece][square] += sign;
+                } else if (board.bitboards[(colour == WHITE) ? BQ : WQ] == 0) {
+                    trace.kingEndgameTable[square] += sign;
+                } else {
+                    trace.kingTable[square] += sign;
+                }
+            }
+        }
+
+        // pawn structure
+        U64 ownPawns = board.bitboards[(colour == WHITE) ? WP : BP];
+        U64 enemyPawns = board.bitboards[(colour == WHITE) ? BP : WP];
+
+        for (int file = 0; file < 8; ++file) {
+            int pawnsOnFile = popCount(ownPawns & (FILE_A_MASK << file));
+            if (pawnsOnFile == 0) continue;
+
+            if (pawnsOnFile > 1) trace.doubledPawnPenalty -= sign * (pawnsOnFile - 1);
+            if (!(ownPawns & adjacentFiles(file))) trace.isolatedPawnPenalty -= sign * pawnsOnFile;
+        }
+
+        U64 bitboard = ownPawns;
+        while (bitboard) {
+            int square = popLSB(bitboard);
+            if (!(passedPawnMask(square, colour) & enemyPawns)) {
+                int relativeRank = (colour == WHITE) ? square / 8 : 7 - square / 8;
+                trace.passedPawnBonus[relativeRank] += sign;
+            }
+        }
+
+        // mobility and king safety
+        U64 ownPieces = board.bitboards[(colour == WHITE) ? WHITE_OCC : BLACK_OCC];
+        int enemyKing = getLSB(board.bitboards[(colour == WHITE) ? BK : WK]);
+        U64 kingZone = MoveGen::kingAttacksFrom(enemyKing);
+
+        for (int piece = WN; piece <= WQ; ++piece) {
+            bitboard = board.bitboards[piece + offset];
+            while (bitboard) {
+                int square = popLSB(bitboard);
+                U64 attacks;
+
+                switch (piece) {
+                    case WN: attacks = MoveGen::knightAttacksFrom(square); break;
+                    case WB: attacks = MoveGen::bishopAttacks(square, occupancy); break;
+                    case WR: attacks = MoveGen::rookAttacks(square, occupancy); break;
+                    default: attacks = MoveGen::bishopAttacks(square, occupancy) | MoveGen::rookAttacks(square, occupancy); break;
+                }
+
+                trace.mobilityWeights[piece] += sign * popCount(attacks & ~ownPieces);
+                trace.kingAttackWeight += sign * popCount(attacks & kingZone);
+            }
+        }
+
+        if (board.bitboards[(colour == WHITE) ? BQ : WQ]) {
+            int ownKing = getLSB(board.bitboards[(colour == WHITE) ? WK : BK]);
+            U64 shield = MoveGen::kingAttacksFrom(ownKing) & passedPawnMask(ownKing, colour);
+            trace.pawnShieldBonus += sign * popCount(shield & ownPawns);
+        }
+    }
+}
+
+// sums the table entries of every slot, indices[slot * BATCH_BLOCK + i] belongs to position i of the block
+static void sumBatchBlock(const int* indices, int slots, int* sums) {
+#if defined(__AVX2__)
+    for (int i = 0; i < BATCH_BLOCK; i += 8) {
+        __m256i sum = _mm256_setzero_si256();
+        for (int slot = 0; slot < slots; ++slot) {
+            __m256i index = _mm256_load_si256((const __m256i*)&indices[slot * BATCH_BLOCK + i]);
+            sum = _mm256_add_epi32(sum, _mm256_i32gather_epi32(batchTable.values, index, 4));
+        }
+        _mm256_store_si256((__m256i*)&sums[i], sum);
+    }
+#else
+    for (int i = 0; i < BATCH_BLOCK; ++i) sums[i] = 0;
+    for (int slot = 0; slot < slots; ++slot) {
+        for (int i = 0; i < BATCH_BLOCK; ++i) sums[i] += batchTable.values[indices[slot * BATCH_BLOCK + i]];
+    }
+#endif
+}
+
+size_t Evaluation::evaluateBatchRange(const PackedPosition* positions, size_t from, size_t to, int* scores) {
+    alignas(32) int indices[BATCH_SLOTS * BATCH_BLOCK];
+    alignas(32) int sums[BATCH_BLOCK];
+    int rest[BATCH_BLOCK];
+    int slotCount[BATCH_BLOCK];
+    size_t invalid = 0;
+
+    // scratch board, only the bitboards are filled in unless the network needs the whole position
+    Board board;
+
+    for (size_t start = from; start < to; start += BATCH_BLOCK) {
+        int count = (int)std::min<size_t>(BATCH_BLOCK, to - start);
+
+        if (NNUE::isEnabled()) {
+            for (int i = 0; i < count; ++i) {
+                if (!positions[start + i].valid()) {
+                    invalid++;
+                    scores[start + i] = 0;
+                    continue;
+                }
+
+                positions[start + i].unpack(board);
+                int score = NNUE::evaluate(board);
+                scores[start + i] = (board.activeColour == WHITE) ? score : -score;
+            }
+            continue;
+        }
+
+        int maxSlots = 2;
+
+        for (int i = 0; i < BATCH_BLOCK; ++i) {
+            // unused lanes of the last block and invalid records are scored as empty boards and thrown away
+            if (i >= count || !positions[start + i].valid()) {
+                invalid += i < count;
+                slotCount[i] = 0;
+                rest[i] = 0;
+                continue;
+            }
+
+            const PackedPosition &position = positions[start + i];
+            for (int b = 0; b < 16; ++b) board.bitboards[b] = 0;
+
+            // the bitboards are rebuilt in the same pass, slots 0 and 1 are kept for the kings
+            int slot = 2;
+            int n = 0;
+            U64 occupancy = position.occupancy;
+            while (occupancy) {
+                int square = popLSB(occupancy);
+                int piece = position.piece(n++);
+
+                board.bitboards[piece] |= 1ULL << square;
+                if (piece != WK && piece != BK) indices[slot++ * BATCH_BLOCK + i] = piece * 64 + square;
+            }
+
+            board.bitboards[WHITE_OCC] = board.bitboards[WP] | board.bitboards[WN] | board.bitboards[WB] | board.bitboards[WR] | board.bitboards[WQ] | board.bitboards[WK];
+            board.bitboards[BLACK_OCC] = board.bitboards[BP] | board.bitboards[BN] | board.bitboards[BB] | board.bitboards[BR] | board.bitboards[BQ] | board.bitboards[BK];
+            board.bitboards[ALL_OCC] = position.occupancy;
+
+            // the king row depends on whether the enemy queen is still on the board
+            indices[i] = ((board.bitboards[BQ] == 0) ? 12 : WK) * 64 + getLSB(board.bitboards[WK]);
+            indices[BATCH_BLOCK + i] = ((board.bitboards[WQ] == 0) ? 13 : BK) * 64 + getLSB(board.bitboards[BK]);
+
+            slotCount[i] = slot;
+            maxSlots = std::max(maxSlots, slot);
+
+            // pawn structure, mobility and king safety still need the bitboards of one position at a time
+            rest[i] = pawnStructure(board) + mobilityAndKingSafety(board);
+        }
+
+        for (int i = 0; i < BATCH_BLOCK; ++i) {
+            for (int slot = slotCount[i]; slot < maxSlots; ++slot) indices[slot * BATCH_BLOCK + i] = BATCH_PAD;
+        }
+
+        sumBatchBlock(indices, maxSlots, sums);
+
+        for (int i = 0; i < count; ++i) scores[start + i] = sums[i] + rest[i];
+    }
+
+    return invalid;
+}
+
+size_t Evaluation::evaluateBatch(const PackedPosition* positions, size_t count, int* scores, int threads) {
+    size_t blocks = (count + BATCH_BLOCK - 1) / BATCH_BLOCK;
+    if (threads <= 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    threads = (int)std::max<size_t>(1, std::min<size_t>(threads, blocks));
+
+    // every thread gets a run of whole blocks
+    auto range = [&](int t) { return std::min(count, blocks * t / threads * BATCH_BLOCK); };
+
+    std::vector<size_t> invalid(threads, 0);
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) {
+        pool.emplace_back([&, t] { invalid[t] = evaluateBatchRange(positions, range(t), range(t + 1), scores); });
+    }
+    invalid[0] = evaluateBatchRange(positions, range(0), range(1), scores);
+    for (std::thread &thread : pool) thread.join();
+
+    size_t total = 0;
+    for (size_t n : invalid) total += n;
+    return total;
+}
+
+const EvalStats& Evaluation::stats() {
+    return evalStats;
+}
+
+void Evaluation::clearStats() {
+    evalStats = EvalStats();
+}
+
+void Evaluation::setCacheSize(int megabytes) {
+    size_t bytes = (size_t)megabytes * 1024 * 1024;
+
+    // round down to a power of two so the index is a mask of the key
+    size_t entries = 1;
+    while (entries * 2 * sizeof(EvalCacheEntry) <= bytes) entries *= 2;
+
+    evalCacheEntries.store((megabytes > 0) ? entries : 0, std::memory_order_relaxed);
+}
+
+void Evaluation::clearCache() {
+    evalCacheGeneration.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Evaluation::clearThreadCache() {
+    evalCache.assign(evalCacheEntries.load(std::memory_order_relaxed), EvalCacheEntry{0, 0});
+    threadCacheGeneration = evalCacheGeneration.load(std::memory_order_relaxed);
+}
@@ -2,13 +2,84 @@
 #define CHESS_EVALUATION_HPP
 
 #include "Board.hpp"
+#include "PackedPosition.hpp"
+#include <cstddef>
+#include <cstdint>
 
+struct Accumulator;
+
+struct EvalStats {
+    // how often the lazy evaluation returned before reaching each stage
+    uint64_t calls = 0;
+    uint64_t skippedPawns = 0;    // returned after material + PST
+    uint64_t skippedMobility = 0; // returned after pawn structure
+
+    // eval cache usage
+    uint64_t cacheProbes = 0;
+    uint64_t cacheHits = 0;
+};
+
+// how often each evaluation parameter contributes to a position, white minus black
+// the hand written evaluation is the sum of every parameter times its coefficient (used by the tuner)
+struct EvalTrace {
+    int pieceValues[6];
+    int pawnTable[64];
+    int knightTable[64];
+    int bishopTable[64];
+    int rookTable[64];
+    int queenTable[64];
+    int kingTable[64];
+    int kingEndgameTable[64];
+    int doubledPawnPenalty;
+    int isolatedPawnPenalty;
+    int passedPawnBonus[8];
+    int mobilityWeights[6];
+    int kingAttackWeight;
+    int pawnShieldBonus;
+};
 
 class Evaluation {
     public:
         // returns a score for the given board state
         // postive is good for white, negative is good for black
         static int evaluate(Board &board);
+
+        // same score as above, but the stages are evaluated cheapest first and the
+        // function returns early once the remaining stages can't bring the score back inside (alpha, beta)
+        // accumulator is the nnue first layer of board when the caller keeps one (the search), otherwise the network computes it
+        static int evaluate(Board &board, int alpha, int beta, const Accumulator *accumulator = nullptr);
+
+        // fills in the coefficients of every parameter for the full (non lazy) hand written evaluation
+        static void trace(const Board &board, EvalTrace &trace);
+
+        // full evaluation of many positions at once, scores[i] is from white's point of view
+        // material and PST are summed for blocks of positions with vector gathers, the blocks are split between threads (0 = all cores)
+        // the eval cache is not used, invalid records score 0 and the number of them is returned
+        static size_t evaluateBatch(const PackedPosition* positions, size_t count, int* scores, int threads = 0);
+
+        static const EvalStats& stats();
+        static void clearStats();
+
+        // size of the eval cache in MB (0 disables it), every thread owns a cache of this size
+        static void setCacheSize(int megabytes);
+
+        // drops every thread's cached scores, needed whenever the evaluation function changes
+        static void clearCache();
+
+        // drops only the calling thread's cached scores, so a search doesn't depend on what the thread evaluated before
+        static void clearThreadCache();
+
+    private:
+        // every stage is scored from white's point of view
+        static int materialAndPST(const Board &board);
+        static int pawnStructure(const Board &board);
+        static int mobilityAndKingSafety(const Board &board);
+
+        // the most the pawn and the mobility stage can move the score by, bounds for the lazy exits
+        static int pawnMargin(const Board &board);
+        static int mobilityMargin(const Board &board);
+
+        static size_t evaluateBatchRange(const PackedPosition* positions, size_t from, size_t to, int* scores);
 };
 
-#endif
\ No newline at end of file
+#endif
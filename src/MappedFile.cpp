@@ -0,0 +1,109 @@
+#include "MappedFile.hpp"
+
+#include <algorithm>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string &path, bool sequential) {
+    close();
+
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    if (info.st_size > 0) {
+        void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            ::close(fd);
+            return false;
+        }
+        madvise(data, (size_t)info.st_size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+        mapping = data;
+        bytes = static_cast<const char*>(data);
+        length = (size_t)info.st_size;
+    }
+    ::close(fd); // the mapping stays valid without the descriptor
+#else
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    // an empty file can't be mapped, it opens with no data like on posix
+    if (size.QuadPart > 0) {
+        HANDLE section = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* data = section ? MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (section) CloseHandle(section); // the view keeps the section alive
+        if (!data) {
+            CloseHandle(file);
+            return false;
+        }
+
+        mapping = data;
+        bytes = static_cast<const char*>(data);
+        length = (size_t)size.QuadPart;
+    }
+    CloseHandle(file);
+#endif
+
+    return true;
+}
+
+void MappedFile::close() {
+#ifndef _WIN32
+    if (mapping) munmap(mapping, length);
+#else
+    if (mapping) UnmapViewOfFile(mapping);
+#endif
+    mapping = nullptr;
+    bytes = nullptr;
+    length = 0;
+}
+
+void MappedFile::prefetch(size_t offset, size_t count) const {
+#ifndef _WIN32
+    if (!mapping || offset >= length) return;
+    count = std::min(count, length - offset);
+
+    // madvise wants a page aligned start
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = offset / pageSize * pageSize;
+    madvise(static_cast<char*>(mapping) + start, offset + count - start, MADV_WILLNEED);
+#elif defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+    if (!mapping || offset >= length) return;
+
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = static_cast<char*>(mapping) + offset;
+    range.NumberOfBytes = std::min(count, length - offset);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    (void)offset;
+    (void)count;
+#endif
+}
@@ -0,0 +1,32 @@
+#ifndef CHESS_MAPPEDFILE_HPP
+#define CHESS_MAPPEDFILE_HPP
+
+#include <cstddef>
+#include <string>
+
+// read only memory mapping of a whole file, mmap on posix and a file mapping view on windows
+class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        // sequential = the file is mostly read front to back, so the os can read further ahead
+        bool open(const std::string &path, bool sequential);
+        void close();
+
+        const char* data() const { return bytes; }
+        size_t size() const { return length; }
+
+        // asks the os to read the byte range ahead, so a scan doesn't stall on the disk
+        void prefetch(size_t offset, size_t count) const;
+
+    private:
+        const char* bytes = nullptr;
+        size_t length = 0;
+        void* mapping = nullptr;
+};
+
+#endif
@@ -0,0 +1,346 @@
+#include "Match.hpp"
+#include "Board.hpp"
+#include "Epd.hpp"
+#include "Evaluation.hpp"
+#include "MoveGen.hpp"
+#include "NNUE.hpp"
+#include "PackedPosition.hpp"
+#include "ThreadPool.hpp"
+#include "Parse.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// scores beyond this count as mate for adjudication
+#define MATCH_MATE_SCORE 30000
+
+static const char* endingNames[ENDING_COUNT] = {"mate", "draw rule", "adjudicated draw", "resign", "time", "max plies"};
+
+// both engines evaluate alike, so one evaluation cache serves them both
+static bool sameEvaluation(const MatchEngine &a, const MatchEngine &b) {
+    return a.nnue == b.nnue && (!a.nnue || a.evalFile == b.evalFile);
+}
+
+int Match::playGame(const MatchOptions &options, const std::string &fen, int white, int &ending) {
+    Board board(fen);
+    std::vector<U64> history{board.getHash()};
+    int64_t clocks[2] = {options.baseMs, options.baseMs};
+
+    bool shareCache = sameEvaluation(options.engines[0], options.engines[1]);
+    Evaluation::clearThreadCache();
+
+    int drawPlies = 0;
+    int resignPlies = 0;
+    int resignSign = 0;
+    int lastEngine = -1;
+
+    auto finish = [&](int result, int how) {
+        NNUE::clearThreadSettings();
+        ending = how;
+        return result;
+    };
+
+    for (int ply = 0; ply < MATCH_MAX_PLIES; ply++) {
+        int side = board.sideToMove();
+        int loss = (side == WHITE) ? RESULT_BLACK_WIN : RESULT_WHITE_WIN;
+
+        std::vector<Move> legal = MoveGen::generateLegalMoves(board);
+        if (legal.empty()) return MoveGen::inCheck(board) ? finish(loss, ENDING_MATE) : finish(RESULT_DRAW, ENDING_DRAW_RULE);
+        if (board.getHalfMoves() >= 100 || board.insufficientMaterial()
+            || std::count(history.begin(), history.end(), board.getHash()) >= 3) {
+            return finish(RESULT_DRAW, ENDING_DRAW_RULE);
+        }
+
+        int engineIndex = (side == WHITE) ? white : 1 - white;
+        const MatchEngine &engine = options.engines[engineIndex];
+        if (engineIndex != lastEngine) {
+            NNUE::setThreadSettings(engine.nnue, engine.weights.get());
+            if (!shareCache && lastEngine >= 0) Evaluation::clearThreadCache();
+            lastEngine = engineIndex;
+        }
+
+        SearchLimits limits = engine.limits;
+        bool timed = !limits.depth && !limits.nodes && !limits.timeMs;
+        if (timed) limits.timeMs = std::max<int64_t>(1, std::min(clocks[side] / MATCH_MOVES_TO_GO + options.incMs * 3 / 4, clocks[side] / 2));
+
+        auto start = std::chrono::steady_clock::now();
+        SearchResult result = Search::analyze(board, limits);
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+        if (timed) {
+            clocks[side] -= elapsed;
+            if (clocks[side] < 0) return finish(loss, ENDING_TIME);
+            clocks[side] += options.incMs;
+        }
+
+        Move move = result.bestMove ? result.bestMove : legal[0];
+
+        // adjudication works on white's point of view
+        int score = result.mateIn ? (result.mateIn > 0 ? MATCH_MATE_SCORE : -MATCH_MATE_SCORE) : result.score;
+        if (side == BLACK) score = -score;
+
+        drawPlies = (std::abs(score) <= options.drawScore) ? drawPlies + 1 : 0;
+        if (drawPlies >= 2 * options.drawMoves && ply / 2 + 1 >= options.drawMoveNumber) {
+            return finish(RESULT_DRAW, ENDING_ADJUDICATED_DRAW);
+        }
+
+        int sign = (score >= options.resignScore) - (score <= -options.resignScore);
+        resignPlies = (sign != 0 && sign == resignSign) ? resignPlies + 1 : (sign != 0);
+        resignSign = sign;
+        if (resignPlies >= 2 * options.resignMoves) {
+            return finish(sign > 0 ? RESULT_WHITE_WIN : RESULT_BLACK_WIN, ENDING_RESIGN);
+        }
+
+        board.makeMove(move);
+        history.push_back(board.getHash());
+    }
+
+    return finish(RESULT_DRAW, ENDING_MAX_PLIES);
+}
+
+// expected score of an elo difference
+static double eloToScore(double elo) {
+    return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+}
+
+static double scoreToElo(double score) {
+    score = std::clamp(score, 1e-6, 1 - 1e-6);
+    return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+// game pair results (0, 0.5 .. 2 points for engine a) as mean and variance of the per game score
+static bool pairStatistics(const uint64_t pairs[5], double &mean, double &variance, uint64_t &count) {
+    count = 0;
+    double sum = 0;
+    for (int i = 0; i < 5; i++) {
+        count += pairs[i];
+        sum += pairs[i] * (i / 4.0);
+    }
+    if (count == 0) return false;
+
+    mean = sum / count;
+    variance = 0;
+    for (int i = 0; i < 5; i++) variance += pairs[i] * (i / 4.0 - mean) * (i / 4.0 - mean);
+    variance /= count;
+    return variance > 0;
+}
+
+// log likelihood ratio of elo1 against elo0 from the pentanomial counts (normal approximation)
+static double sprtLlr(const uint64_t pairs[5], double elo0, double elo1) {
+    double mean, variance;
+    uint64_t count;
+    if (!pairStatistics(pairs, mean, variance, count)) return 0;
+
+    double s0 = eloToScore(elo0);
+    double s1 = eloToScore(elo1);
+    return count * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance);
+}
+
+// false if name isn't an engine option, valid is cleared (and the bad value reported) when it is one but the value isn't usable
+static bool setEngineOption(MatchEngine &engine, const std::string &name, const std::string &value, bool &valid) {
+    if (name == "name") engine.name = value;
+    else if (name == "nnue") engine.nnue = (value == "true");
+    else if (name == "evalfile") engine.evalFile = value;
+    else if (name == "nodes") valid = parseOption(name, value, (uint64_t)0, UINT64_MAX, engine.limits.nodes);
+    else if (name == "depth") valid = parseOption(name, value, 0, MAX_PLY, engine.limits.depth);
+    else if (name == "movetime") valid = parseOption(name, value, (int64_t)0, INT64_MAX, engine.limits.timeMs);
+    else return false;
+    return true;
+}
+
+// seconds of a "base+inc" time control in milliseconds
+static bool parseTimeControl(const std::string &value, int64_t &baseMs, int64_t &incMs) {
+    size_t plus = value.find('+');
+    double base = 0, inc = 0;
+    if (!parseValue(std::string_view(value).substr(0, plus), 0.0, 1e6, base)) return false;
+    if (plus != std::string::npos && !parseValue(std::string_view(value).substr(plus + 1), 0.0, 1e6, inc)) return false;
+
+    baseMs = (int64_t)(base * 1000);
+    incMs = (int64_t)(inc * 1000);
+    return true;
+}
+
+int Match::run(int argc, char* argv[]) {
+    if (argc < 3 || (argc - 3) % 2 != 0) {
+        if (argc >= 3) std::cerr << "missing value for " << argv[argc - 1] << std::endl;
+        std::cout << "usage: nice.exe match <openings.epd> [games N] [concurrency N] [tc base+inc] [elo0 E] [elo1 E] [alpha A] [beta B]"
+                  << " [drawmovenumber N] [drawmoves N] [drawscore cp] [resignmoves N] [resignscore cp]"
+                  << " [[a.|b.]name|nnue|evalfile|nodes|depth|movetime value]..." << std::endl;
+        return 1;
+    }
+
+    std::string openingsPath = argv[2];
+    MatchOptions options;
+
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string name = argv[i];
+        std::string value = argv[i + 1];
+
+        bool valid = true;
+        if (name == "games") valid = parseOption(name, value, 1, 100000000, options.games);
+        else if (name == "concurrency") valid = parseOption(name, value, 0, 1024, options.concurrency);
+        else if (name == "tc") {
+            valid = parseTimeControl(value, options.baseMs, options.incMs);
+            if (!valid) std::cerr << "invalid value " << value << " for tc, expected seconds as base+inc" << std::endl;
+        }
+        else if (name == "elo0") valid = parseOption(name, value, -1000.0, 1000.0, options.elo0);
+        else if (name == "elo1") valid = parseOption(name, value, -1000.0, 1000.0, options.elo1);
+        else if (name == "alpha" || name == "beta") {
+            // error rates, the sprt bounds are logs of alpha, beta and their complements
+            double &rate = (name == "alpha") ? options.alpha : options.beta;
+            valid = parseOption(name, value, 0.0, 1.0, rate);
+            if (valid && (rate <= 0 || rate >= 1)) {
+                std::cerr << name << " must be between 0 and 1 (exclusive), got " << value << std::endl;
+                valid = false;
+            }
+        }
+        else if (name == "drawmovenumber") valid = parseOption(name, value, 0, MATCH_MAX_PLIES, options.drawMoveNumber);
+        else if (name == "drawmoves") valid = parseOption(name, value, 0, MATCH_MAX_PLIES, options.drawMoves);
+        else if (name == "drawscore") valid = parseOption(name, value, 0, 100000, options.drawScore);
+        else if (name == "resignmoves") valid = parseOption(name, value, 0, MATCH_MAX_PLIES, options.resignMoves);
+        else if (name == "resignscore") valid = parseOption(name, value, 0, 100000, options.resignScore);
+        else if (name.rfind("a.", 0) == 0 || name.rfind("b.", 0) == 0) {
+            if (!setEngineOption(options.engines[name[0] - 'a'], name.substr(2), value, valid)) std::cerr << "unknown option " << name << std::endl;
+        } else {
+            bool known = setEngineOption(options.engines[0], name, value, valid) && (!valid || setEngineOption(options.engines[1], name, value, valid));
+            if (!known) std::cerr << "unknown option " << name << std::endl;
+        }
+        if (!valid) return 1;
+    }
+
+    int concurrency = options.concurrency;
+    int cores = (int)std::max(1u, std::thread::hardware_concurrency());
+    if (concurrency <= 0) concurrency = cores;
+
+    for (MatchEngine &engine : options.engines) {
+        if (engine.evalFile.empty()) continue;
+        engine.weights = std::make_shared<NetworkWeights>();
+        if (!NNUE::loadWeights(engine.evalFile, *engine.weights)) {
+            std::cerr << "could not load network " << engine.evalFile << std::endl;
+            return 1;
+        }
+    }
+
+    bool timed = false;
+    for (const MatchEngine &engine : options.engines) {
+        timed |= !engine.limits.depth && !engine.limits.nodes && !engine.limits.timeMs;
+    }
+    if (timed && concurrency > cores) {
+        std::cerr << "warning: " << concurrency << " concurrent timed games on " << cores << " cores, the engines get less time than the clock says" << std::endl;
+    }
+
+    std::ifstream in(openingsPath);
+    if (!in) {
+        std::cerr << "could not read " << openingsPath << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> openings;
+    std::string line;
+    while (std::getline(in, line)) {
+        EpdEntry entry;
+        if (!Epd::parse(line, entry)) continue;
+
+        Board board;
+        const char *error = nullptr;
+        if (!board.setFen(entry.fen, &error)) {
+            std::cerr << "invalid opening (" << error << "): " << entry.fen << std::endl;
+            continue;
+        }
+        openings.push_back(entry.fen);
+    }
+    if (openings.empty()) {
+        std::cerr << "no openings in " << openingsPath << std::endl;
+        return 1;
+    }
+
+    double lowerBound = std::log(options.beta / (1 - options.alpha));
+    double upperBound = std::log((1 - options.beta) / options.alpha);
+    int totalPairs = (options.games + 1) / 2;
+
+    std::cout << options.engines[0].name << " vs " << options.engines[1].name << ": " << totalPairs * 2 << " games from "
+              << openings.size() << " openings, " << concurrency << " at a time, sprt elo0 " << options.elo0
+              << " elo1 " << options.elo1 << " bounds [" << lowerBound << ", " << upperBound << "]" << std::endl;
+
+    std::mutex statsMutex;
+    uint64_t pairs[5] = {};     // pairs by engine a's points: 0, 0.5, 1, 1.5, 2
+    uint64_t wins = 0, losses = 0, draws = 0;
+    uint64_t endings[ENDING_COUNT] = {};
+    double llr = 0;
+    std::atomic<bool> decided{false};
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        // every pair plays one opening with swapped colours, which cancels most of the opening's bias
+        ThreadPool pool(concurrency);
+        for (int pair = 0; pair < totalPairs; pair++) {
+            pool.submit([&, pair]() {
+                if (decided) return;
+
+                const std::string &fen = openings[pair % openings.size()];
+                int firstEnding, secondEnding;
+                int first = playGame(options, fen, 0, firstEnding);
+                int second = playGame(options, fen, 1, secondEnding);
+
+                // results are white's point of view, 0/1/2 = loss/draw/win for engine a with white in the first game
+                int firstPoints = first;
+                int secondPoints = 2 - second;
+
+                std::lock_guard<std::mutex> lock(statsMutex);
+                if (decided) return;
+
+                pairs[firstPoints + secondPoints]++;
+                for (int points : {firstPoints, secondPoints}) {
+                    if (points == 2) wins++;
+                    else if (points == 0) losses++;
+                    else draws++;
+                }
+                endings[firstEnding]++;
+                endings[secondEnding]++;
+
+                double mean = 0.5, variance = 0;
+                uint64_t count = 0;
+                pairStatistics(pairs, mean, variance, count);
+                double margin = count > 1 ? 1.96 * std::sqrt(variance / count) : 0.5;
+                double elo = scoreToElo(mean);
+                double error = (scoreToElo(std::min(1.0, mean + margin)) - scoreToElo(std::max(0.0, mean - margin))) / 2;
+
+                llr = sprtLlr(pairs, options.elo0, options.elo1);
+                if (llr <= lowerBound || llr >= upperBound) decided = true;
+
+                std::cout << std::fixed << std::setprecision(2)
+                          << "games " << 2 * count << "  W " << wins << " L " << losses << " D " << draws
+                          << "  elo " << elo << " +- " << error << "  llr " << llr
+                          << "  pentanomial [" << pairs[0] << " " << pairs[1] << " " << pairs[2] << " " << pairs[3] << " " << pairs[4] << "]"
+                          << std::defaultfloat << std::setprecision(6) << std::endl;
+            });
+        }
+        pool.wait();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t games = wins + losses + draws;
+
+    std::cout << "===========================" << std::endl;
+    std::cout << "Games           : " << games << " (" << options.engines[0].name << " +" << wins << " -" << losses << " =" << draws << ")" << std::endl;
+    std::cout << "Endings         :";
+    for (int i = 0; i < ENDING_COUNT; i++) {
+        if (endings[i]) std::cout << " " << endingNames[i] << " " << endings[i];
+    }
+    std::cout << std::endl;
+    std::cout << "SPRT            : llr " << llr << " [" << lowerBound << ", " << upperBound << "], ";
+    if (llr >= upperBound) std::cout << "H1 accepted (elo >= " << options.elo1 << ")" << std::endl;
+    else if (llr <= lowerBound) std::cout << "H0 accepted (elo <= " << options.elo0 << ")" << std::endl;
+    else std::cout << "no verdict" << std::endl;
+    std::cout << "Time (s)        : " << seconds << " (" << games / std::max(1e-9, seconds) << " games/s)" << std::endl;
+    std::cout << "===========================" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#ifndef CHESS_MATCH_HPP
+#define CHESS_MATCH_HPP
+
+#include "Search.hpp"
+#include <memory>
+#include <string>
+
+struct NetworkWeights;
+
+// a timed move gets the remaining time divided by this, plus most of the increment
+#define MATCH_MOVES_TO_GO 30
+
+// games still running after this many plies are drawn
+#define MATCH_MAX_PLIES 600
+
+// one side of a match, both play in the same process with per thread evaluation settings
+struct MatchEngine {
+    explicit MatchEngine(const char* name) : name(name) {}
+
+    std::string name;
+    bool nnue = false;
+    std::string evalFile;                       // network of the engine, empty for the engine's current one
+    std::shared_ptr<NetworkWeights> weights;    // loaded from evalFile
+    SearchLimits limits;                        // fixed limits per move, the time control is used when none are set
+};
+
+struct MatchOptions {
+    int games = 1000;           // played in pairs, each opening once with either colour
+    int concurrency = 0;        // games played at the same time, 0 = all cores
+    int64_t baseMs = 10000;     // time control per game
+    int64_t incMs = 100;
+
+    // adjudication: drawn when both scores stay within drawScore for drawMoves moves from move drawMoveNumber on,
+    // won when both agree one side is resignScore ahead for resignMoves moves
+    int drawMoveNumber = 40;
+    int drawMoves = 8;
+    int drawScore = 10;
+    int resignMoves = 3;
+    int resignScore = 600;
+
+    // sprt of elo1 against elo0 (logistic elo) with error rates alpha and beta
+    double elo0 = 0;
+    double elo1 = 5;
+    double alpha = 0.05;
+    double beta = 0.05;
+
+    MatchEngine engines[2] = {MatchEngine("a"), MatchEngine("b")}; // renamed with a.name / b.name
+};
+
+// how a game ended
+enum MatchEnding {
+    ENDING_MATE,
+    ENDING_DRAW_RULE,       // stalemate, fifty moves, threefold repetition or insufficient material
+    ENDING_ADJUDICATED_DRAW,
+    ENDING_RESIGN,
+    ENDING_TIME,
+    ENDING_MAX_PLIES,
+    ENDING_COUNT
+};
+
+class Match {
+    public:
+        // entry point for "nice.exe match <openings.epd> [games N] [concurrency N] [tc base+inc] [elo0 E] [elo1 E]
+        // [alpha A] [beta B] [drawmovenumber N] [drawmoves N] [drawscore cp] [resignmoves N] [resignscore cp]
+        // [engine option value]...", engine options (name, nnue, evalfile, nodes, depth, movetime) go to both engines
+        // or, prefixed with a. or b., to one of them; games run concurrently and a live sprt stops the match at a verdict
+        static int run(int argc, char* argv[]);
+
+    private:
+        // plays one game, engines[white] has the white pieces; returns the PackedResult and sets ending
+        static int playGame(const MatchOptions &options, const std::string &fen, int white, int &ending);
+};
+
+#endif
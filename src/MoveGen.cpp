@@ -2,6 +2,7 @@
 #include "Move.hpp"
 #include "BitUtils.hpp"
 #include "Types.hpp"
+#include "Profile.hpp"
 
 // static lookup tables for king and knight attacks
 // table will include attacking bitmask for every square
@@ -82,28 +83,33 @@ std::vector<Move> MoveGen::generateLegalMoves(const Board &board) {
     std::vector<Move> legalMoves;
     legalMoves.reserve(pseudoMoves.size()); // reserve max moves to not need to resize vector
 
-    int side = board.activeColour;
-    int kingType = (side == WHITE) ? WK : BK;
-
     for (const Move& move: pseudoMoves){
-        // make move on copy of board
-        Board nextBoard = board;
-        nextBoard.makeMove(move);
-
-        // find where king is
-        int kingSquare = getLSB(nextBoard.bitboards[kingType]);
-
-        // check if king is in danger
-        if(!isSquareAttacked(nextBoard, kingSquare, nextBoard.activeColour)){
-            legalMoves.push_back(move);
-        }
+        if (isLegal(board, move)) legalMoves.push_back(move);
     }
 
     return legalMoves;
 }
 
+bool MoveGen::isLegal(const Board &board, Move move) {
+    int kingType = (board.activeColour == WHITE) ? WK : BK;
+
+    // make move on copy of board
+    Board nextBoard = board;
+    nextBoard.makeMove(move);
+
+    // find where king is and check if it is in danger
+    int kingSquare = getLSB(nextBoard.bitboards[kingType]);
+    return !isSquareAttacked(nextBoard, kingSquare, nextBoard.activeColour);
+}
+
+bool MoveGen::inCheck(const Board &board) {
+    int kingType = (board.activeColour == WHITE) ? WK : BK;
+    return isSquareAttacked(board, getLSB(board.bitboards[kingType]), board.activeColour ^ 1);
+}
+
 // move generator
 std::vector<Move> MoveGen::generateMoves(const Board &board){
+    PROFILE_SCOPE(PROFILE_GENERATE_MOVES);
 
     // if king/knight attack tables have not been initialised
     if (!isInitialised) initTables();
@@ -120,6 +126,7 @@ std::vector<Move> MoveGen::generateMoves(const Board &board){
 }
 
 void MoveGen::generateKnightMoves(const Board &board, std::vector<Move> &moveList){
+    PROFILE_SCOPE(PROFILE_GENERATE_KNIGHT_MOVES);
     int side = board.activeColour;
     int enemy = (side == WHITE) ? BLACK : WHITE;
     
@@ -155,6 +162,7 @@ void MoveGen::generateKnightMoves(const Board &board, std::vector<Move> &moveLis
 }
 
 void MoveGen::generateKingMoves(const Board &board, std::vector<Move> &moveList){
+    PROFILE_SCOPE(PROFILE_GENERATE_KING_MOVES);
     int side = board.activeColour;
     
     int kingType = (side == WHITE) ? WK : BK;
@@ -247,6 +255,7 @@ void MoveGen::generateKingMoves(const Board &board, std::vector<Move> &moveList)
 }
 
 void MoveGen::generateSlidingMoves(const Board &board, std::vector<Move> &moveList){
+    PROFILE_SCOPE(PROFILE_GENERATE_SLIDING_MOVES);
     int side = board.activeColour;
 
     // get occupancy bitboards
@@ -332,6 +341,7 @@ void MoveGen::generateSlidingMoves(const Board &board, std::vector<Move> &moveLi
 }
 
 void MoveGen::generatePawnMoves(const Board &board, std::vector<Move> &moveList){
+    PROFILE_SCOPE(PROFILE_GENERATE_PAWN_MOVES);
 
     int side = board.activeColour;
     
@@ -518,6 +528,8 @@ void MoveGen::generatePawnMoves(const Board &board, std::vector<Move> &moveList)
 
 
 bool MoveGen::isSquareAttacked(const Board& board, int square, int attackingColour){
+    PROFILE_SCOPE(PROFILE_IS_SQUARE_ATTACKED);
+
     // if king/knight attack tables have not been initialised
     if (!isInitialised) initTables();
     
@@ -597,4 +609,199 @@ bool MoveGen::isSquareAttacked(const Board& board, int square, int attackingColo
     // passes all the checks for all pieces so must not be attacked
     return false;
 
-}
\ No newline at end of file
+}
+// walks each direction from the square until it leaves the board or hits a blocker
+static U64 rayAttacks(int square, U64 occupancy, const int* directions) {
+    U64 attacks = 0;
+
+    for (int i = 0; i < 4; ++i) {
+        int dir = directions[i];
+        int t = square;
+
+        while (true) {
+            // stop before wrapping around the A or H file
+            if ((dir == WEST || dir == NORTH_WEST || dir == SOUTH_WEST) && (t % 8) == 0) break;
+            if ((dir == EAST || dir == NORTH_EAST || dir == SOUTH_EAST) && (t % 8) == 7) break;
+
+            t += dir;
+            if (t < SQ_A1 || t > SQ_H8) break;
+
+            setBit(attacks, t);
+
+            if (getBit(occupancy, t)) break; // blocker, square is still attacked
+        }
+    }
+
+    return attacks;
+}
+
+U64 MoveGen::knightAttacksFrom(int square){
+    if (!isInitialised) initTables();
+    return knightAttacks[square];
+}
+
+U64 MoveGen::kingAttacksFrom(int square){
+    if (!isInitialised) initTables();
+    return kingAttacks[square];
+}
+
+U64 MoveGen::bishopAttacks(int square, U64 occupancy){
+    static const int bishopDirections[] = {NORTH_EAST, SOUTH_EAST, SOUTH_WEST, NORTH_WEST};
+    return rayAttacks(square, occupancy, bishopDirections);
+}
+
+U64 MoveGen::rookAttacks(int square, U64 occupancy){
+    static const int rookDirections[] = {NORTH, EAST, SOUTH, WEST};
+    return rayAttacks(square, occupancy, rookDirections);
+}
+
+// squares attacked by all pawns of one colour
+static U64 pawnAttacks(U64 pawns, int colour) {
+    const U64 notA = 0xFEFEFEFEFEFEFEFEULL;
+    const U64 notH = 0x7F7F7F7F7F7F7F7FULL;
+
+    if (colour == WHITE) return ((pawns & notA) << 7) | ((pawns & notH) << 9);
+    return ((pawns & notA) >> 9) | ((pawns & notH) >> 7);
+}
+
+// squares strictly between two squares on the same rank, file or diagonal
+static U64 squaresBetween(int a, int b) {
+    bool straight = (a % 8 == b % 8) || (a / 8 == b / 8);
+
+    if (straight) return MoveGen::rookAttacks(a, 1ULL << b) & MoveGen::rookAttacks(b, 1ULL << a);
+    return MoveGen::bishopAttacks(a, 1ULL << b) & MoveGen::bishopAttacks(b, 1ULL << a);
+}
+
+int MoveGen::countLegalMoves(const Board& board) {
+    if (!isInitialised) initTables();
+
+    int us = board.activeColour;
+    int them = (us == WHITE) ? BLACK : WHITE;
+    int offset = (us == WHITE) ? 0 : 6;
+    int enemyOffset = 6 - offset;
+
+    U64 kingBitboard = board.bitboards[WK + offset];
+    if (!kingBitboard) return (int)generateLegalMoves(board).size();
+
+    int king = getLSB(kingBitboard);
+    U64 own = board.bitboards[(us == WHITE) ? WHITE_OCC : BLACK_OCC];
+    U64 enemy = board.bitboards[(us == WHITE) ? BLACK_OCC : WHITE_OCC];
+    U64 occupancy = board.bitboards[ALL_OCC];
+
+    U64 enemyPawns = board.bitboards[WP + enemyOffset];
+    U64 enemyKnights = board.bitboards[WN + enemyOffset];
+    U64 enemyBishopsQueens = board.bitboards[WB + enemyOffset] | board.bitboards[WQ + enemyOffset];
+    U64 enemyRooksQueens = board.bitboards[WR + enemyOffset] | board.bitboards[WQ + enemyOffset];
+
+    // squares the king can't step to, sliders see through the king so it can't step back along a checking line
+    U64 danger = pawnAttacks(enemyPawns, them) | kingAttacks[getLSB(board.bitboards[WK + enemyOffset])];
+    U64 withoutKing = occupancy ^ kingBitboard;
+
+    U64 bitboard = enemyKnights;
+    while (bitboard) danger |= knightAttacks[popLSB(bitboard)];
+    bitboard = enemyBishopsQueens;
+    while (bitboard) danger |= bishopAttacks(popLSB(bitboard), withoutKing);
+    bitboard = enemyRooksQueens;
+    while (bitboard) danger |= rookAttacks(popLSB(bitboard), withoutKing);
+
+    int count = popCount(kingAttacks[king] & ~own & ~danger);
+
+    U64 checkers = (pawnAttacks(kingBitboard, us) & enemyPawns) | (knightAttacks[king] & enemyKnights)
+                 | (bishopAttacks(king, occupancy) & enemyBishopsQueens) | (rookAttacks(king, occupancy) & enemyRooksQueens);
+
+    // only the king can answer a double check
+    if (popCount(checkers) > 1) return count;
+
+    // other pieces must capture the checker or block the check
+    U64 targets = ~own;
+    if (checkers) {
+        int checker = getLSB(checkers);
+        targets = checkers | squaresBetween(king, checker);
+    }
+
+    // a piece alone between the king and an enemy slider may only move along that line
+    U64 pinned = 0;
+    U64 pinRays[64];
+
+    U64 pinners = (rookAttacks(king, enemy) & enemyRooksQueens) | (bishopAttacks(king, enemy) & enemyBishopsQueens);
+    while (pinners) {
+        int pinner = popLSB(pinners);
+        U64 between = squaresBetween(king, pinner);
+        U64 blockers = between & occupancy;
+
+        if (popCount(blockers) == 1 && (blockers & own)) {
+            pinned |= blockers;
+            pinRays[getLSB(blockers)] = between | (1ULL << pinner);
+        }
+    }
+
+    // knights can never leave a pin
+    bitboard = board.bitboards[WN + offset] & ~pinned;
+    while (bitboard) count += popCount(knightAttacks[popLSB(bitboard)] & targets);
+
+    for (int piece = WB; piece <= WQ; ++piece) {
+        bitboard = board.bitboards[piece + offset];
+        while (bitboard) {
+            int from = popLSB(bitboard);
+            U64 attacks = 0;
+
+            if (piece != WR) attacks |= bishopAttacks(from, occupancy);
+            if (piece != WB) attacks |= rookAttacks(from, occupancy);
+
+            attacks &= targets;
+            if (pinned & (1ULL << from)) attacks &= pinRays[from];
+            count += popCount(attacks);
+        }
+    }
+
+    // pawns one at a time, a move onto the last rank counts once per promotion piece
+    int forward = (us == WHITE) ? NORTH : SOUTH;
+    U64 startRank = (us == WHITE) ? 0x000000000000FF00ULL : 0x00FF000000000000ULL;
+    U64 lastRank = (us == WHITE) ? 0xFF00000000000000ULL : 0x00000000000000FFULL;
+
+    bitboard = board.bitboards[WP + offset];
+    while (bitboard) {
+        int from = popLSB(bitboard);
+        U64 fromBit = 1ULL << from;
+        U64 moves = 0;
+
+        U64 single = (us == WHITE) ? fromBit << 8 : fromBit >> 8;
+        if (!(single & occupancy)) {
+            moves |= single;
+
+            U64 twice = (us == WHITE) ? fromBit << 16 : fromBit >> 16;
+            if ((fromBit & startRank) && !(twice & occupancy)) moves |= twice;
+        }
+
+        moves |= pawnAttacks(fromBit, us) & enemy;
+        moves &= targets;
+        if (pinned & fromBit) moves &= pinRays[from];
+
+        count += popCount(moves & ~lastRank) + 4 * popCount(moves & lastRank);
+
+        // en passant removes two pieces from the board, so it's simplest to check the resulting position directly
+        if (board.ep_target != NO_SQ && (pawnAttacks(fromBit, us) & (1ULL << board.ep_target))) {
+            int capturedSquare = board.ep_target - forward;
+            U64 after = (occupancy ^ fromBit ^ (1ULL << capturedSquare)) | (1ULL << board.ep_target);
+            U64 remainingPawns = enemyPawns & ~(1ULL << capturedSquare);
+
+            bool inCheck = (pawnAttacks(kingBitboard, us) & remainingPawns) || (knightAttacks[king] & enemyKnights)
+                        || (bishopAttacks(king, after) & enemyBishopsQueens) || (rookAttacks(king, after) & enemyRooksQueens);
+            if (!inCheck) count++;
+        }
+    }
+
+    // castling, with the same conditions as generateKingMoves
+    if (!checkers) {
+        int rights = board.castlingRights;
+        if (us == WHITE) {
+            if ((rights & WK_CA) && !(occupancy & ((1ULL << SQ_F1) | (1ULL << SQ_G1))) && !(danger & ((1ULL << SQ_F1) | (1ULL << SQ_G1)))) count++;
+            if ((rights & WQ_CA) && !(occupancy & ((1ULL << SQ_B1) | (1ULL << SQ_C1) | (1ULL << SQ_D1))) && !(danger & ((1ULL << SQ_C1) | (1ULL << SQ_D1)))) count++;
+        } else {
+            if ((rights & BK_CA) && !(occupancy & ((1ULL << SQ_F8) | (1ULL << SQ_G8))) && !(danger & ((1ULL << SQ_F8) | (1ULL << SQ_G8)))) count++;
+            if ((rights & BQ_CA) && !(occupancy & ((1ULL << SQ_B8) | (1ULL << SQ_C8) | (1ULL << SQ_D8))) && !(danger & ((1ULL << SQ_C8) | (1ULL << SQ_D8)))) count++;
+        }
+    }
+
+    return count;
+}
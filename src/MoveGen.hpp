@@ -12,6 +12,22 @@ public:
     static std::vector<Move> generateMoves(const Board& board);
     static bool isSquareAttacked(const Board& board, int square, int attackingColour);
 
+    // true if the side to move's king is attacked
+    static bool inCheck(const Board& board);
+
+    // true if the pseudo legal move doesn't leave the mover's king in check
+    static bool isLegal(const Board& board, Move move);
+
+    // number of legal moves without generating or making them, from checks and pins
+    // (0 means checkmate or stalemate, perft uses it to count the last ply)
+    static int countLegalMoves(const Board& board);
+
+    // attack bitboards for a piece standing on the given square
+    static U64 knightAttacksFrom(int square);
+    static U64 kingAttacksFrom(int square);
+    static U64 bishopAttacks(int square, U64 occupancy); // stops at (and includes) the first blocker in each direction
+    static U64 rookAttacks(int square, U64 occupancy);
+
 private:
     // functions generate moves for specific pieces
     static void generatePawnMoves(const Board& board, std::vector<Move>& moveList);
@@ -0,0 +1,374 @@
+#include "NNUE.hpp"
+#include "Board.hpp"
+#include "BitUtils.hpp"
+#include "Types.hpp"
+
+#include <fstream>
+#include <memory>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+static const char NNUE_MAGIC[8] = {'N', 'I', 'C', 'E', 'N', 'N', 'U', 'E'};
+static const uint32_t NNUE_VERSION = 1;
+
+// king buckets from the perspective's own side of the board: 4 rank groups times the king or queen side
+static const int kingBuckets[64] = {
+    0, 0, 0, 0, 1, 1, 1, 1,
+    2, 2, 2, 2, 3, 3, 3, 3,
+    4, 4, 4, 4, 5, 5, 5, 5,
+    4, 4, 4, 4, 5, 5, 5, 5,
+    6, 6, 6, 6, 7, 7, 7, 7,
+    6, 6, 6, 6, 7, 7, 7, 7,
+    6, 6, 6, 6, 7, 7, 7, 7,
+    6, 6, 6, 6, 7, 7, 7, 7,
+};
+
+static std::unique_ptr<NetworkWeights> net;
+static std::string netName;
+static bool nnueEnabled = false;
+
+// per thread settings of setThreadSettings, they win over the globals while set
+static thread_local bool threadOverride = false;
+static thread_local bool threadEnabled = false;
+static thread_local const NetworkWeights* threadNet = nullptr;
+
+void NNUE::setEnabled(bool enabled) {
+    if (!net) useBuiltIn();
+    nnueEnabled = enabled;
+}
+
+bool NNUE::isEnabled() {
+    return threadOverride ? threadEnabled : nnueEnabled;
+}
+
+void NNUE::setThreadSettings(bool enabled, const NetworkWeights* weights) {
+    if (!net) useBuiltIn();
+    threadOverride = true;
+    threadEnabled = enabled;
+    threadNet = weights;
+}
+
+void NNUE::clearThreadSettings() {
+    threadOverride = false;
+    threadNet = nullptr;
+}
+
+const NetworkWeights& NNUE::network() {
+    if (threadNet) return *threadNet;
+    if (!net) useBuiltIn();
+    return *net;
+}
+
+const std::string& NNUE::networkName() {
+    if (!net) useBuiltIn();
+    return netName;
+}
+
+int NNUE::featureIndex(int perspective, int kingSquare, int piece, int square) {
+    // flip the board for black so "our" pieces always start at the bottom
+    int flip = (perspective == WHITE) ? 0 : 56;
+    int relativeColour = ((piece < BP) == (perspective == WHITE)) ? 0 : 1;
+
+    return kingBuckets[kingSquare ^ flip] * 768 + (relativeColour * 6 + piece % 6) * 64 + (square ^ flip);
+}
+
+// the built in network reproduces the material + PST evaluation (with the middlegame king table):
+// feature neuron 0 holds the material balance in 8 centipawn units and neuron 1 in 64 centipawn units,
+// both centred on 64. The hidden layer passes the fine neuron through and extracts how far the coarse
+// neuron is beyond the fine neuron's range, so the output follows the evaluation up to +-512 and coarsely beyond
+// that. It isn't exact: every weight is truncated to whole 8 (fine) and 64 (coarse) centipawn units, which is
+// up to 7 centipawns off per piece on the board.
+void NNUE::useBuiltIn() {
+    auto weights = std::make_unique<NetworkWeights>();
+    std::memset(weights.get(), 0, sizeof(NetworkWeights));
+
+    const int* tables[] = {pawnTable, knightTable, bishopTable, rookTable, queenTable, kingTable};
+
+    for (int bucket = 0; bucket < NNUE_KING_BUCKETS; ++bucket) {
+        for (int type = WP; type <= WK; ++type) {
+            for (int square = 0; square < 64; ++square) {
+                // kings are always on the board, only their square matters
+                int ours = ((type == WK) ? 0 : pieceValues[type]) + tables[type][square];
+                int theirs = ((type == WK) ? 0 : pieceValues[type]) + tables[type][square ^ 56];
+
+                int16_t* ourRow = &weights->featureWeights[(bucket * 768 + type * 64 + square) * NNUE_HIDDEN];
+                int16_t* theirRow = &weights->featureWeights[(bucket * 768 + (6 + type) * 64 + square) * NNUE_HIDDEN];
+
+                ourRow[0] = (int16_t)(ours / 8);
+                ourRow[1] = (int16_t)(ours / 64);
+                theirRow[0] = (int16_t)(-theirs / 8);
+                theirRow[1] = (int16_t)(-theirs / 64);
+            }
+        }
+    }
+    weights->featureBias[0] = 64;
+    weights->featureBias[1] = 64;
+
+    // hidden 0 = fine, hidden 1 = max(coarse - 72, 0), hidden 2 = max(56 - coarse, 0)
+    weights->hiddenWeights[0] = NNUE_WEIGHT_SCALE;
+    weights->hiddenWeights[2 * NNUE_HIDDEN + 1] = NNUE_WEIGHT_SCALE;
+    weights->hiddenBias[1] = -72 * NNUE_WEIGHT_SCALE;
+    weights->hiddenWeights[4 * NNUE_HIDDEN + 1] = -NNUE_WEIGHT_SCALE;
+    weights->hiddenBias[2] = 56 * NNUE_WEIGHT_SCALE;
+
+    // output in centipawns: 8 * (fine - 64) + 64 * (beyond +512) - 64 * (beyond -512)
+    weights->outputWeights[0] = 8;
+    weights->outputWeights[1] = 64;
+    weights->outputWeights[2] = -64;
+    weights->outputBias = -8 * 64;
+    weights->outputScale = NNUE_ACTIVATION_SCALE * NNUE_WEIGHT_SCALE;
+
+    net = std::move(weights);
+    netName = "<built-in>";
+}
+
+template <typename T>
+static bool readArray(std::ifstream &in, T* data, size_t count) {
+    in.read(reinterpret_cast<char*>(data), count * sizeof(T));
+    return (bool)in;
+}
+
+template <typename T>
+static bool writeArray(std::ofstream &out, const T* data, size_t count) {
+    out.write(reinterpret_cast<const char*>(data), count * sizeof(T));
+    return (bool)out;
+}
+
+/*
+File format (little endian)
+    char[8] "NICENNUE", uint32 version, uint32 inputs, uint32 hidden, uint32 l2, int32 output scale
+    int16 feature bias[hidden], int16 feature weights[inputs][hidden]
+    int32 hidden bias[l2], int8 hidden weights[l2][2 * hidden]
+    int32 output bias, int8 output weights[l2]
+*/
+bool NNUE::load(const std::string &path) {
+    auto weights = std::make_unique<NetworkWeights>();
+    if (!loadWeights(path, *weights)) return false;
+
+    net = std::move(weights);
+    netName = path;
+    return true;
+}
+
+bool NNUE::loadWeights(const std::string &path, NetworkWeights &weights) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+
+    char magic[8];
+    uint32_t header[4];
+    int32_t outputScale;
+
+    if (!readArray(in, magic, 8) || std::memcmp(magic, NNUE_MAGIC, 8) != 0) return false;
+    if (!readArray(in, header, 4) || !readArray(in, &outputScale, 1)) return false;
+    if (header[0] != NNUE_VERSION || header[1] != NNUE_INPUTS || header[2] != NNUE_HIDDEN || header[3] != NNUE_L2) return false;
+
+    weights.outputScale = outputScale;
+    return readArray(in, weights.featureBias, NNUE_HIDDEN)
+        && readArray(in, weights.featureWeights, (size_t)NNUE_INPUTS * NNUE_HIDDEN)
+        && readArray(in, weights.hiddenBias, NNUE_L2)
+        && readArray(in, weights.hiddenWeights, NNUE_L2 * 2 * NNUE_HIDDEN)
+        && readArray(in, &weights.outputBias, 1)
+        && readArray(in, weights.outputWeights, NNUE_L2);
+}
+
+bool NNUE::save(const std::string &path, const NetworkWeights &weights) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+
+    uint32_t header[4] = {NNUE_VERSION, NNUE_INPUTS, NNUE_HIDDEN, NNUE_L2};
+
+    return writeArray(out, NNUE_MAGIC, 8)
+        && writeArray(out, header, 4)
+        && writeArray(out, &weights.outputScale, 1)
+        && writeArray(out, weights.featureBias, NNUE_HIDDEN)
+        && writeArray(out, weights.featureWeights, (size_t)NNUE_INPUTS * NNUE_HIDDEN)
+        && writeArray(out, weights.hiddenBias, NNUE_L2)
+        && writeArray(out, weights.hiddenWeights, NNUE_L2 * 2 * NNUE_HIDDEN)
+        && writeArray(out, &weights.outputBias, 1)
+        && writeArray(out, weights.outputWeights, NNUE_L2);
+}
+
+// --- SIMD kernels ---
+
+// accumulator += weights row
+static inline void addRow(int16_t* acc, const int16_t* row) {
+#if defined(__AVX2__)
+    for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+        __m256i a = _mm256_load_si256((const __m256i*)(acc + i));
+        __m256i w = _mm256_load_si256((const __m256i*)(row + i));
+        _mm256_store_si256((__m256i*)(acc + i), _mm256_add_epi16(a, w));
+    }
+#elif defined(__SSE4_1__)
+    for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+        __m128i a = _mm_load_si128((const __m128i*)(acc + i));
+        __m128i w = _mm_load_si128((const __m128i*)(row + i));
+        _mm_store_si128((__m128i*)(acc + i), _mm_add_epi16(a, w));
+    }
+#else
+    for (int i = 0; i < NNUE_HIDDEN; ++i) acc[i] += row[i];
+#endif
+}
+
+// accumulator -= weights row
+static inline void subRow(int16_t* acc, const int16_t* row) {
+#if defined(__AVX2__)
+    for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+        __m256i a = _mm256_load_si256((const __m256i*)(acc + i));
+        __m256i w = _mm256_load_si256((const __m256i*)(row + i));
+        _mm256_store_si256((__m256i*)(acc + i), _mm256_sub_epi16(a, w));
+    }
+#elif defined(__SSE4_1__)
+    for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+        __m128i a = _mm_load_si128((const __m128i*)(acc + i));
+        __m128i w = _mm_load_si128((const __m128i*)(row + i));
+        _mm_store_si128((__m128i*)(acc + i), _mm_sub_epi16(a, w));
+    }
+#else
+    for (int i = 0; i < NNUE_HIDDEN; ++i) acc[i] -= row[i];
+#endif
+}
+
+// clamp int16 values to [0, 127] and narrow them to bytes
+static inline void clippedRelu16(const int16_t* input, uint8_t* output, int size) {
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    for (int i = 0; i < size; i += 32) {
+        __m256i a = _mm256_load_si256((const __m256i*)(input + i));
+        __m256i b = _mm256_load_si256((const __m256i*)(input + i + 16));
+        // packs works per 128 bit lane, the permute puts the bytes back in order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8);
+        _mm256_store_si256((__m256i*)(output + i), _mm256_max_epi8(packed, zero));
+    }
+#elif defined(__SSE4_1__)
+    const __m128i zero = _mm_setzero_si128();
+    for (int i = 0; i < size; i += 16) {
+        __m128i a = _mm_load_si128((const __m128i*)(input + i));
+        __m128i b = _mm_load_si128((const __m128i*)(input + i + 8));
+        _mm_store_si128((__m128i*)(output + i), _mm_max_epi8(_mm_packs_epi16(a, b), zero));
+    }
+#else
+    for (int i = 0; i < size; ++i) {
+        int v = input[i];
+        output[i] = (uint8_t)(v < 0 ? 0 : (v > 127 ? 127 : v));
+    }
+#endif
+}
+
+// dot product of unsigned activations with signed weights, size is a multiple of 32
+static inline int32_t dotProduct(const uint8_t* input, const int8_t* weights, int size) {
+#if defined(__AVX2__)
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < size; i += 32) {
+        __m256i a = _mm256_load_si256((const __m256i*)(input + i));
+        __m256i w = _mm256_load_si256((const __m256i*)(weights + i));
+        // u8 x i8 -> pairs summed to i16 (127 * 127 * 2 fits) -> pairs summed to i32
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(a, w), ones));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+    return _mm_cvtsi128_si32(s);
+#elif defined(__SSE4_1__)
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < size; i += 16) {
+        __m128i a = _mm_load_si128((const __m128i*)(input + i));
+        __m128i w = _mm_load_si128((const __m128i*)(weights + i));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(a, w), ones));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int32_t sum = 0;
+    for (int i = 0; i < size; ++i) sum += input[i] * weights[i];
+    return sum;
+#endif
+}
+
+// --- accumulator ---
+
+void NNUE::refreshPerspective(const Board &board, Accumulator &accumulator, int perspective) {
+    const NetworkWeights &weights = NNUE::network();
+    int16_t* acc = accumulator.values[perspective];
+    int kingSquare = getLSB(board.bitboards[(perspective == WHITE) ? WK : BK]);
+
+    std::memcpy(acc, weights.featureBias, sizeof(weights.featureBias));
+
+    for (int piece = WP; piece <= BK; ++piece) {
+        U64 bitboard = board.bitboards[piece];
+        while (bitboard) {
+            int square = popLSB(bitboard);
+            addRow(acc, &weights.featureWeights[NNUE::featureIndex(perspective, kingSquare, piece, square) * NNUE_HIDDEN]);
+        }
+    }
+}
+
+void NNUE::refreshAccumulator(const Board &board, Accumulator &accumulator) {
+    refreshPerspective(board, accumulator, WHITE);
+    refreshPerspective(board, accumulator, BLACK);
+}
+
+void NNUE::updateAccumulator(const Board &board, const Accumulator &parent, Accumulator &child, const FeatureDelta &delta) {
+    const NetworkWeights &weights = network();
+    int mover = (board.activeColour == WHITE) ? BLACK : WHITE; // makeMove has already switched sides
+    bool kingMoved = delta.removedPiece[0] == WK || delta.removedPiece[0] == BK;
+
+    for (int perspective = WHITE; perspective <= BLACK; ++perspective) {
+        // a king move changes the bucket and every feature of its own perspective
+        if (kingMoved && perspective == mover) {
+            refreshPerspective(board, child, perspective);
+            continue;
+        }
+
+        int16_t* acc = child.values[perspective];
+        int kingSquare = getLSB(board.bitboards[(perspective == WHITE) ? WK : BK]);
+        std::memcpy(acc, parent.values[perspective], sizeof(parent.values[perspective]));
+
+        for (int i = 0; i < delta.removedCount; ++i) {
+            subRow(acc, &weights.featureWeights[featureIndex(perspective, kingSquare, delta.removedPiece[i], delta.removedSquare[i]) * NNUE_HIDDEN]);
+        }
+        for (int i = 0; i < delta.addedCount; ++i) {
+            addRow(acc, &weights.featureWeights[featureIndex(perspective, kingSquare, delta.addedPiece[i], delta.addedSquare[i]) * NNUE_HIDDEN]);
+        }
+    }
+}
+
+// --- inference ---
+
+int NNUE::evaluate(const Board &board) {
+    Accumulator accumulator;
+    refreshAccumulator(board, accumulator);
+    return evaluate(board, accumulator);
+}
+
+int NNUE::evaluate(const Board &board, const Accumulator &accumulator) {
+    const NetworkWeights &weights = network();
+
+    int us = board.activeColour;
+    int them = (us == WHITE) ? BLACK : WHITE;
+
+    // side to move's perspective first
+    alignas(32) uint8_t transformed[2 * NNUE_HIDDEN];
+    clippedRelu16(accumulator.values[us], transformed, NNUE_HIDDEN);
+    clippedRelu16(accumulator.values[them], transformed + NNUE_HIDDEN, NNUE_HIDDEN);
+
+    alignas(32) uint8_t hidden[NNUE_L2];
+    for (int i = 0; i < NNUE_L2; ++i) {
+        int32_t sum = weights.hiddenBias[i] + dotProduct(transformed, &weights.hiddenWeights[i * 2 * NNUE_HIDDEN], 2 * NNUE_HIDDEN);
+        sum >>= NNUE_WEIGHT_SHIFT;
+        hidden[i] = (uint8_t)(sum < 0 ? 0 : (sum > 127 ? 127 : sum));
+    }
+
+    int32_t output = weights.outputBias;
+    for (int i = 0; i < NNUE_L2; ++i) output += hidden[i] * weights.outputWeights[i];
+
+    // output / (127 * 64) is the network's output of 1.0
+    return (int)((int64_t)output * weights.outputScale / (NNUE_ACTIVATION_SCALE * NNUE_WEIGHT_SCALE));
+}
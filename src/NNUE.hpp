@@ -0,0 +1,94 @@
+#ifndef CHESS_NNUE_HPP
+#define CHESS_NNUE_HPP
+
+#include <cstdint>
+#include <string>
+
+class Board;
+
+/*
+Network layout (all integer inference)
+    feature transformer : 6144 king relative inputs -> 64 int16 per perspective
+    hidden layer        : 2 x 64 clipped relu (uint8) -> 16, int8 weights, int32 biases
+    output layer        : 16 clipped relu (uint8) -> 1, int8 weights, int32 bias
+
+Features are (king bucket, piece colour relative to the perspective, piece type, square) with
+the board flipped vertically for black, so both perspectives share one set of weights.
+*/
+constexpr int NNUE_KING_BUCKETS = 8;
+constexpr int NNUE_INPUTS = NNUE_KING_BUCKETS * 768;
+constexpr int NNUE_HIDDEN = 64;
+constexpr int NNUE_L2 = 16;
+
+// quantisation: activations use 127 for 1.0 and layer weights use 64 for 1.0
+constexpr int NNUE_ACTIVATION_SCALE = 127;
+constexpr int NNUE_WEIGHT_SCALE = 64;
+constexpr int NNUE_WEIGHT_SHIFT = 6;
+
+// first layer outputs for both perspectives, the search keeps one per ply
+struct Accumulator {
+    alignas(32) int16_t values[2][NNUE_HIDDEN];
+};
+
+// features removed and added by a single move (a capture with promotion touches 3 squares),
+// written by Board::makeMove with the moving piece always first among the removed ones
+struct FeatureDelta {
+    int removedCount = 0;
+    int addedCount = 0;
+    int removedPiece[2], removedSquare[2];
+    int addedPiece[2], addedSquare[2];
+};
+
+struct NetworkWeights {
+    alignas(32) int16_t featureWeights[NNUE_INPUTS * NNUE_HIDDEN];
+    alignas(32) int16_t featureBias[NNUE_HIDDEN];
+    alignas(32) int8_t hiddenWeights[NNUE_L2 * 2 * NNUE_HIDDEN];
+    alignas(32) int32_t hiddenBias[NNUE_L2];
+    alignas(32) int8_t outputWeights[NNUE_L2];
+    int32_t outputBias;
+    int32_t outputScale; // centipawns for an output of 1.0
+};
+
+class NNUE {
+    public:
+        // use the network instead of the hand written evaluation
+        static void setEnabled(bool enabled);
+        static bool isEnabled();
+
+        // loads weights in the format written by save(), keeps the current network on failure
+        static bool load(const std::string &path);
+        static bool save(const std::string &path, const NetworkWeights &weights);
+
+        // reads a network file without making it the engine's network, weights may be partly written on failure
+        static bool loadWeights(const std::string &path, NetworkWeights &weights);
+
+        // evaluation settings of the calling thread only, so one process can search with several configurations
+        // (weights == nullptr uses the engine's network), until clearThreadSettings goes back to the globals
+        static void setThreadSettings(bool enabled, const NetworkWeights* weights);
+        static void clearThreadSettings();
+
+        // small network built from the piece values and PSTs, used until a file is loaded
+        static void useBuiltIn();
+
+        static const NetworkWeights& network();
+        static const std::string& networkName();
+
+        // score from the side to move's point of view, accumulator holds the first layer of board
+        static int evaluate(const Board &board, const Accumulator &accumulator);
+
+        // same, with the first layer computed from scratch (outside a search)
+        static int evaluate(const Board &board);
+
+        // feature index for a piece seen from the given perspective
+        static int featureIndex(int perspective, int kingSquare, int piece, int square);
+
+        static void refreshAccumulator(const Board &board, Accumulator &accumulator);
+
+        // child = parent after the move, board is the position after the move and delta what makeMove reported for it
+        static void updateAccumulator(const Board &board, const Accumulator &parent, Accumulator &child, const FeatureDelta &delta);
+
+    private:
+        static void refreshPerspective(const Board &board, Accumulator &accumulator, int perspective);
+};
+
+#endif
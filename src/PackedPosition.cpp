@@ -0,0 +1,122 @@
+#include "PackedPosition.hpp"
+#include "Board.hpp"
+#include "BitUtils.hpp"
+#include "MoveGen.hpp"
+
+#include <algorithm>
+
+PackedPosition PackedPosition::pack(const Board &board, int score, int result, Move played) {
+    PackedPosition packed{};
+
+    packed.occupancy = board.bitboards[ALL_OCC];
+
+    // pieces are listed in square order so only the occupancy is needed to place them again
+    // setFen refuses boards with more than 32 pieces, should one get here anyway the pieces past the 32nd are
+    // dropped while the occupancy keeps them, so the record fails valid() instead of overrunning pieces[]
+    int n = 0;
+    U64 occupancy = packed.occupancy;
+    while (occupancy && n < 32) {
+        int square = popLSB(occupancy);
+        packed.pieces[n / 2] |= board.boardArr[square] << ((n % 2) * 4);
+        n++;
+    }
+
+    packed.state = board.activeColour | (result << 1) | (board.castlingRights << 3);
+    packed.halfMoves = (uint8_t)std::min(board.halfMoves, 255);
+    packed.fullMovesEp = std::min(board.fullMoves, 1023);
+    if (board.ep_target != NO_SQ) packed.fullMovesEp |= (board.ep_target % 8 + 1) << 10;
+    packed.score = score;
+
+    if (played) {
+        int promotion = (moveFlags(played) & PROMOTION) ? promo(played) % 6 : 0;
+        packed.move = fromSq(played) | (toSq(played) << 6) | (promotion << 12);
+    }
+
+    return packed;
+}
+
+bool PackedPosition::valid() const {
+    if (popCount(occupancy) > 32) return false;
+
+    U64 bitboards[12] = {};
+    int n = 0;
+    U64 occupied = occupancy;
+    while (occupied) {
+        int square = popLSB(occupied);
+        int code = piece(n++);
+        if (code > BK) return false;
+        bitboards[code] |= 1ULL << square;
+    }
+
+    if (popCount(bitboards[WK]) != 1 || popCount(bitboards[BK]) != 1) return false;
+    if ((bitboards[WP] | bitboards[BP]) & 0xFF000000000000FFULL) return false;
+
+    // the same rights setFen accepts
+    int castling = castlingRights();
+    auto on = [&](int piece, int square) { return (bitboards[piece] >> square) & 1; };
+    if (((castling & (WK_CA | WQ_CA)) && !on(WK, SQ_E1)) || ((castling & (BK_CA | BQ_CA)) && !on(BK, SQ_E8))
+        || ((castling & WK_CA) && !on(WR, SQ_H1)) || ((castling & WQ_CA) && !on(WR, SQ_A1))
+        || ((castling & BK_CA) && !on(BR, SQ_H8)) || ((castling & BQ_CA) && !on(BR, SQ_A8))) {
+        return false;
+    }
+
+    // the en passant square is empty with the pawn that just made the double push in front of it
+    if ((fullMovesEp >> 10) > 8) return false;
+    int ep = epSquare();
+    if (ep != NO_SQ) {
+        bool white = sideToMove() == WHITE;
+        if ((occupancy >> ep) & 1 || !on(white ? BP : WP, white ? ep - 8 : ep + 8)) return false;
+    }
+
+    return true;
+}
+
+void PackedPosition::unpackBitboards(U64 bitboards[16]) const {
+    for (int i = 0; i < 16; i++) bitboards[i] = 0;
+
+    int n = 0;
+    U64 occupancy = this->occupancy;
+    while (occupancy) {
+        int square = popLSB(occupancy);
+        bitboards[piece(n++)] |= 1ULL << square;
+    }
+
+    bitboards[WHITE_OCC] = bitboards[WP] | bitboards[WN] | bitboards[WB] | bitboards[WR] | bitboards[WQ] | bitboards[WK];
+    bitboards[BLACK_OCC] = bitboards[BP] | bitboards[BN] | bitboards[BB] | bitboards[BR] | bitboards[BQ] | bitboards[BK];
+    bitboards[ALL_OCC] = this->occupancy;
+}
+
+void PackedPosition::unpack(Board &board) const {
+    unpackBitboards(board.bitboards);
+
+    for (int square = 0; square < 64; square++) board.boardArr[square] = NO_PIECE;
+
+    int n = 0;
+    U64 occupancy = this->occupancy;
+    while (occupancy) {
+        int square = popLSB(occupancy);
+        board.boardArr[square] = piece(n++);
+    }
+
+    board.activeColour = sideToMove();
+    board.castlingRights = castlingRights();
+    board.ep_target = epSquare();
+    board.halfMoves = halfMoves;
+    board.fullMoves = fullMoves();
+    board.hashKey = board.computeHash();
+}
+
+Move PackedPosition::playedMove(const Board &board) const {
+    if (!move) return 0;
+
+    int from = move & 0x3F;
+    int to = (move >> 6) & 0x3F;
+    int promotion = move >> 12;
+
+    for (Move m : MoveGen::generateMoves(board)) {
+        if (fromSq(m) != from || toSq(m) != to) continue;
+        if (((moveFlags(m) & PROMOTION) ? promo(m) % 6 : 0) != promotion) continue;
+        return MoveGen::isLegal(board, m) ? m : 0;
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#ifndef CHESS_PACKEDPOSITION_HPP
+#define CHESS_PACKEDPOSITION_HPP
+
+#include "Types.hpp"
+#include "Move.hpp"
+#include <cstdint>
+
+class Board;
+
+// game result stored with a position, from white's point of view
+enum PackedResult {
+    RESULT_BLACK_WIN = 0,
+    RESULT_DRAW      = 1,
+    RESULT_WHITE_WIN = 2,
+    RESULT_UNKNOWN   = 3
+};
+
+/*
+32 byte position record used wherever positions are handled in bulk (batched evaluation, training data, .bin files)
+    occupancy   : bit set for every occupied square
+    pieces      : 4 bit piece codes (WP..BK) of the occupied squares from a1 to h8, low nibble first
+    state       : bit 0 side to move, bits 1-2 game result (PackedResult), bits 3-6 castling rights
+    halfMoves   : fifty move counter
+    fullMovesEp : bits 0-9 full move number (capped at 1023), bits 10-13 en passant file + 1 (0 if there is none),
+                  the rank follows from the side to move
+    score       : centipawns from white's point of view
+    move        : move played from the position, from | to << 6 | promotion << 12 (1 knight .. 4 queen), 0 if unknown
+files of records are little endian and have no header, record n starts at byte 32 * n
+*/
+struct PackedPosition {
+    U64 occupancy;
+    uint8_t pieces[16];
+    uint8_t state;
+    uint8_t halfMoves;
+    uint16_t fullMovesEp;
+    int16_t score;
+    uint16_t move;
+
+    int sideToMove() const { return state & 1; }
+    int result() const { return (state >> 1) & 3; }
+    int castlingRights() const { return (state >> 3) & 0xF; }
+    int fullMoves() const { return fullMovesEp & 0x3FF; }
+
+    int epSquare() const {
+        int file = fullMovesEp >> 10;
+        if (file == 0) return NO_SQ;
+        return (sideToMove() == WHITE ? 40 : 16) + file - 1;
+    }
+
+    void setResult(int gameResult) { state = (state & ~6) | (gameResult << 1); }
+
+    // piece code of the n-th occupied square
+    int piece(int n) const { return (pieces[n / 2] >> ((n % 2) * 4)) & 0xF; }
+
+    // false for records no board could have written: more than 32 pieces, unknown piece codes, not one king a side,
+    // pawns on the first or last rank, castling rights without king and rook or an en passant square without its pawn
+    // files are read as they are, so every consumer checks this before unpacking
+    bool valid() const;
+
+    static PackedPosition pack(const Board &board, int score = 0, int result = RESULT_UNKNOWN, Move played = 0);
+
+    // restores every field of the board, including the hash (the nnue accumulator is left to be refreshed)
+    void unpack(Board &board) const;
+
+    // fills the 12 piece bitboards and the 3 occupancy bitboards, cheaper than a full unpack
+    void unpackBitboards(U64 bitboards[16]) const;
+
+    // the stored move as a legal engine move of the unpacked board, 0 if there is none
+    Move playedMove(const Board &board) const;
+};
+
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition must stay 32 bytes");
+
+#endif
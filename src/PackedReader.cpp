@@ -0,0 +1,31 @@
+#include "PackedReader.hpp"
+
+#include <iostream>
+
+bool PackedReader::open(const std::string &path) {
+    close();
+
+    // consumers mostly scan front to back
+    if (!file.open(path, true)) return false;
+
+    records = reinterpret_cast<const PackedPosition*>(file.data());
+    count = file.size() / sizeof(PackedPosition);
+    if (file.size() % sizeof(PackedPosition)) {
+        std::cerr << "warning: " << path << " ends with a partial record, it is ignored" << std::endl;
+    }
+    return true;
+}
+
+void PackedReader::close() {
+    file.close();
+    records = nullptr;
+    count = 0;
+}
+
+void PackedReader::prefetch(size_t from, size_t length) const {
+    file.prefetch(from * sizeof(PackedPosition), length * sizeof(PackedPosition));
+}
+
+bool PackedReader::isPackedPath(const std::string &path) {
+    return path.size() >= 4 && path.compare(path.size() - 4, 4, ".bin") == 0;
+}
@@ -0,0 +1,34 @@
+#ifndef CHESS_PACKEDREADER_HPP
+#define CHESS_PACKEDREADER_HPP
+
+#include "PackedPosition.hpp"
+#include "MappedFile.hpp"
+#include <cstddef>
+#include <string>
+
+// read only view of a file of PackedPosition records
+// the file is memory mapped, so iterating over billions of records needs neither parsing nor copies
+class PackedReader {
+    public:
+        // a trailing partial record is ignored with a warning
+        bool open(const std::string &path);
+        void close();
+
+        size_t size() const { return count; }
+        const PackedPosition& operator[](size_t index) const { return records[index]; }
+        const PackedPosition* begin() const { return records; }
+        const PackedPosition* end() const { return records + count; }
+
+        // asks the os to read the records [from, from + length) ahead, so a scan doesn't stall on the disk
+        void prefetch(size_t from, size_t length) const;
+
+        // packed files are told apart from text data by their extension
+        static bool isPackedPath(const std::string &path);
+
+    private:
+        MappedFile file;
+        const PackedPosition* records = nullptr;
+        size_t count = 0;
+};
+
+#endif
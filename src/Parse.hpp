@@ -0,0 +1,34 @@
+#ifndef CHESS_PARSE_HPP
+#define CHESS_PARSE_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <string_view>
+#include <system_error>
+
+// number in value clamped to [min, max], false (and result left alone) if it isn't a number
+// used for uci spin options and command line options, nothing here throws
+template <typename T>
+inline bool parseValue(std::string_view value, T min, T max, T &result){
+    T parsed{};
+    auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), parsed);
+    if (value.empty() || end != value.data() + value.size()) return false;
+
+    // out of range numbers only fail to parse, they clamp like any other
+    if (ec == std::errc::result_out_of_range) parsed = (value[0] == '-') ? min : max;
+    else if (ec != std::errc()) return false;
+
+    result = std::clamp(parsed, min, max);
+    return true;
+}
+
+// parseValue for a command line option, a bad value is reported so the mode can return 1
+template <typename T>
+inline bool parseOption(std::string_view name, std::string_view value, T min, T max, T &result){
+    if (parseValue(value, min, max, result)) return true;
+    std::cerr << "invalid value " << value << " for " << name << std::endl;
+    return false;
+}
+
+#endif
@@ -1,10 +1,39 @@
 
 #include <iostream>
 #include <vector>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 #include "Perft.hpp"
 #include "MoveGen.hpp"
 #include "Move.hpp"
 #include "BitUtils.hpp"
+#include "ThreadPool.hpp"
+#include "UCI.hpp"
+#include "Zobrist.hpp"
+#include "Parse.hpp"
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// subtree counts keyed by position and remaining depth, written and read without locks by every perft thread
+// the key is stored xored with the data, so an entry torn by two threads writing at once simply doesn't match
+struct PerftEntry {
+    std::atomic<U64> check;
+    std::atomic<U64> data; // node count << 8 | depth
+};
+
+static std::unique_ptr<PerftEntry[]> perftTable;
+static U64 perftTableMask = 0;
+
+static std::atomic<uint64_t> perftProbes{0};
+static std::atomic<uint64_t> perftHits{0};
+
+// the same position at another depth has a different key, so both can be stored
+static U64 perftKey(const Board& board, int depth) {
+    return board.getHash() ^ (depth * 0x9E3779B97F4A7C15ULL);
+}
 
 uint64_t Perft::perft(Board& board, int depth){
     // base case
@@ -12,6 +41,11 @@ uint64_t Perft::perft(Board& board, int depth){
         return 1;
     }
 
+    // bulk counting, the last ply is counted without making its moves
+    if (depth == 1){
+        return MoveGen::countLegalMoves(board);
+    }
+
     std::vector<Move> moves = MoveGen::generateMoves(board);
 
     uint64_t nodes = 0; // number is probably huge so ensure 64bit unsigned int
@@ -42,6 +76,86 @@ uint64_t Perft::perft(Board& board, int depth){
 
 }
 
+uint64_t Perft::perftHashed(Board& board, int depth){
+    // depth 1 is bulk counted, that is cheaper than a probe
+    if (depth <= 1 || !perftTable) {
+        return perft(board, depth);
+    }
+
+    U64 key = perftKey(board, depth);
+    PerftEntry& entry = perftTable[key & perftTableMask];
+
+    perftProbes.fetch_add(1, std::memory_order_relaxed);
+    U64 data = entry.data.load(std::memory_order_relaxed);
+    if ((entry.check.load(std::memory_order_relaxed) ^ data) == key && (int)(data & 0xFF) == depth) {
+        perftHits.fetch_add(1, std::memory_order_relaxed);
+        return data >> 8;
+    }
+
+    std::vector<Move> moves = MoveGen::generateMoves(board);
+
+    uint64_t nodes = 0;
+
+    int kingType = (board.activeColour == WHITE) ? WK : BK;
+
+    for(const Move& move: moves){
+        Board nextBoard = board;
+        nextBoard.makeMove(move);
+
+        int kingSquare = -1;
+        if(board.bitboards[kingType]) {
+            kingSquare = getLSB(nextBoard.bitboards[kingType]);
+        }
+
+        if(MoveGen::isSquareAttacked(nextBoard, kingSquare, nextBoard.activeColour)){
+            continue;
+        }
+
+        nodes += perftHashed(nextBoard, depth-1);
+    }
+
+    // always replace, the newest entries are the ones the next siblings are most likely to transpose into
+    data = (nodes << 8) | (U64)depth;
+    entry.data.store(data, std::memory_order_relaxed);
+    entry.check.store(key ^ data, std::memory_order_relaxed);
+
+    return nodes;
+}
+
+void Perft::setHashSize(int megabytes) {
+    size_t bytes = (size_t)megabytes * 1024 * 1024;
+
+    // power of two entries so the index is a mask of the key
+    size_t entries = 1;
+    while (entries * 2 * sizeof(PerftEntry) <= bytes) entries *= 2;
+
+    if (megabytes <= 0) {
+        perftTable.reset();
+        perftTableMask = 0;
+        return;
+    }
+
+    perftTable = std::make_unique<PerftEntry[]>(entries);
+    perftTableMask = entries - 1;
+    clearHash();
+}
+
+void Perft::clearHash() {
+    for (U64 i = 0; perftTable && i <= perftTableMask; ++i) {
+        perftTable[i].check.store(0, std::memory_order_relaxed);
+        perftTable[i].data.store(0, std::memory_order_relaxed);
+    }
+    perftProbes = 0;
+    perftHits = 0;
+}
+
+PerftHashStats Perft::hashStats() {
+    PerftHashStats stats;
+    stats.probes = perftProbes.load();
+    stats.hits = perftHits.load();
+    return stats;
+}
+
 void Perft::perftDivide(Board& board, int depth){
     std::cout << "\n--- Perft Divide (Depth " << depth << ") ---\n";
 
@@ -80,3 +194,232 @@ void Perft::perftDivide(Board& board, int depth){
     std::cout << "-------------------------------\n";
 }
 
+
+// moves of the tree above this depth are run as separate tasks, the subtrees below
+// are counted by the plain recursive perft and keep at least 3 plies of work per task
+static int splitPlies(int depth) {
+    return std::clamp(depth - 4, 0, 2);
+}
+
+// same king check as perft above
+std::vector<std::pair<Move, Board>> Perft::legalChildren(const Board& board) {
+    int kingType = (board.activeColour == WHITE) ? WK : BK;
+    std::vector<std::pair<Move, Board>> children;
+
+    for (const Move& move : MoveGen::generateMoves(board)) {
+        Board nextBoard = board;
+        nextBoard.makeMove(move);
+
+        int kingSquare = board.bitboards[kingType] ? getLSB(nextBoard.bitboards[kingType]) : -1;
+        if (!MoveGen::isSquareAttacked(nextBoard, kingSquare, nextBoard.activeColour)) {
+            children.emplace_back(move, nextBoard);
+        }
+    }
+
+    return children;
+}
+
+// counts the subtree below board into nodes, the top split plies are expanded into subtasks that idle workers can steal
+void Perft::perftTask(ThreadPool& pool, const Board& board, int depth, int split, std::atomic<uint64_t>& nodes) {
+    if (split == 0 || depth <= 1) {
+        Board copy = board;
+        nodes.fetch_add(perftHashed(copy, depth), std::memory_order_relaxed);
+        return;
+    }
+
+    for (auto& child : legalChildren(board)) {
+        Board nextBoard = child.second;
+        pool.submit([&pool, nextBoard, depth, split, &nodes] {
+            perftTask(pool, nextBoard, depth - 1, split - 1, nodes);
+        });
+    }
+}
+
+// runs the root moves in parallel, nodes[i] ends up with the count below moves[i]
+void Perft::perftRoot(Board& board, int depth, int threads, std::vector<Move>& moves, std::vector<std::atomic<uint64_t>>& nodes) {
+    std::vector<std::pair<Move, Board>> children = legalChildren(board);
+
+    moves.clear();
+    for (auto& child : children) moves.push_back(child.first);
+    nodes = std::vector<std::atomic<uint64_t>>(children.size());
+
+    ThreadPool pool(threads);
+    for (size_t i = 0; i < children.size(); ++i) {
+        Board nextBoard = children[i].second;
+        std::atomic<uint64_t>* counter = &nodes[i];
+        pool.submit([&pool, nextBoard, depth, counter] {
+            perftTask(pool, nextBoard, depth - 1, splitPlies(depth), *counter);
+        });
+    }
+    pool.wait();
+}
+
+uint64_t Perft::perftParallel(Board& board, int depth, int threads) {
+    if (depth <= 1 || threads <= 1) {
+        return perftHashed(board, depth);
+    }
+
+    std::vector<Move> moves;
+    std::vector<std::atomic<uint64_t>> nodes;
+    perftRoot(board, depth, threads, moves, nodes);
+
+    uint64_t total = 0;
+    for (auto& count : nodes) total += count.load();
+    return total;
+}
+
+uint64_t Perft::perftDivideParallel(Board& board, int depth, int threads) {
+    if (depth < 1) depth = 1;
+
+    auto start = std::chrono::steady_clock::now();
+
+    PerftHashStats before = hashStats();
+
+    std::vector<Move> moves;
+    std::vector<std::atomic<uint64_t>> nodes;
+    perftRoot(board, depth, threads, moves, nodes);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < moves.size(); ++i) {
+        total += nodes[i].load();
+        std::cout << moveToString(moves[i], board) << ": " << nodes[i].load() << "\n";
+    }
+
+    std::cout << "\nNodes searched: " << total << "\n";
+    std::cout << "info string time " << (uint64_t)(seconds * 1000) << " ms nps " << (uint64_t)(total / std::max(seconds, 1e-9))
+              << " threads " << threads << std::endl;
+
+    if (perftTable) {
+        PerftHashStats after = hashStats();
+        uint64_t probes = after.probes - before.probes;
+        uint64_t hits = after.hits - before.hits;
+        std::cout << "info string perft hash probes " << probes << " hits " << hits
+                  << " (" << 100.0 * hits / std::max<uint64_t>(probes, 1) << "%)" << std::endl;
+    }
+
+    return total;
+}
+
+// one line of the suite, run at a single depth
+struct SuiteCase {
+    std::string fen;
+    int depth = 0;
+    uint64_t expected = 0;
+    uint64_t nodes = 0;
+    double seconds = 0;
+};
+
+// "fen ;D1 20 ;D2 400 ..." keeps the deepest depth up to maxDepth, the fen may leave out the move counters
+static bool parseSuiteLine(const std::string& line, int maxDepth, SuiteCase& suiteCase) {
+    size_t semicolon = line.find(';');
+    if (semicolon == std::string::npos) return false;
+
+    std::istringstream fields(line.substr(0, semicolon));
+    std::string field;
+    int fieldCount = 0;
+    while (fields >> field) {
+        suiteCase.fen += (fieldCount++ ? " " : "") + field;
+    }
+    if (fieldCount < 4) return false;
+    if (fieldCount == 4) suiteCase.fen += " 0 1";
+
+    std::istringstream entries(line.substr(semicolon));
+    std::string entry;
+    while (std::getline(entries, entry, ';')) {
+        std::istringstream ss(entry);
+        std::string name;
+        uint64_t count;
+
+        if (ss >> name >> count && name.size() > 1 && name[0] == 'D') {
+            int depth = 0;
+            if (!parseValue(std::string_view(name).substr(1), 1, PERFT_MAX_DEPTH, depth)) {
+                std::cerr << "skipping bad opcode " << name << ": " << suiteCase.fen << std::endl;
+                continue;
+            }
+            if (depth <= maxDepth && depth > suiteCase.depth) {
+                suiteCase.depth = depth;
+                suiteCase.expected = count;
+            }
+        }
+    }
+
+    return suiteCase.depth > 0;
+}
+
+int Perft::runSuite(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "usage: nice.exe perftsuite <file.epd> [depth N] [threads N] [hash MB]" << std::endl;
+        return 1;
+    }
+
+    std::string path = argv[2];
+    int maxDepth = 6;
+    int threads = 1;
+    int hash = 0;
+
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string name = argv[i];
+        std::string value = argv[i + 1];
+
+        bool valid = true;
+        if (name == "depth") valid = parseOption(name, value, 1, PERFT_MAX_DEPTH, maxDepth);
+        else if (name == "threads") valid = parseOption(name, value, 1, 128, threads);
+        else if (name == "hash") valid = parseOption(name, value, 0, 4096, hash);
+        else std::cerr << "unknown option " << name << std::endl;
+        if (!valid) return 1;
+    }
+
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "could not read " << path << std::endl;
+        return 1;
+    }
+
+    std::vector<SuiteCase> cases;
+    std::string line;
+    while (std::getline(file, line)) {
+        SuiteCase suiteCase;
+        if (parseSuiteLine(line, maxDepth, suiteCase)) cases.push_back(suiteCase);
+    }
+
+    setHashSize(hash);
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(threads);
+        for (SuiteCase& suiteCase : cases) {
+            pool.submit([&suiteCase] {
+                auto caseStart = std::chrono::steady_clock::now();
+                Board board(suiteCase.fen);
+                suiteCase.nodes = perftHashed(board, suiteCase.depth);
+                suiteCase.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - caseStart).count();
+            });
+        }
+        pool.wait();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t totalNodes = 0;
+    int failed = 0;
+
+    std::cout << "{\n  \"suite\": \"" << path << "\",\n  \"threads\": " << threads << ",\n  \"hash\": " << hash << ",\n  \"positions\": [\n";
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const SuiteCase& suiteCase = cases[i];
+        bool pass = suiteCase.nodes == suiteCase.expected;
+
+        totalNodes += suiteCase.nodes;
+        failed += !pass;
+
+        std::cout << "    {\"fen\": \"" << suiteCase.fen << "\", \"depth\": " << suiteCase.depth
+                  << ", \"expected\": " << suiteCase.expected << ", \"nodes\": " << suiteCase.nodes
+                  << ", \"pass\": " << (pass ? "true" : "false") << ", \"seconds\": " << suiteCase.seconds << "}"
+                  << (i + 1 < cases.size() ? "," : "") << "\n";
+    }
+    std::cout << "  ],\n  \"passed\": " << cases.size() - failed << ",\n  \"failed\": " << failed
+              << ",\n  \"nodes\": " << totalNodes << ",\n  \"seconds\": " << seconds
+              << ",\n  \"nps\": " << (uint64_t)(totalNodes / std::max(seconds, 1e-9)) << "\n}" << std::endl;
+
+    return failed ? 1 : 0;
+}
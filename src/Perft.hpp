@@ -2,7 +2,20 @@
 #define CHESS_PERFT_HPP
 
 #include "Board.hpp"
+#include <atomic>
 #include <cstdint>
+#include <utility>
+#include <vector>
+
+class ThreadPool;
+
+// deepest perft the command line modes accept, far beyond anything that finishes
+#define PERFT_MAX_DEPTH 32
+
+struct PerftHashStats {
+    uint64_t probes = 0;
+    uint64_t hits = 0;
+};
 
 class Perft {
     public:
@@ -12,6 +25,35 @@ class Perft {
 
     // prints the node count to console
     static void perftDivide(Board& board, int depth);
+
+    // same count as perft, but subtree counts are looked up in and stored to the perft hash table
+    // (plain perft while the table is disabled)
+    static uint64_t perftHashed(Board& board, int depth);
+
+    // size of the subtree count table in MB, 0 disables it. the table is shared by all threads
+    static void setHashSize(int megabytes);
+    static void clearHash();
+    static PerftHashStats hashStats();
+
+    // same count as perft, the tree is split into tasks a few plies below the root
+    // and the tasks run on a work stealing pool with the given number of threads, uses the hash table when it is enabled
+    static uint64_t perftParallel(Board& board, int depth, int threads);
+
+    // parallel perft that prints the nodes of every root move, the total and the speed (uci "go perft")
+    static uint64_t perftDivideParallel(Board& board, int depth, int threads);
+
+    // entry point for "nice.exe perftsuite <file.epd> [depth N] [threads N] [hash MB]"
+    // runs every position to its deepest listed depth (at most depth), positions are spread across threads,
+    // prints the results as json and returns non zero if any count is wrong
+    static int runSuite(int argc, char* argv[]);
+
+    private:
+
+    // legal moves paired with the positions they lead to
+    static std::vector<std::pair<Move, Board>> legalChildren(const Board& board);
+
+    static void perftTask(ThreadPool& pool, const Board& board, int depth, int split, std::atomic<uint64_t>& nodes);
+    static void perftRoot(Board& board, int depth, int threads, std::vector<Move>& moves, std::vector<std::atomic<uint64_t>>& nodes);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include "Pgn.hpp"
+#include "PackedPosition.hpp"
+
+bool PgnReader::open(const std::string &path) {
+    return file.open(path, true);
+}
+
+// start of the first game at or after offset: a tag line following an empty line (or the start of the text)
+static size_t nextGameStart(std::string_view text, size_t offset) {
+    if (offset == 0) return 0;
+
+    while (offset < text.size()) {
+        size_t newline = text.find('\n', offset - 1);
+        if (newline == std::string_view::npos) break;
+
+        size_t next = newline + 1;
+        if (next < text.size() && text[next] == '\r') next++;
+        if (next < text.size() && text[next] == '\n') {
+            next++;
+            while (next < text.size() && (text[next] == '\r' || text[next] == '\n')) next++;
+            if (next < text.size() && text[next] == '[') return next;
+        }
+        offset = newline + 2;
+    }
+    return text.size();
+}
+
+std::vector<std::string_view> PgnReader::chunks(size_t chunkBytes) const {
+    std::vector<std::string_view> pieces;
+    std::string_view all = text();
+
+    size_t start = 0;
+    while (start < all.size()) {
+        size_t end = nextGameStart(all, std::min(all.size(), start + chunkBytes));
+        pieces.push_back(all.substr(start, end - start));
+        start = end;
+    }
+    return pieces;
+}
+
+void PgnReader::prefetch(std::string_view chunk) const {
+    file.prefetch(chunk.data() - file.data(), chunk.size());
+}
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int parseResultToken(std::string_view token) {
+    if (token == "1-0") return RESULT_WHITE_WIN;
+    if (token == "0-1") return RESULT_BLACK_WIN;
+    if (token == "1/2-1/2") return RESULT_DRAW;
+    if (token == "*") return RESULT_UNKNOWN;
+    return -1;
+}
+
+size_t PgnReader::parse(std::string_view text, const std::function<void(const PgnGame&)> &onGame) {
+    PgnGame game;
+    game.moves.reserve(256);
+
+    size_t games = 0;
+    bool inGame = false;      // tags or moves of a game have been seen
+    bool inMoves = false;     // the movetext has started, the next tag begins a new game
+    int tagResult = -1;
+
+    auto reset = [&]() {
+        game.fen = {};
+        game.result = RESULT_UNKNOWN;
+        game.moves.clear();
+        inGame = inMoves = false;
+        tagResult = -1;
+    };
+    auto finish = [&](int markerResult) {
+        game.result = tagResult >= 0 ? tagResult : (markerResult >= 0 ? markerResult : RESULT_UNKNOWN);
+        onGame(game);
+        games++;
+        reset();
+    };
+    reset();
+
+    size_t i = 0;
+    size_t n = text.size();
+    while (i < n) {
+        char c = text[i];
+
+        if (isSpace(c)) {
+            i++;
+            continue;
+        }
+
+        if (c == '[') {
+            if (inMoves) finish(-1); // previous game had no termination marker
+
+            // [Name "value"]
+            size_t nameStart = ++i;
+            while (i < n && !isSpace(text[i]) && text[i] != ']') i++;
+            std::string_view name = text.substr(nameStart, i - nameStart);
+
+            while (i < n && text[i] != '"' && text[i] != ']') i++;
+            std::string_view value;
+            if (i < n && text[i] == '"') {
+                size_t valueStart = ++i;
+                while (i < n && text[i] != '"' && text[i] != '\n') i += (text[i] == '\\') ? 2 : 1;
+                value = text.substr(valueStart, std::min(i, n) - valueStart);
+            }
+            while (i < n && text[i] != ']' && text[i] != '\n') i++;
+            i++;
+
+            if (name == "FEN") game.fen = value;
+            else if (name == "Result") tagResult = parseResultToken(value);
+            inGame = true;
+            continue;
+        }
+
+        if (c == '{') {
+            size_t close = text.find('}', i);
+            i = close == std::string_view::npos ? n : close + 1;
+            continue;
+        }
+
+        // rest of line comments and escaped lines
+        if (c == ';' || (c == '%' && (i == 0 || text[i - 1] == '\n'))) {
+            size_t newline = text.find('\n', i);
+            i = newline == std::string_view::npos ? n : newline + 1;
+            continue;
+        }
+
+        // variations may nest and hold comments of their own
+        if (c == '(') {
+            int depth = 0;
+            while (i < n) {
+                if (text[i] == '(') depth++;
+                else if (text[i] == ')' && --depth == 0) { i++; break; }
+                else if (text[i] == '{') {
+                    size_t close = text.find('}', i);
+                    if (close == std::string_view::npos) { i = n; break; }
+                    i = close;
+                }
+                i++;
+            }
+            continue;
+        }
+
+        if (c == ')') {
+            i++;
+            continue;
+        }
+
+        size_t tokenStart = i;
+        while (i < n && !isSpace(text[i]) && text[i] != '{' && text[i] != '(' && text[i] != ')' && text[i] != '[' && text[i] != ';') i++;
+        std::string_view token = text.substr(tokenStart, i - tokenStart);
+
+        inGame = inMoves = true;
+
+        if (token[0] == '$') continue; // numeric annotation glyph
+
+        int result = parseResultToken(token);
+        if (result >= 0) {
+            finish(result);
+            continue;
+        }
+
+        // move numbers, "12." or "12..." on their own or glued to the move
+        size_t digits = 0;
+        while (digits < token.size() && token[digits] >= '0' && token[digits] <= '9') digits++;
+        if (digits && digits < token.size() && token[digits] == '.') {
+            while (digits < token.size() && token[digits] == '.') digits++;
+            token.remove_prefix(digits);
+        }
+        if (token.empty()) continue;
+
+        game.moves.push_back(token);
+    }
+
+    if (inGame) finish(-1);
+    return games;
+}
@@ -0,0 +1,39 @@
+#ifndef CHESS_PGN_HPP
+#define CHESS_PGN_HPP
+
+#include "MappedFile.hpp"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// one game of a pgn file, the views point into the text the game was parsed from
+struct PgnGame {
+    std::string_view fen;               // FEN tag, empty when the game starts from the standard position
+    int result;                         // PackedResult, from the Result tag or else the game termination marker
+    std::vector<std::string_view> moves; // san of the main line, move numbers, comments, nags and variations removed
+};
+
+// memory mapped pgn file, split into chunks of whole games that can be parsed independently
+class PgnReader {
+    public:
+        bool open(const std::string &path);
+
+        size_t size() const { return file.size(); }
+        std::string_view text() const { return std::string_view(file.data(), file.size()); }
+
+        // the text cut into pieces of about chunkBytes, every cut is made where a game's tags begin
+        std::vector<std::string_view> chunks(size_t chunkBytes) const;
+
+        // asks the os to read a chunk ahead of its parsing
+        void prefetch(std::string_view chunk) const;
+
+        // calls onGame for every game of the text (the game is reused, copy what is kept), returns the number of games
+        static size_t parse(std::string_view text, const std::function<void(const PgnGame&)> &onGame);
+
+    private:
+        MappedFile file;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef CHESS_POLYGLOT_HPP
+#define CHESS_POLYGLOT_HPP
+
+#include "Types.hpp"
+#include "Move.hpp"
+#include <cstdint>
+
+class Board;
+
+// bytes per book entry on disk
+#define POLYGLOT_ENTRY_SIZE 16
+
+// key of the start position, checked against the built in table when it compiles
+#define POLYGLOT_STARTPOS_KEY 0x463B96181691FC9CULL
+
+/*
+polyglot opening book entry, stored big endian and sorted by key
+    key    : polyglot hash of the position
+    move   : to file bits 0-2, to rank 3-5, from file 6-8, from rank 9-11, promotion 12-14 (1 knight .. 4 queen),
+             castling is written as the king taking its own rook (e1h1, e1a1, e8h8, e8a8)
+    weight : how good the move is relative to the other moves of the position
+    learn  : unused, written as 0
+*/
+struct PolyglotEntry {
+    U64 key;
+    uint16_t move;
+    uint16_t weight;
+    uint32_t learn;
+};
+
+class Polyglot {
+    public:
+        // polyglot hash of the position, unlike the zobrist key the en passant file only counts when a pawn of the
+        // side to move can take on it
+        static U64 key(const Board &board);
+
+        static uint16_t encodeMove(Move move);
+
+        // the book move as a legal engine move of the board, 0 if there is none
+        static Move decodeMove(uint16_t move, const Board &board);
+
+        static void writeEntry(const PolyglotEntry &entry, unsigned char out[POLYGLOT_ENTRY_SIZE]);
+        static PolyglotEntry readEntry(const unsigned char in[POLYGLOT_ENTRY_SIZE]);
+
+    private:
+        // castling from the king takes rook form, with the checks the generator makes
+        static Move decodeCastling(const Board &board, int from, int rookSquare);
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include "Profile.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+static const char* zoneNames[PROFILE_ZONES] = {
+    "Board::makeMove",
+    "MoveGen::generateMoves",
+    "MoveGen::generatePawnMoves",
+    "MoveGen::generateKnightMoves",
+    "MoveGen::generateKingMoves",
+    "MoveGen::generateSlidingMoves",
+    "MoveGen::isSquareAttacked",
+    "Evaluation::evaluate",
+    "Search move sorting",
+    "Search::quiescence",
+};
+
+// only the owning thread writes its counters, relaxed atomics let another thread read them while it runs
+struct ThreadCounters {
+    std::atomic<uint64_t> calls[PROFILE_ZONES] = {};
+    std::atomic<uint64_t> cycles[PROFILE_ZONES] = {};
+
+    ThreadCounters();
+    ~ThreadCounters();
+};
+
+static std::mutex registryMutex;
+static std::vector<ThreadCounters*> liveThreads;
+
+// counters of threads that have exited
+static uint64_t retiredCalls[PROFILE_ZONES];
+static uint64_t retiredCycles[PROFILE_ZONES];
+
+ThreadCounters::ThreadCounters() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    liveThreads.push_back(this);
+}
+
+ThreadCounters::~ThreadCounters() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (int zone = 0; zone < PROFILE_ZONES; ++zone) {
+        retiredCalls[zone] += calls[zone].load(std::memory_order_relaxed);
+        retiredCycles[zone] += cycles[zone].load(std::memory_order_relaxed);
+    }
+    std::erase(liveThreads, this);
+}
+
+static thread_local ThreadCounters threadCounters;
+
+void Profile::record(int zone, uint64_t cycles) {
+    ThreadCounters &counters = threadCounters;
+    counters.calls[zone].store(counters.calls[zone].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    counters.cycles[zone].store(counters.cycles[zone].load(std::memory_order_relaxed) + cycles, std::memory_order_relaxed);
+}
+
+void Profile::print(std::ostream &out) {
+    if (!enabled()) {
+        out << "info string profiling is not compiled in, rebuild with make clean && make PROFILE=1" << std::endl;
+        return;
+    }
+
+    uint64_t calls[PROFILE_ZONES], cycles[PROFILE_ZONES];
+    int threads;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        threads = (int)liveThreads.size();
+        for (int zone = 0; zone < PROFILE_ZONES; ++zone) {
+            calls[zone] = retiredCalls[zone];
+            cycles[zone] = retiredCycles[zone];
+            for (ThreadCounters* counters : liveThreads) {
+                calls[zone] += counters->calls[zone].load(std::memory_order_relaxed);
+                cycles[zone] += counters->cycles[zone].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // times are inclusive, e.g. quiescence contains the evaluations and move generation it calls
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-32s %14s %16s %12s", "zone", "calls", "cycles", "cycles/call");
+    out << line << "\n";
+    for (int zone = 0; zone < PROFILE_ZONES; ++zone) {
+        std::snprintf(line, sizeof(line), "%-32s %14llu %16llu %12.1f", zoneNames[zone],
+                      (unsigned long long)calls[zone], (unsigned long long)cycles[zone],
+                      calls[zone] ? (double)cycles[zone] / calls[zone] : 0.0);
+        out << line << "\n";
+    }
+    out << "(" << threads << " live threads)" << std::endl;
+}
+
+void Profile::clear() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (int zone = 0; zone < PROFILE_ZONES; ++zone) {
+        retiredCalls[zone] = 0;
+        retiredCycles[zone] = 0;
+        for (ThreadCounters* counters : liveThreads) {
+            counters->calls[zone].store(0, std::memory_order_relaxed);
+            counters->cycles[zone].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+#if defined(NICE_PROFILE)
+// dumps the table when the program exits
+static struct ProfileReport {
+    ~ProfileReport() { Profile::print(std::cerr); }
+} profileReport;
+#endif
@@ -0,0 +1,78 @@
+#ifndef CHESS_PROFILE_HPP
+#define CHESS_PROFILE_HPP
+
+#include <cstdint>
+#include <ostream>
+
+// hot path call counters and rdtsc timers, compiled in with "make clean && make PROFILE=1"
+// in a normal build PROFILE_SCOPE expands to nothing, so the timed functions are untouched
+enum ProfileZone {
+    PROFILE_MAKE_MOVE,
+    PROFILE_GENERATE_MOVES,
+    PROFILE_GENERATE_PAWN_MOVES,
+    PROFILE_GENERATE_KNIGHT_MOVES,
+    PROFILE_GENERATE_KING_MOVES,
+    PROFILE_GENERATE_SLIDING_MOVES,
+    PROFILE_IS_SQUARE_ATTACKED,
+    PROFILE_EVALUATE,
+    PROFILE_SORT_MOVES,
+    PROFILE_QUIESCENCE,
+    PROFILE_ZONES
+};
+
+class Profile {
+    public:
+        static constexpr bool enabled() {
+        #if defined(NICE_PROFILE)
+            return true;
+        #else
+            return false;
+        #endif
+        }
+
+        // adds one call (and its cycles) to the calling thread's counters
+        static void record(int zone, uint64_t cycles);
+
+        // table of all threads' counters added up, including threads that have finished
+        static void print(std::ostream &out);
+        static void clear();
+};
+
+#if defined(NICE_PROFILE)
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+inline uint64_t profileTicks() { return __rdtsc(); }
+#else
+#include <chrono>
+inline uint64_t profileTicks() { return std::chrono::steady_clock::now().time_since_epoch().count(); }
+#endif
+
+// times the enclosing scope, recursive calls only add to the call count so time isn't counted twice
+class ProfileScope {
+    public:
+        explicit ProfileScope(int zone) : zone(zone), outermost(depth[zone]++ == 0), start(outermost ? profileTicks() : 0) {}
+        ~ProfileScope() {
+            depth[zone]--;
+            Profile::record(zone, outermost ? profileTicks() - start : 0);
+        }
+
+    private:
+        static inline thread_local int depth[PROFILE_ZONES] = {};
+
+        int zone;
+        bool outermost;
+        uint64_t start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(zone) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(zone)
+
+#else
+
+#define PROFILE_SCOPE(zone)
+
+#endif
+
+#endif
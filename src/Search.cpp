@@ -2,12 +2,58 @@
 #include "Evaluation.hpp"
 #include "MoveGen.hpp"
 #include "BitUtils.hpp"
+#include "Profile.hpp"
+#include "Tablebase.hpp"
+#include "Syzygy.hpp"
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 
 #define MATE_VALUE 49000
 #define INVALID_SCORE -200000
 
+// table wins score below every mate the search finds itself, sooner wins higher
+#define TB_WIN_SCORE (MATE_VALUE - 1000)
+
+thread_local uint64_t Search::nodes = 0;
+thread_local SearchLimits Search::limits;
+thread_local std::chrono::steady_clock::time_point Search::startTime;
+thread_local bool Search::stopped = false;
+thread_local Move Search::pvTable[MAX_PLY][MAX_PLY];
+thread_local int Search::pvLength[MAX_PLY];
+thread_local Accumulator Search::accumulators[ACCUMULATOR_STACK];
+
+// nodes between two looks at the clock
+#define CHECK_INTERVAL 2048
+
+void Search::checkLimits(){
+    if (limits.nodes && nodes >= limits.nodes) stopped = true;
+
+    if (limits.timeMs) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+        if (elapsed >= limits.timeMs) stopped = true;
+    }
+}
+
+// move followed by the line the child position found
+void Search::updatePv(int ply, Move move){
+    pvTable[ply][ply] = move;
+    for (int i = ply + 1; i < pvLength[ply + 1]; i++) pvTable[ply][i] = pvTable[ply + 1][i];
+    pvLength[ply] = pvLength[ply + 1];
+}
+
+// accumulator of the board at ply from the one of its parent, skipped while the hand written evaluation is used
+void Search::updateAccumulator(const Board &board, const FeatureDelta &delta, int ply){
+    if (NNUE::isEnabled()) NNUE::updateAccumulator(board, accumulators[ply - 1], accumulators[ply], delta);
+}
+
+// syzygy tables rank the root moves by distance to zeroing, the engine's own ones where syzygy has no table
+void Search::filterRootMoves(const Board &board, std::vector<Move> &moves){
+    int pieces = popCount(board.bitboards[ALL_OCC]);
+    if (pieces <= Syzygy::probeLimit() && Syzygy::filterRootMoves(board, moves)) return;
+    if (pieces <= Tablebase::probeLimit()) Tablebase::filterRootMoves(board, moves);
+}
+
 // scores moves to ensure move order and maximum pruning
 int Search::scoreMove(const Move &move){
     // prioritise captures with the MVV-LVA methodology (Most Valuable Victum - Least Valuable Agressor)
@@ -29,8 +75,15 @@ int Search::scoreMove(const Move &move){
 }
 
 // searches deeper when captures are discovered on leaf nodes of search
-int Search::quiescence(Board &board, int alpha, int beta){
-    int eval = Evaluation::evaluate(board);
+int Search::quiescence(Board &board, int alpha, int beta, int ply){
+    PROFILE_SCOPE(PROFILE_QUIESCENCE);
+    nodes++;
+
+    if (nodes % CHECK_INTERVAL == 0) checkLimits();
+    if (stopped) return 0;
+
+    // only the stand pat score is needed, so the evaluation can stop early outside the window
+    int eval = Evaluation::evaluate(board, alpha, beta, &accumulators[ply]);
 
     // fail beta cutoff, prune
     if (eval >= beta) {
@@ -46,7 +99,10 @@ int Search::quiescence(Board &board, int alpha, int beta){
     std::vector<Move> moves = MoveGen::generateMoves(board);
 
     //sort moves for maximum pruning
-    std::sort(moves.begin(), moves.end(), [&](const Move &a, const Move &b) {return scoreMove(a) > scoreMove(b);});
+    {
+        PROFILE_SCOPE(PROFILE_SORT_MOVES);
+        std::sort(moves.begin(), moves.end(), [&](const Move &a, const Move &b) {return scoreMove(a) > scoreMove(b);});
+    }
 
     for (const Move &move: moves){
 
@@ -56,7 +112,8 @@ int Search::quiescence(Board &board, int alpha, int beta){
         }
 
         Board nextBoard = board; // copy current board
-        nextBoard.makeMove(move); // make move from movelist
+        FeatureDelta delta;
+        nextBoard.makeMove(move, &delta); // make move from movelist
 
         // get position of the king of the current board
         int kingType = (board.activeColour == WHITE) ? WK : BK;
@@ -67,9 +124,11 @@ int Search::quiescence(Board &board, int alpha, int beta){
             continue; // skip because board is illegal for the current board player
         }
 
+        // only legal moves pay for the accumulator update
+        updateAccumulator(nextBoard, delta, ply + 1);
 
         // recursive step - get score of the board after move is made
-        int score = -quiescence(nextBoard, -beta, -alpha);
+        int score = -quiescence(nextBoard, -beta, -alpha, ply + 1);
 
         // fail beta cutoff, prune
         if (score >= beta) {
@@ -85,24 +144,113 @@ int Search::quiescence(Board &board, int alpha, int beta){
     return alpha;
 }
 
-int Search::negamax(Board &board, int alpha, int beta, int depth){
+// same as quiescence but keeps its principal variation in the pv table, so the leaf can be played out afterwards
+// without copying a board for every node
+int Search::quiescenceLine(Board &board, int alpha, int beta, int ply){
+    pvLength[ply] = ply;
+
+    int eval = Evaluation::evaluate(board);
+
+    if (eval >= beta) {
+        return beta;
+    }
+
+    if(eval > alpha){
+        alpha = eval;
+    }
+
+    // every capture takes a piece off the board, so a line never gets near the end of the table
+    if (ply >= MAX_PLY - 1) {
+        return alpha;
+    }
+
+    std::vector<Move> moves = MoveGen::generateMoves(board);
+    std::sort(moves.begin(), moves.end(), [&](const Move &a, const Move &b) {return scoreMove(a) > scoreMove(b);});
+
+    for (const Move &move: moves){
+        if(!(moveFlags(move) & CAPTURE)){
+            continue;
+        }
+
+        Board nextBoard = board;
+        nextBoard.makeMove(move);
+
+        int kingType = (board.activeColour == WHITE) ? WK : BK;
+        int kingSquare = getLSB(nextBoard.bitboards[kingType]);
+
+        if(MoveGen::isSquareAttacked(nextBoard, kingSquare, nextBoard.activeColour)){
+            continue;
+        }
+
+        int score = -quiescenceLine(nextBoard, -beta, -alpha, ply + 1);
+
+        if (score >= beta) {
+            return beta;
+        }
+
+        // the line through this capture is the new best
+        if(score > alpha){
+            alpha = score;
+            updatePv(ply, move);
+        }
+    }
+
+    return alpha;
+}
+
+Board Search::quietPosition(const Board &board){
+    Board leaf = board;
+    quiescenceLine(leaf, INVALID_SCORE, -INVALID_SCORE, 0);
+
+    for (int i = 0; i < pvLength[0]; i++) leaf.makeMove(pvTable[0][i]);
+    return leaf;
+}
+
+int Search::negamax(Board &board, int alpha, int beta, int depth, int ply){
+    pvLength[ply] = ply;
+
+    // a capture or pawn move may have entered an endgame table, which knows the result
+    if (ply > 0 && board.halfMoves == 0) {
+        int pieces = popCount(board.bitboards[ALL_OCC]);
+        int result;
+        // the counter was just reset, so the fifty move rule draws exactly the cursed wins and blessed losses
+        if (pieces <= Syzygy::probeLimit() && Syzygy::probeWdl(board, result)) {
+            if (result == SYZYGY_WIN) return TB_WIN_SCORE - ply;
+            if (result == SYZYGY_LOSS) return -TB_WIN_SCORE + ply;
+            return 0;
+        }
+        if (pieces <= Tablebase::probeLimit() && Tablebase::probeWdl(board, result)) {
+            if (result == TB_WIN) return TB_WIN_SCORE - ply;
+            if (result == TB_LOSS) return -TB_WIN_SCORE + ply;
+            return 0;
+        }
+    }
 
     // base case
-    if(depth == 0){
-        return quiescence(board, alpha, beta);
+    if(depth == 0 || ply >= MAX_PLY - 1){
+        return quiescence(board, alpha, beta, ply);
     }
 
+    nodes++;
+
+    if (nodes % CHECK_INTERVAL == 0) checkLimits();
+    if (stopped) return 0;
+
     // generate all possible moves
     std::vector<Move> moves = MoveGen::generateMoves(board);
 
     //sort moves for maximum pruning
-    std::sort(moves.begin(), moves.end(), [&](const Move &a, const Move &b) {return scoreMove(a) > scoreMove(b);});
+    {
+        PROFILE_SCOPE(PROFILE_SORT_MOVES);
+        std::sort(moves.begin(), moves.end(), [&](const Move &a, const Move &b) {return scoreMove(a) > scoreMove(b);});
+    }
 
     int legalMoves = 0;
 
     for (const Move &move: moves){
         Board nextBoard = board; // copy current board
-        nextBoard.makeMove(move); // make move from movelist
+        FeatureDelta delta;
+        nextBoard.makeMove(move, &delta); // make move from movelist
 
         // get position of the king of the current board
         int kingType = (board.activeColour == WHITE) ? WK : BK;
@@ -114,9 +262,10 @@ int Search::negamax(Board &board, int alpha, int beta, int depth){
         }
 
         legalMoves++;
+        updateAccumulator(nextBoard, delta, ply + 1);
 
         // recursive step - get score of the board after move is made
-        int score = -negamax(nextBoard, -beta, -alpha, depth-1);
+        int score = -negamax(nextBoard, -beta, -alpha, depth-1, ply+1);
 
         // fail beta cutoff, prune
         if (score >= beta) {
@@ -126,6 +275,7 @@ int Search::negamax(Board &board, int alpha, int beta, int depth){
         // found beta score
         if(score > alpha){
             alpha = score;
+            updatePv(ply, move);
         }
     }
 
@@ -151,13 +301,26 @@ int Search::negamax(Board &board, int alpha, int beta, int depth){
 }
 
 // wrapper for negamax and keep track of the best move associated with the best score
-Move Search::searchPosition(const Board &board, int depth){
+Move Search::searchPosition(const Board &board, int depth, bool printInfo){
+    auto start = std::chrono::steady_clock::now();
+    nodes = 0;
+    limits = SearchLimits();
+    stopped = false;
+
+    // every move from here updates the accumulator of its ply instead of the leaves refreshing it from scratch
+    if (NNUE::isEnabled()) NNUE::refreshAccumulator(board, accumulators[0]);
 
     // generate all possible moves
     std::vector<Move> moves = MoveGen::generateMoves(board);
 
+    // in an endgame table only the moves keeping the best result (and distance to zeroing or mate) are searched
+    filterRootMoves(board, moves);
+
     //sort moves for maximum pruning
-    std::sort(moves.begin(), moves.end(), [&](const Move &a, const Move &b) {return scoreMove(a) > scoreMove(b);});
+    {
+        PROFILE_SCOPE(PROFILE_SORT_MOVES);
+        std::sort(moves.begin(), moves.end(), [&](const Move &a, const Move &b) {return scoreMove(a) > scoreMove(b);});
+    }
 
     Move bestMove = 0;
 
@@ -170,7 +333,8 @@ Move Search::searchPosition(const Board &board, int depth){
 
     for (const Move &move: moves){
         Board nextBoard = board; // copy current board
-        nextBoard.makeMove(move); // make move from movelist
+        FeatureDelta delta;
+        nextBoard.makeMove(move, &delta); // make move from movelist
 
         // get position of the king of the current board
         int kingType = (board.activeColour == WHITE) ? WK : BK;
@@ -181,16 +345,19 @@ Move Search::searchPosition(const Board &board, int depth){
             continue; // skip because board is illegal for the current board player
         }
 
+        updateAccumulator(nextBoard, delta, 1);
 
         // recursive step - get score of the board after move is made
-        int score = -negamax(nextBoard, -beta, -alpha, depth-1);
+        int score = -negamax(nextBoard, -beta, -alpha, depth-1, 1);
 
         // uci info about search
-        std::cout << "info score cp " << score
-                  << " pv "
-                  << board.convertSquareToCord(fromSq(move))
-                  << board.convertSquareToCord(toSq(move))
-                  << std::endl;
+        if (printInfo) {
+            std::cout << "info score cp " << score
+                      << " pv "
+                      << board.convertSquareToCord(fromSq(move))
+                      << board.convertSquareToCord(toSq(move))
+                      << std::endl;
+        }
 
 
         // get max score
@@ -204,6 +371,91 @@ Move Search::searchPosition(const Board &board, int depth){
         }
     }
 
+    // search statistics
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    if (printInfo) {
+        std::cout << "info depth " << depth
+                  << " nodes " << nodes
+                  << " time " << elapsed
+                  << " nps " << (elapsed > 0 ? nodes * 1000 / elapsed : nodes)
+                  << std::endl;
+    }
+
     return bestMove;
 }
 
+
+SearchResult Search::analyze(const Board &board, const SearchLimits &searchLimits,
+                             const std::function<void(const SearchResult&)> &onIteration){
+    startTime = std::chrono::steady_clock::now();
+    nodes = 0;
+    limits = searchLimits;
+    stopped = false;
+
+    // every move from here updates the accumulator of its ply instead of the leaves refreshing it from scratch
+    if (NNUE::isEnabled()) NNUE::refreshAccumulator(board, accumulators[0]);
+
+    SearchResult result;
+
+    std::vector<Move> moves = MoveGen::generateLegalMoves(board);
+    if (moves.empty()) return result;
+
+    filterRootMoves(board, moves);
+
+    std::sort(moves.begin(), moves.end(), [&](const Move &a, const Move &b) {return scoreMove(a) > scoreMove(b);});
+
+    int maxDepth = (limits.depth > 0) ? std::min(limits.depth, MAX_PLY - 1) : MAX_PLY - 1;
+
+    for (int depth = 1; depth <= maxDepth; depth++) {
+        // the first iteration runs without limits so there is always a move to return
+        limits = (depth == 1) ? SearchLimits() : searchLimits;
+
+        int alpha = INVALID_SCORE;
+        int beta = -INVALID_SCORE;
+        Move bestMove = 0;
+
+        for (const Move &move: moves){
+            Board nextBoard = board;
+            FeatureDelta delta;
+            nextBoard.makeMove(move, &delta);
+            updateAccumulator(nextBoard, delta, 1);
+
+            int score = -negamax(nextBoard, -beta, -alpha, depth-1, 1);
+            if (stopped) break;
+
+            if (score > alpha){
+                alpha = score;
+                bestMove = move;
+                updatePv(0, move);
+            }
+        }
+
+        if (stopped) break;
+
+        result.bestMove = bestMove;
+        result.score = alpha;
+        result.depth = depth;
+        result.pv.assign(pvTable[0], pvTable[0] + pvLength[0]);
+
+        // a mate found at ply p scores MATE_VALUE + depth - p
+        result.mateIn = 0;
+        if (std::abs(alpha) >= MATE_VALUE) {
+            int plies = MATE_VALUE + depth - std::abs(alpha);
+            result.mateIn = (alpha > 0) ? (plies + 1) / 2 : -(plies / 2);
+        }
+
+        // next iteration searches the best move first
+        std::stable_partition(moves.begin(), moves.end(), [&](const Move &m) {return m == bestMove;});
+
+        result.nodes = nodes;
+        result.timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+        if (onIteration) onIteration(result);
+
+        if (limits.nodes && nodes >= limits.nodes) break;
+        if (limits.timeMs && result.timeMs >= limits.timeMs) break;
+    }
+
+    result.nodes = nodes;
+    result.timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+    return result;
+}
@@ -3,14 +3,72 @@
 
 #include "Board.hpp"
 #include "Move.hpp"
+#include "NNUE.hpp"
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#define MAX_PLY 128
+
+// quiescence goes past MAX_PLY by at most the 30 captures a position has, the accumulator stack covers those plies
+#define ACCUMULATOR_STACK (MAX_PLY + 32)
+
+// limits of an iterative deepening search, 0 means unlimited (one of them should be set)
+struct SearchLimits {
+    int depth = 0;
+    uint64_t nodes = 0;
+    int64_t timeMs = 0;
+};
+
+// result of the last completed iteration
+struct SearchResult {
+    Move bestMove = 0;
+    int score = 0;          // centipawns from the side to move's point of view
+    int mateIn = 0;         // moves until mate, negative if the side to move gets mated, 0 if there is no mate
+    int depth = 0;
+    uint64_t nodes = 0;     // over all iterations
+    int64_t timeMs = 0;
+    std::vector<Move> pv;
+};
 
 class Search {
     public: 
-        static Move searchPosition(const Board &board, int depth);
+        // printInfo = false searches without any uci output (bench)
+        static Move searchPosition(const Board &board, int depth, bool printInfo = true);
+
+        // deepens one ply at a time until a limit is hit, the iteration a limit interrupts is thrown away
+        // onIteration is called after every completed depth
+        static SearchResult analyze(const Board &board, const SearchLimits &limits,
+                                    const std::function<void(const SearchResult&)> &onIteration = nullptr);
+
+        // position at the end of the quiescence search's principal variation (used by the tuner)
+        static Board quietPosition(const Board &board);
+
+        // nodes visited by the last search
+        static thread_local uint64_t nodes;
 
     private:
-        static int negamax(Board &board, int alpha, int beta, int depth);
-        static int quiescence(Board &booard, int alpha, int beta);
+        // limits of the running search, checked every few thousand nodes
+        static thread_local SearchLimits limits;
+        static thread_local std::chrono::steady_clock::time_point startTime;
+        static thread_local bool stopped;
+
+        // triangular principal variation table, row ply holds the line from that ply on
+        static thread_local Move pvTable[MAX_PLY][MAX_PLY];
+        static thread_local int pvLength[MAX_PLY];
+
+        // nnue first layer of the board searched at each ply, only maintained while the network evaluates
+        static thread_local Accumulator accumulators[ACCUMULATOR_STACK];
+
+        static void checkLimits();
+        static void updatePv(int ply, Move move);
+        static void updateAccumulator(const Board &board, const FeatureDelta &delta, int ply);
+        static void filterRootMoves(const Board &board, std::vector<Move> &moves);
+
+        static int negamax(Board &board, int alpha, int beta, int depth, int ply);
+        static int quiescence(Board &board, int alpha, int beta, int ply);
+        static int quiescenceLine(Board &board, int alpha, int beta, int ply);
         static int scoreMove(const Move &move);
 };
 
@@ -0,0 +1,810 @@
+#include "Syzygy.hpp"
+#include "Board.hpp"
+#include "BitUtils.hpp"
+#include "MappedFile.hpp"
+#include "MoveGen.hpp"
+#include "Tablebase.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+int Syzygy::limit = 0;
+int Syzygy::requestedLimit = SYZYGY_MAX_PIECES;
+int Syzygy::largest = 0;
+
+#define SYZYGY_WDL_MAGIC 0x5D23E871
+#define SYZYGY_DTZ_MAGIC 0xA50C66D7
+
+// flags of a table file
+#define SYZYGY_SPLIT     1  // both sides to move are stored (wdl files of unequal material)
+#define SYZYGY_HAS_PAWNS 2  // one set of pairs per file (a-d) of the leading pawn
+
+// flags of a set of pairs
+#define SYZYGY_STM          1   // dtz: side to move the values are stored for
+#define SYZYGY_MAPPED       2   // dtz: values are looked up in the table's dtz map
+#define SYZYGY_WIN_PLIES    4   // dtz: wins are stored in plies rather than moves
+#define SYZYGY_LOSS_PLIES   8   // dtz: losses are stored in plies rather than moves
+#define SYZYGY_WIDE         16  // dtz: the map holds 16 bit values
+#define SYZYGY_SINGLE_VALUE 128 // every position has the same value
+
+// root move rank of a win that comes before the fifty move rule, see filterRootMoves
+#define SYZYGY_MAX_DTZ (1 << 18)
+
+static uint32_t readLe16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+static uint32_t readLe32(const uint8_t* p) { return readLe16(p) | (readLe16(p + 2) << 16); }
+static uint32_t readBe32(const uint8_t* p) { return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+static uint64_t readBe64(const uint8_t* p) { return ((uint64_t)readBe32(p) << 32) | readBe32(p + 4); }
+
+// rank minus file, negative below the a1-h8 diagonal
+static int offDiagonal(int square) { return (square >> 3) - (square & 7); }
+
+// square maps and combination counts the index is built from
+struct SyzygyIndexTables {
+    uint64_t binomial[SYZYGY_MAX_PIECES][64];          // binomial[k][n]: ways to pick k of n squares
+    int mapB1H1H7[64];                                 // squares below a1-h8 -> 0..27
+    int mapA1D1D4[64];                                 // a1-d1-d4 triangle -> 0..9, its diagonal last
+    int mapKK[10][64];                                 // 462 king pairs with the first king in the triangle
+    int mapPawns[64];                                  // a2-h7 -> 0..47, the highest is the leading pawn
+    uint64_t leadPawnIdx[SYZYGY_MAX_PIECES][64];
+    uint64_t leadPawnsSize[SYZYGY_MAX_PIECES][4];
+
+    SyzygyIndexTables() : binomial(), mapB1H1H7(), mapA1D1D4(), mapKK(), mapPawns(), leadPawnIdx(), leadPawnsSize() {
+        int code = 0;
+        for (int square = 0; square < 64; square++) {
+            if (offDiagonal(square) < 0) mapB1H1H7[square] = code++;
+        }
+
+        code = 0;
+        std::vector<int> diagonal;
+        for (int square = 0; square <= SQ_D4; square++) {
+            if ((square & 7) > 3) continue;
+            if (offDiagonal(square) < 0) mapA1D1D4[square] = code++;
+            else if (offDiagonal(square) == 0) diagonal.push_back(square);
+        }
+        for (int square : diagonal) mapA1D1D4[square] = code++;
+
+        // with the first king on the diagonal the second isn't above it, pairs with both on it come last
+        std::vector<std::pair<int, int>> bothOnDiagonal;
+        code = 0;
+        for (int index = 0; index < 10; index++) {
+            for (int first = 0; first <= SQ_D4; first++) {
+                // b1 is the square mapped to 0, the other zeros are squares outside the triangle
+                if (mapA1D1D4[first] != index || (index == 0 && first != SQ_B1)) continue;
+                for (int second = 0; second < 64; second++) {
+                    int distance = std::max(std::abs((first & 7) - (second & 7)), std::abs((first >> 3) - (second >> 3)));
+                    if (distance <= 1) continue;
+                    if (!offDiagonal(first) && offDiagonal(second) > 0) continue;
+                    if (!offDiagonal(first) && !offDiagonal(second)) bothOnDiagonal.push_back({index, second});
+                    else mapKK[index][second] = code++;
+                }
+            }
+        }
+        for (const auto &[index, second] : bothOnDiagonal) mapKK[index][second] = code++;
+
+        for (int n = 0; n < 64; n++) {
+            binomial[0][n] = 1;
+            for (int k = 1; k < SYZYGY_MAX_PIECES; k++) binomial[k][n] = (n == 0) ? 0 : binomial[k - 1][n - 1] + binomial[k][n - 1];
+        }
+
+        // pawns are mirrored onto files a-d, the lowest rank nearest the edge leads
+        int available = 47;
+        for (int leadPawns = 1; leadPawns < SYZYGY_MAX_PIECES - 1; leadPawns++) {
+            for (int file = 0; file < 4; file++) {
+                uint64_t index = 0;
+                for (int rank = 1; rank <= 6; rank++) {
+                    int square = rank * 8 + file;
+                    if (leadPawns == 1) {
+                        mapPawns[square] = available--;
+                        mapPawns[square ^ 7] = available--;
+                    }
+                    leadPawnIdx[leadPawns][square] = index;
+                    index += binomial[leadPawns - 1][mapPawns[square]];
+                }
+                leadPawnsSize[leadPawns][file] = index;
+            }
+        }
+    }
+};
+
+static const SyzygyIndexTables& indexTables() {
+    static const SyzygyIndexTables maps;
+    return maps;
+}
+
+// syzygy piece code (pawn .. king = 1 .. 6, black adds 8) of an engine piece, and back
+static int syzygyPiece(int piece) { return piece % 6 + 1 + (piece >= BP ? 8 : 0); }
+static int enginePiece(int code) { return (code & 7) - 1 + ((code & 8) ? 6 : 0); }
+
+/*
+one table of values: the positions are indexed, cut into blocks of about the same compressed size and each block
+holds canonical huffman codes of symbols that expand (recursive pairing) into runs of values
+*/
+struct SyzygyPairs {
+    int flags = 0;
+    int pieces[SYZYGY_MAX_PIECES] = {};     // piece codes in the order the index takes them
+    int groupLen[SYZYGY_MAX_PIECES + 1] = {};
+    uint64_t groupIdx[SYZYGY_MAX_PIECES + 1] = {};
+    uint64_t size = 0;                      // number of indices
+
+    uint64_t blockSize = 0;
+    uint64_t span = 0;                      // indices between two sparse index entries
+    uint64_t sparseIndexSize = 0;
+    uint64_t blockLengthSize = 0;
+    uint64_t blocks = 0;
+    int minSymLen = 0;                      // the value itself for SYZYGY_SINGLE_VALUE
+    int maxSymLen = 0;
+    const uint8_t* lowestSym = nullptr;     // uint16 first code of each code length
+    std::vector<uint64_t> base64;           // lowest code of each length, left aligned
+    std::vector<uint8_t> symLen;            // values a symbol expands to, minus one
+    const uint8_t* tree = nullptr;          // 3 bytes per symbol, the 12 bit left and right halves of a pair
+    const uint8_t* sparseIndex = nullptr;   // uint32 block and uint16 offset of every span'th index
+    const uint8_t* blockLength = nullptr;   // uint16 values per block, minus one
+    const uint8_t* data = nullptr;
+    uint32_t mapIdx[4] = {};                // dtz map offsets for a win, loss, cursed win and blessed loss
+};
+
+// one of the two files of a table, mapped by the first probe that needs it
+struct SyzygyFile {
+    std::once_flag loadOnce;
+    bool ok = false;
+    MappedFile file;
+    SyzygyPairs pairs[2][4];                // [side to move][file of the leading pawn]
+    const uint8_t* map = nullptr;           // dtz values of the mapped pairs
+};
+
+struct SyzygyTable {
+    std::string stem;                       // path without the extension
+    uint64_t key = 0;                       // material key with the name's first side as white
+    uint64_t key2 = 0;                      // and with it as black
+    int pieceCount = 0;
+    bool hasPawns = false;
+    bool hasUniquePieces = false;           // some side has a single piece of a type other than the king
+    int pawnCount[2] = {};                  // pawns of the leading colour (fewer pawns) and of the other
+
+    SyzygyFile wdl;
+    SyzygyFile dtz;
+
+    bool parse(std::string_view name);
+    void load(bool dtzFile);
+};
+
+static const char pieceLetters[] = "PNBRQK";
+
+bool SyzygyTable::parse(std::string_view name) {
+    size_t separator = name.find('v');
+    if (separator == std::string_view::npos) return false;
+
+    int counts[12] = {};
+    for (size_t i = 0; i < name.size(); i++) {
+        if (i == separator) continue;
+        size_t type = std::string_view(pieceLetters).find(name[i]);
+        if (type == std::string_view::npos) return false;
+        counts[type + (i > separator ? 6 : 0)]++;
+    }
+    if (counts[WK] != 1 || counts[BK] != 1 || name.size() - 1 > SYZYGY_MAX_PIECES) return false;
+
+    pieceCount = (int)name.size() - 1;
+    for (int piece = WP; piece <= BK; piece++) {
+        key += (uint64_t)counts[piece] << (4 * piece);
+        if (piece % 6 != WK && counts[piece] == 1) hasUniquePieces = true;
+    }
+    key2 = (key >> 24) | ((key & 0xFFFFFF) << 24);
+    hasPawns = counts[WP] + counts[BP] > 0;
+
+    // the side with fewer pawns leads, white when both have the same
+    bool whiteLeads = !counts[BP] || (counts[WP] && counts[BP] >= counts[WP]);
+    pawnCount[0] = whiteLeads ? counts[WP] : counts[BP];
+    pawnCount[1] = whiteLeads ? counts[BP] : counts[WP];
+    return true;
+}
+
+// groups of pieces the index is made of and the multiplier of each, order holds where the leading group
+// and the other side's pawns come among them
+static void setGroups(const SyzygyTable &table, SyzygyPairs &d, const int order[2], int file) {
+    const SyzygyIndexTables &maps = indexTables();
+    int n = 0;
+    int firstLen = table.hasPawns ? 0 : table.hasUniquePieces ? 3 : 2;
+    d.groupLen[n] = 1;
+    for (int i = 1; i < table.pieceCount; i++) {
+        if (--firstLen > 0 || d.pieces[i] == d.pieces[i - 1]) d.groupLen[n]++;
+        else d.groupLen[++n] = 1;
+    }
+    d.groupLen[++n] = 0;
+
+    bool bothPawns = table.hasPawns && table.pawnCount[1];
+    int next = bothPawns ? 2 : 1;
+    int freeSquares = 64 - d.groupLen[0] - (bothPawns ? d.groupLen[1] : 0);
+    uint64_t index = 1;
+
+    for (int k = 0; next < n || k == order[0] || k == order[1]; k++) {
+        if (k == order[0]) {
+            d.groupIdx[0] = index;
+            index *= table.hasPawns ? maps.leadPawnsSize[d.groupLen[0]][file] : table.hasUniquePieces ? 31332 : 462;
+        } else if (k == order[1]) {
+            d.groupIdx[1] = index;
+            index *= maps.binomial[d.groupLen[1]][48 - d.groupLen[0]];
+        } else {
+            d.groupIdx[next] = index;
+            index *= maps.binomial[d.groupLen[next]][freeSquares];
+            freeSquares -= d.groupLen[next++];
+        }
+    }
+    d.groupIdx[n] = index;
+    d.size = index;
+}
+
+// values a symbol expands to, minus one
+static int symbolLength(SyzygyPairs &d, int symbol, std::vector<bool> &visited) {
+    visited[symbol] = true;
+    const uint8_t* pair = d.tree + 3 * symbol;
+    int left = pair[0] | ((pair[1] & 0xF) << 8);
+    int right = (pair[2] << 4) | (pair[1] >> 4);
+    if (right == 0xFFF) return 0;
+    if (left >= (int)d.symLen.size() || right >= (int)d.symLen.size()) return 0;
+
+    if (!visited[left]) d.symLen[left] = symbolLength(d, left, visited);
+    if (!visited[right]) d.symLen[right] = symbolLength(d, right, visited);
+    return d.symLen[left] + d.symLen[right] + 1;
+}
+
+// reads the sizes and huffman code of a set of pairs, nullptr if the file ends first
+static const uint8_t* setSizes(SyzygyPairs &d, const uint8_t* data, const uint8_t* end) {
+    if (end - data < 2) return nullptr;
+    d.flags = *data++;
+    if (d.flags & SYZYGY_SINGLE_VALUE) {
+        d.minSymLen = *data++;
+        return data;
+    }
+
+    if (end - data < 9 || data[0] >= 32 || data[1] >= 40) return nullptr;
+    d.blockSize = 1ULL << data[0];
+    d.span = 1ULL << data[1];
+    d.sparseIndexSize = (d.size + d.span - 1) / d.span;
+    int padding = data[2];
+    d.blocks = readLe32(data + 3);
+    d.blockLengthSize = d.blocks + padding;
+    d.maxSymLen = data[7];
+    d.minSymLen = data[8];
+    data += 9;
+    if (d.minSymLen < 1 || d.maxSymLen < d.minSymLen || d.maxSymLen > 32) return nullptr;
+
+    // canonical code: longer codes have lower values, base64[i] is the lowest code of length minSymLen + i
+    int lengths = d.maxSymLen - d.minSymLen + 1;
+    if (end - data < 2 * lengths + 2) return nullptr;
+    d.lowestSym = data;
+    d.base64.assign(lengths, 0);
+    for (int i = lengths - 2; i >= 0; i--) {
+        d.base64[i] = (d.base64[i + 1] + readLe16(d.lowestSym + 2 * i) - readLe16(d.lowestSym + 2 * (i + 1))) / 2;
+    }
+    for (int i = 0; i < lengths; i++) d.base64[i] <<= 64 - i - d.minSymLen;
+    data += 2 * lengths;
+
+    size_t symbols = readLe16(data);
+    data += 2;
+    if ((size_t)(end - data) < 3 * symbols + (symbols & 1)) return nullptr;
+    d.tree = data;
+    d.symLen.assign(symbols, 0);
+    std::vector<bool> visited(symbols);
+    for (size_t symbol = 0; symbol < symbols; symbol++) {
+        if (!visited[symbol]) d.symLen[symbol] = symbolLength(d, (int)symbol, visited);
+    }
+    return data + 3 * symbols + (symbols & 1);
+}
+
+void SyzygyTable::load(bool dtzFile) {
+    SyzygyFile &table = dtzFile ? dtz : wdl;
+    std::string path = stem + (dtzFile ? ".rtbz" : ".rtbw");
+
+    // the dtz files are optional, only a wdl file that can't be mapped is reported
+    std::error_code error;
+    if (dtzFile && !std::filesystem::exists(path, error)) return;
+    if (!table.file.open(path, false)) {
+        std::cerr << "info string could not map " << path << std::endl;
+        return;
+    }
+
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(table.file.data());
+    const uint8_t* end = base + table.file.size();
+    auto invalid = [&] {
+        std::cerr << "info string " << path << " isn't a valid syzygy table" << std::endl;
+        table.file.close();
+    };
+
+    if (table.file.size() < 6 || readLe32(base) != (dtzFile ? SYZYGY_DTZ_MAGIC : SYZYGY_WDL_MAGIC)) return invalid();
+    const uint8_t* data = base + 4;
+    if (bool(*data & SYZYGY_HAS_PAWNS) != hasPawns || bool(*data & SYZYGY_SPLIT) != (key != key2)) return invalid();
+    data++;
+
+    int sides = (!dtzFile && key != key2) ? 2 : 1;
+    int files = hasPawns ? 4 : 1;
+    bool bothPawns = hasPawns && pawnCount[1];
+
+    for (int file = 0; file < files; file++) {
+        if (end - data < 1 + bothPawns + pieceCount) return invalid();
+        int order[2][2] = {{data[0] & 0xF, bothPawns ? data[1] & 0xF : 0xF}, {data[0] >> 4, bothPawns ? data[1] >> 4 : 0xF}};
+        data += 1 + bothPawns;
+
+        for (int side = 0; side < sides; side++) {
+            SyzygyPairs &d = table.pairs[side][file];
+            uint64_t pieceKey = 0;
+            for (int k = 0; k < pieceCount; k++) {
+                d.pieces[k] = side ? data[k] >> 4 : data[k] & 0xF;
+                int piece = enginePiece(d.pieces[k]);
+                if (piece < WP || piece > BK) return invalid();
+                pieceKey += 1ULL << (4 * piece);
+            }
+            // the pieces must be the table's, or the index would be built from the wrong squares
+            if (pieceKey != key || order[side][0] >= pieceCount) return invalid();
+            setGroups(*this, d, order[side], file);
+        }
+        data += pieceCount;
+    }
+    data += (data - base) & 1;
+
+    for (int file = 0; file < files; file++) {
+        for (int side = 0; side < sides; side++) {
+            data = setSizes(table.pairs[side][file], data, end);
+            if (!data) return invalid();
+        }
+    }
+
+    if (dtzFile) {
+        table.map = data;
+        for (int file = 0; file < files; file++) {
+            SyzygyPairs &d = table.pairs[0][file];
+            if (!(d.flags & SYZYGY_MAPPED)) continue;
+
+            // four lists of values (loss, win, cursed win, blessed loss), each led by its length
+            if (d.flags & SYZYGY_WIDE) data += (data - base) & 1;
+            for (int i = 0; i < 4; i++) {
+                if (end - data < 2) return invalid();
+                if (d.flags & SYZYGY_WIDE) {
+                    d.mapIdx[i] = (uint32_t)(data - table.map) + 2;
+                    data += 2 * readLe16(data) + 2;
+                } else {
+                    d.mapIdx[i] = (uint32_t)(data - table.map) + 1;
+                    data += *data + 1;
+                }
+            }
+        }
+        data += (data - base) & 1;
+    }
+
+    for (int file = 0; file < files; file++) {
+        for (int side = 0; side < sides; side++) {
+            SyzygyPairs &d = table.pairs[side][file];
+            d.sparseIndex = data;
+            data += d.sparseIndexSize * 6;
+        }
+    }
+    for (int file = 0; file < files; file++) {
+        for (int side = 0; side < sides; side++) {
+            SyzygyPairs &d = table.pairs[side][file];
+            d.blockLength = data;
+            data += d.blockLengthSize * 2;
+        }
+    }
+    for (int file = 0; file < files; file++) {
+        for (int side = 0; side < sides; side++) {
+            SyzygyPairs &d = table.pairs[side][file];
+            data = base + (((data - base) + 63) & ~63);
+            d.data = data;
+            data += d.blocks * d.blockSize;
+        }
+    }
+    if (data > end) return invalid();
+    table.ok = true;
+}
+
+// value stored at an index
+static int decompress(const SyzygyPairs &d, uint64_t index) {
+    if (d.flags & SYZYGY_SINGLE_VALUE) return d.minSymLen;
+
+    // the sparse index has the block and offset of the index in the middle of each span, the blocks around
+    // it are walked from there
+    const uint8_t* entry = d.sparseIndex + 6 * (index / d.span);
+    uint64_t block = readLe32(entry);
+    int64_t offset = (int64_t)readLe16(entry + 4) + (int64_t)(index % d.span) - (int64_t)(d.span / 2);
+
+    while (offset < 0) offset += readLe16(d.blockLength + 2 * --block) + 1;
+    while (offset > readLe16(d.blockLength + 2 * block)) offset -= readLe16(d.blockLength + 2 * block++) + 1;
+
+    // huffman codes are read big endian from the start of the block, a symbol stands for symLen + 1 values
+    const uint8_t* next = d.data + block * d.blockSize;
+    uint64_t buffer = readBe64(next);
+    next += 8;
+    int bits = 64;
+    int symbol;
+
+    while (true) {
+        int length = 0;
+        while (buffer < d.base64[length]) length++;
+        symbol = (int)((buffer - d.base64[length]) >> (64 - length - d.minSymLen));
+        symbol += readLe16(d.lowestSym + 2 * length);
+        if (offset < d.symLen[symbol] + 1) break;
+
+        offset -= d.symLen[symbol] + 1;
+        length += d.minSymLen;
+        buffer <<= length;
+        bits -= length;
+        if (bits <= 32) {
+            bits += 32;
+            buffer |= (uint64_t)readBe32(next) << (64 - bits);
+            next += 4;
+        }
+    }
+
+    // the symbol is a pair of symbols, the one holding the offset is followed down to a single value
+    while (d.symLen[symbol]) {
+        const uint8_t* pair = d.tree + 3 * symbol;
+        int left = pair[0] | ((pair[1] & 0xF) << 8);
+        if (offset < d.symLen[left] + 1) {
+            symbol = left;
+        } else {
+            offset -= d.symLen[left] + 1;
+            symbol = (pair[2] << 4) | (pair[1] >> 4);
+        }
+    }
+    const uint8_t* pair = d.tree + 3 * symbol;
+    return pair[0] | ((pair[1] & 0xF) << 8);
+}
+
+static bool byMapPawns(int a, int b) {
+    return indexTables().mapPawns[a] < indexTables().mapPawns[b];
+}
+
+/*
+index of the squares (leading pawns first, pieces in any order) in a set of pairs:
+    pieces are put in the table's order and the board is mirrored so the leading piece is on files a-d
+    (and without pawns on ranks 1-4, with the first piece off a1-h8 below it)
+    the leading group (pawns of the leading colour, or the kings or three unique pieces) gets its own
+    encoding, every other group of identical pieces the combination of its squares without the ones taken
+*/
+static uint64_t encode(const SyzygyTable &table, const SyzygyPairs &d, int squares[], int pieces[], int size, int leadPawns) {
+    const SyzygyIndexTables &maps = indexTables();
+
+    for (int i = leadPawns; i < size - 1; i++) {
+        for (int j = i + 1; j < size; j++) {
+            if (d.pieces[i] == pieces[j]) {
+                std::swap(pieces[i], pieces[j]);
+                std::swap(squares[i], squares[j]);
+                break;
+            }
+        }
+    }
+
+    if ((squares[0] & 7) > 3) {
+        for (int i = 0; i < size; i++) squares[i] ^= 7;
+    }
+
+    uint64_t index;
+    if (table.hasPawns) {
+        index = maps.leadPawnIdx[leadPawns][squares[0]];
+        std::stable_sort(squares + 1, squares + leadPawns, byMapPawns);
+        for (int i = 1; i < leadPawns; i++) index += maps.binomial[i][maps.mapPawns[squares[i]]];
+    } else {
+        if ((squares[0] >> 3) > 3) {
+            for (int i = 0; i < size; i++) squares[i] ^= 56;
+        }
+        for (int i = 0; i < d.groupLen[0]; i++) {
+            if (!offDiagonal(squares[i])) continue;
+            if (offDiagonal(squares[i]) > 0) {
+                for (int j = i; j < size; j++) squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+            }
+            break;
+        }
+
+        if (table.hasUniquePieces) {
+            int s0 = squares[0], s1 = squares[1], s2 = squares[2];
+            int adjust1 = s1 > s0;
+            int adjust2 = (s2 > s0) + (s2 > s1);
+            if (offDiagonal(s0)) {
+                index = ((uint64_t)maps.mapA1D1D4[s0] * 63 + (s1 - adjust1)) * 62 + s2 - adjust2;
+            } else if (offDiagonal(s1)) {
+                index = ((uint64_t)6 * 63 + (s0 >> 3) * 28 + maps.mapB1H1H7[s1]) * 62 + s2 - adjust2;
+            } else if (offDiagonal(s2)) {
+                index = 6 * 63 * 62 + 4 * 28 * 62 + (s0 >> 3) * 7 * 28 + ((s1 >> 3) - adjust1) * 28 + maps.mapB1H1H7[s2];
+            } else {
+                index = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + (s0 >> 3) * 7 * 6 + ((s1 >> 3) - adjust1) * 6 + ((s2 >> 3) - adjust2);
+            }
+        } else {
+            index = maps.mapKK[maps.mapA1D1D4[squares[0]]][squares[1]];
+        }
+    }
+    index *= d.groupIdx[0];
+
+    // squares already taken by earlier groups are skipped, the other side's pawns also skip rank 1
+    int* group = squares + d.groupLen[0];
+    bool remainingPawns = table.hasPawns && table.pawnCount[1];
+    for (int next = 1; d.groupLen[next]; next++) {
+        std::sort(group, group + d.groupLen[next]);
+        uint64_t combination = 0;
+        for (int i = 0; i < d.groupLen[next]; i++) {
+            int taken = (int)std::count_if(squares, group, [&](int square) { return square < group[i]; });
+            combination += maps.binomial[i + 1][group[i] - taken - 8 * remainingPawns];
+        }
+        remainingPawns = false;
+        index += combination * d.groupIdx[next];
+        group += d.groupLen[next];
+    }
+    return index;
+}
+
+static std::vector<std::unique_ptr<SyzygyTable>> tables;
+static std::unordered_map<uint64_t, SyzygyTable*> tablesByKey;
+
+bool Syzygy::probeTable(const Board &board, bool dtz, int wdl, int &value, bool &otherSide) {
+    otherSide = false;
+    uint64_t key = Tablebase::pieceCounts(board);
+    auto found = tablesByKey.find(key);
+    if (found == tablesByKey.end()) return false;
+
+    SyzygyTable &table = *found->second;
+    SyzygyFile &file = dtz ? table.dtz : table.wdl;
+    std::call_once(file.loadOnce, [&table, dtz] { table.load(dtz); });
+    if (!file.ok) return false;
+
+    // the tables have the side of the name's first pieces as white (and white to move for equal material),
+    // other positions swap the colours and mirror the ranks
+    bool flip = (table.key == table.key2) ? board.activeColour == BLACK : key != table.key;
+    int flipColour = flip ? 8 : 0;
+    int flipSquares = flip ? 56 : 0;
+    int side = flip ^ board.activeColour;
+
+    int squares[SYZYGY_MAX_PIECES];
+    int pieces[SYZYGY_MAX_PIECES];
+    int size = 0, leadPawns = 0, pawnFile = 0;
+    U64 leadPawnBits = 0;
+    if (table.hasPawns) {
+        leadPawnBits = board.bitboards[enginePiece(file.pairs[0][0].pieces[0] ^ flipColour)];
+        for (U64 pawns = leadPawnBits; pawns;) squares[size++] = popLSB(pawns) ^ flipSquares;
+        leadPawns = size;
+        std::swap(squares[0], *std::max_element(squares, squares + leadPawns, byMapPawns));
+        pawnFile = std::min(squares[0] & 7, 7 - (squares[0] & 7));
+    }
+
+    const SyzygyPairs &d = file.pairs[dtz ? 0 : side][pawnFile];
+    if (dtz && (d.flags & SYZYGY_STM) != side && !(table.key == table.key2 && !table.hasPawns)) {
+        otherSide = true;
+        return true;
+    }
+
+    for (U64 rest = board.bitboards[ALL_OCC] ^ leadPawnBits; rest;) {
+        int square = popLSB(rest);
+        squares[size] = square ^ flipSquares;
+        pieces[size++] = syzygyPiece(board.boardArr[square]) ^ flipColour;
+    }
+
+    uint64_t index = encode(table, d, squares, pieces, size, leadPawns);
+    if (index >= d.size) return false;
+    value = decompress(d, index);
+    if (!dtz) return true;
+
+    // mapped tables store an index into the list of distances for the result
+    static const int mapList[] = {1, 3, 0, 2, 0};
+    if (d.flags & SYZYGY_MAPPED) {
+        const uint8_t* list = file.map + d.mapIdx[mapList[wdl + 2]];
+        value = (d.flags & SYZYGY_WIDE) ? readLe16(list + 2 * value) : list[value];
+    }
+    bool plies = (wdl == SYZYGY_WIN && (d.flags & SYZYGY_WIN_PLIES)) || (wdl == SYZYGY_LOSS && (d.flags & SYZYGY_LOSS_PLIES));
+    if (!plies) value *= 2;
+    value++;
+    return true;
+}
+
+bool Syzygy::probeWdlTable(const Board &board, int &wdl) {
+    if (popCount(board.bitboards[ALL_OCC]) == 2) {
+        wdl = SYZYGY_DRAW;
+        return true;
+    }
+    int value;
+    bool otherSide;
+    if (!probeTable(board, false, 0, value, otherSide)) return false;
+    wdl = value - 2;
+    return true;
+}
+
+/*
+the tables may store anything for a position whose best move is a capture (en passant isn't stored at all),
+so the captures are searched and the better of them and the table is the result; zeroing is set when that comes
+from a capture (or with pawnMoves a pawn move), which the dtz tables don't store a distance for
+*/
+bool Syzygy::searchZeroingMoves(const Board &board, bool pawnMoves, int &wdl, bool &zeroing) {
+    std::vector<Move> moves = MoveGen::generateLegalMoves(board);
+    int best = SYZYGY_LOSS;
+    size_t searched = 0;
+
+    for (Move move : moves) {
+        bool pawn = board.boardArr[fromSq(move)] % 6 == WP;
+        if (!(moveFlags(move) & CAPTURE) && !(pawnMoves && pawn)) continue;
+        searched++;
+
+        Board next = board;
+        next.makeMove(move);
+        int value;
+        bool unused;
+        if (!searchZeroingMoves(next, false, value, unused)) return false;
+        value = -value;
+
+        if (value > best) {
+            best = value;
+            if (value == SYZYGY_WIN) {
+                wdl = value;
+                zeroing = true;
+                return true;
+            }
+        }
+    }
+
+    // when every move was searched the table isn't needed (and may be wrong, e.g. for an en passant)
+    bool allSearched = searched && searched == moves.size();
+    int value = best;
+    if (!allSearched && !probeWdlTable(board, value)) return false;
+
+    zeroing = best >= value && (best > SYZYGY_DRAW || allSearched);
+    wdl = std::max(best, value);
+    return true;
+}
+
+// dtz of the move before a capture or pawn move reaching wdl
+static int dtzBeforeZeroing(int wdl) {
+    static const int dtz[] = {-1, -101, 0, 101, 1};
+    return dtz[wdl + 2];
+}
+
+static int sign(int value) { return (value > 0) - (value < 0); }
+
+bool Syzygy::probeDtzTable(const Board &board, int &dtz) {
+    int wdl;
+    bool zeroing;
+    if (!searchZeroingMoves(board, true, wdl, zeroing)) return false;
+    if (wdl == SYZYGY_DRAW) {
+        dtz = 0;
+        return true;
+    }
+    if (zeroing) {
+        dtz = dtzBeforeZeroing(wdl);
+        return true;
+    }
+
+    int value;
+    bool otherSide;
+    if (!probeTable(board, true, wdl, value, otherSide)) return false;
+    if (!otherSide) {
+        dtz = (value + (wdl == SYZYGY_CURSED_WIN || wdl == SYZYGY_BLESSED_LOSS ? 100 : 0)) * sign(wdl);
+        return true;
+    }
+
+    // the table holds the other side to move, so the best move with the same result is found one ply down
+    int best = 0xFFFF;
+    for (Move move : MoveGen::generateLegalMoves(board)) {
+        bool zeroingMove = (moveFlags(move) & CAPTURE) || board.boardArr[fromSq(move)] % 6 == WP;
+        Board next = board;
+        next.makeMove(move);
+
+        if (zeroingMove) {
+            int nextWdl;
+            bool unused;
+            if (!searchZeroingMoves(next, false, nextWdl, unused)) return false;
+            value = -dtzBeforeZeroing(nextWdl);
+        } else {
+            if (!probeDtzTable(next, value)) return false;
+            value = -value;
+        }
+
+        // a mate is the shortest win there is
+        if (value == 1 && MoveGen::inCheck(next) && MoveGen::countLegalMoves(next) == 0) best = 1;
+        if (!zeroingMove) value += sign(value);
+        if (value < best && sign(value) == sign(wdl)) best = value;
+    }
+    dtz = (best == 0xFFFF) ? -1 : best;
+    return true;
+}
+
+void Syzygy::init(const std::string &path, bool quiet) {
+    tablesByKey.clear();
+    tables.clear();
+    largest = 0;
+
+    size_t start = 0;
+    while (start <= path.size() && !path.empty()) {
+        size_t end = path.find_first_of(":;", start);
+        if (end == std::string::npos) end = path.size();
+        std::string directory = path.substr(start, end - start);
+        start = end + 1;
+
+        std::error_code error;
+        if (directory.empty() || !std::filesystem::is_directory(directory, error)) continue;
+
+        for (const auto &file : std::filesystem::directory_iterator(directory, error)) {
+            if (file.path().extension() != ".rtbw") continue;
+
+            auto table = std::make_unique<SyzygyTable>();
+            if (!table->parse(file.path().stem().string())) continue;
+            table->stem = std::filesystem::path(file.path()).replace_extension().string();
+
+            // the same material with the colours swapped is probed through the same table
+            if (tablesByKey.count(table->key)) continue;
+            tablesByKey[table->key] = table.get();
+            tablesByKey[table->key2] = table.get();
+
+            largest = std::max(largest, table->pieceCount);
+            tables.push_back(std::move(table));
+        }
+    }
+
+    if (!quiet) std::cout << "info string found " << tables.size() << " syzygy tables with up to " << largest << " pieces" << std::endl;
+    setProbeLimit(requestedLimit);
+}
+
+void Syzygy::setProbeLimit(int pieces) {
+    requestedLimit = pieces;
+    limit = std::min(pieces, largest);
+}
+
+int Syzygy::tableCount() {
+    return (int)tables.size();
+}
+
+bool Syzygy::probeWdl(const Board &board, int &result) {
+    if (board.castlingRights || popCount(board.bitboards[ALL_OCC]) > largest) return false;
+    bool zeroing;
+    return searchZeroingMoves(board, false, result, zeroing);
+}
+
+bool Syzygy::probeDtz(const Board &board, int &dtz) {
+    if (board.castlingRights || popCount(board.bitboards[ALL_OCC]) > largest) return false;
+    return probeDtzTable(board, dtz);
+}
+
+bool Syzygy::filterRootMoves(const Board &board, std::vector<Move> &moves) {
+    if (board.castlingRights || popCount(board.bitboards[ALL_OCC]) > largest) return false;
+
+    std::vector<std::pair<Move, int>> ranked; // move and its rank, higher is better
+    int best = -SYZYGY_MAX_DTZ - 1000;
+
+    for (Move move : moves) {
+        if (!MoveGen::isLegal(board, move)) continue;
+
+        Board next = board;
+        next.makeMove(move);
+        bool mate = MoveGen::inCheck(next) && MoveGen::countLegalMoves(next) == 0;
+
+        // dtz counted from the root
+        int dtz;
+        if (next.halfMoves == 0) {
+            int wdl;
+            if (!probeWdl(next, wdl)) return false;
+            dtz = dtzBeforeZeroing(-wdl);
+        } else if (next.halfMoves >= 100 && !mate) {
+            dtz = 0;
+        } else {
+            if (!probeDtzTable(next, dtz)) return false;
+            dtz = -dtz;
+            dtz += sign(dtz);
+        }
+        if (mate && dtz == 2) dtz = 1;
+
+        // wins the fifty move rule doesn't stop zero the counter soonest, losses it doesn't save hold out
+        // longest, and either is ranked past the ones the rule turns into draws
+        int fifty = board.halfMoves;
+        int rank = 0;
+        if (dtz > 0) rank = (dtz + fifty <= 99) ? SYZYGY_MAX_DTZ - dtz : SYZYGY_MAX_DTZ - (dtz + fifty);
+        else if (dtz < 0) rank = (-dtz * 2 + fifty < 100) ? -SYZYGY_MAX_DTZ - dtz : -SYZYGY_MAX_DTZ + (-dtz + fifty);
+
+        ranked.push_back({move, rank});
+        best = std::max(best, rank);
+    }
+    if (ranked.empty()) return false;
+
+    moves.clear();
+    for (const auto &[move, rank] : ranked) {
+        if (rank == best) moves.push_back(move);
+    }
+    return true;
+}
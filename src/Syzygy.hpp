@@ -0,0 +1,68 @@
+#ifndef CHESS_SYZYGY_HPP
+#define CHESS_SYZYGY_HPP
+
+#include "Move.hpp"
+#include <string>
+#include <vector>
+
+class Board;
+
+// most pieces (kings included) of a syzygy table
+#define SYZYGY_MAX_PIECES 7
+
+// value of a position for the side to move with the fifty move counter at zero, a cursed win or blessed
+// loss is a win or loss the fifty move rule turns into a draw
+enum SyzygyWdl {
+    SYZYGY_LOSS         = -2,
+    SYZYGY_BLESSED_LOSS = -1,
+    SYZYGY_DRAW         = 0,
+    SYZYGY_CURSED_WIN   = 1,
+    SYZYGY_WIN          = 2
+};
+
+/*
+syzygy tables (KQvKR.rtbw for win/draw/loss, KQvKR.rtbz for distance to zeroing), in the published format
+of the generator: every table file holds huffman coded, pair compressed values in fixed size blocks, indexed
+by the pieces' squares after symmetry reduction. the tables leave out positions with castling rights, and may
+store anything for a position whose best move is a capture (or a pawn move for the dtz), so a probe searches
+those moves itself
+*/
+class Syzygy {
+    public:
+        // registers the .rtbw files of the directories in path (':' or ';' separated) without reading them,
+        // tables are memory mapped on their first probe; not to be called while a search runs
+        static void init(const std::string &path, bool quiet = false);
+
+        // positions with at most this many pieces are probed (largest table found, lowered by setProbeLimit)
+        static int probeLimit() { return limit; }
+        static void setProbeLimit(int pieces);
+
+        // SyzygyWdl of the side to move as if the fifty move counter was zero, false if no table covers the position
+        static bool probeWdl(const Board &board, int &result);
+
+        // plies to the next capture or pawn move with best play, positive when winning and negative when losing
+        // (100 further out for cursed wins and blessed losses), 0 for a draw; needs the .rtbz files
+        static bool probeDtz(const Board &board, int &dtz);
+
+        // keeps the root moves with the best result that zero the counter soonest (latest when losing), false if
+        // not every move could be probed (the moves are left alone then)
+        static bool filterRootMoves(const Board &board, std::vector<Move> &moves);
+
+        static int tableCount();
+
+    private:
+        // value the table stores for the board (a wdl 0..4, or a dtz in plies for the given wdl), false if there is
+        // no table for it; a dtz table that only holds the other side to move sets otherSide instead
+        static bool probeTable(const Board &board, bool dtz, int wdl, int &value, bool &otherSide);
+        static bool probeWdlTable(const Board &board, int &wdl);
+
+        // table result improved by the captures (and pawn moves) the table doesn't store, see Syzygy.cpp
+        static bool searchZeroingMoves(const Board &board, bool pawnMoves, int &wdl, bool &zeroing);
+        static bool probeDtzTable(const Board &board, int &dtz);
+
+        static int limit;
+        static int requestedLimit;
+        static int largest;
+};
+
+#endif
@@ -0,0 +1,471 @@
+#include "Tablebase.hpp"
+#include "Board.hpp"
+#include "BitUtils.hpp"
+#include "MappedFile.hpp"
+#include "MoveGen.hpp"
+#include "Syzygy.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+int Tablebase::limit = 0;
+int Tablebase::requestedLimit = TB_MAX_PIECES;
+int Tablebase::largest = 0;
+
+// binomial coefficients for the combination index of a group of identical pieces
+struct TbBinomials {
+    uint64_t values[65][TB_MAX_PIECES];
+
+    constexpr TbBinomials() : values() {
+        for (int n = 0; n <= 64; n++) {
+            values[n][0] = 1;
+            for (int k = 1; k < TB_MAX_PIECES; k++) values[n][k] = (n == 0) ? 0 : values[n - 1][k - 1] + values[n - 1][k];
+        }
+    }
+};
+
+static constexpr TbBinomials binomials;
+
+// king pairs after symmetry reduction, one set for tables with pawns and one without
+struct TbKingPairs {
+    int index[2][64][64];
+    int squares[2][64 * 64][2];
+    int count[2];
+
+    TbKingPairs() {
+        for (int pawns = 0; pawns < 2; pawns++) {
+            count[pawns] = 0;
+            for (int white = 0; white < 64; white++) {
+                int file = white % 8, rank = white / 8;
+                bool reduced = pawns ? file < 4 : (file < 4 && rank <= file);
+
+                for (int black = 0; black < 64; black++) {
+                    int distance = std::max(std::abs(file - black % 8), std::abs(rank - black / 8));
+                    // with the white king on the diagonal the black king is mirrored below it
+                    bool aboveDiagonal = !pawns && rank == file && black / 8 > black % 8;
+                    if (!reduced || distance <= 1 || aboveDiagonal) {
+                        index[pawns][white][black] = -1;
+                        continue;
+                    }
+                    index[pawns][white][black] = count[pawns];
+                    squares[pawns][count[pawns]][0] = white;
+                    squares[pawns][count[pawns]][1] = black;
+                    count[pawns]++;
+                }
+            }
+        }
+    }
+};
+
+static const TbKingPairs& kingPairs() {
+    static const TbKingPairs pairs;
+    return pairs;
+}
+
+static const char pieceLetters[] = "PNBRQK";
+
+// order of the non king pieces within a side
+static const int pieceOrder[] = {WQ, WR, WB, WN, WP};
+
+bool TbMaterial::parse(std::string_view name, TbMaterial &material) {
+    size_t separator = name.find('v');
+    if (separator == std::string_view::npos) return false;
+
+    material = TbMaterial();
+    int counts[12] = {};
+    for (size_t i = 0; i < name.size(); i++) {
+        if (i == separator) continue;
+        size_t type = std::string_view(pieceLetters).find(name[i]);
+        if (type == std::string_view::npos) return false;
+        counts[type + (i > separator ? 6 : 0)]++;
+    }
+    if (counts[WK] != 1 || counts[BK] != 1) return false;
+
+    material.pieces[material.count++] = WK;
+    material.pieces[material.count++] = BK;
+    for (int colour = 0; colour < 12; colour += 6) {
+        for (int type : pieceOrder) {
+            for (int i = 0; i < counts[type + colour]; i++) {
+                if (material.count == TB_MAX_PIECES) return false;
+                material.pieces[material.count++] = type + colour;
+            }
+        }
+    }
+    material.pawns = counts[WP] + counts[BP] > 0;
+
+    material.size = kingPairs().count[material.pawns];
+    for (int i = 2; i < material.count;) {
+        int group = 1;
+        while (i + group < material.count && material.pieces[i + group] == material.pieces[i]) group++;
+        material.size *= binomials.values[material.pieces[i] % 6 == WP ? 48 : 64][group];
+        i += group;
+    }
+    return true;
+}
+
+std::string TbMaterial::name() const {
+    std::string white = "K", black = "K";
+    for (int i = 2; i < count; i++) (pieces[i] < BP ? white : black) += pieceLetters[pieces[i] % 6];
+    return white + "v" + black;
+}
+
+uint64_t TbMaterial::key() const {
+    uint64_t key = 0;
+    for (int i = 0; i < count; i++) key += 1ULL << (4 * pieces[i]);
+    return key;
+}
+
+// symmetry that brings the white king into the reduced set, applied to every square
+static int reduceSquare(int square, int flips) {
+    if (flips & 1) square ^= 7;                                  // mirror the files
+    if (flips & 2) square ^= 56;                                 // mirror the ranks
+    if (flips & 4) square = ((square & 7) << 3) | (square >> 3); // mirror along a1-h8
+    return square;
+}
+
+// index once the symmetry flips are chosen
+static uint64_t reducedIndex(const TbMaterial &material, const int squares[], int flips) {
+    const int* pieces = material.pieces;
+    int count = material.count;
+    uint64_t index = kingPairs().index[material.pawns][reduceSquare(squares[0], flips)][reduceSquare(squares[1], flips)];
+
+    for (int i = 2; i < count;) {
+        int group = 1;
+        while (i + group < count && pieces[i + group] == pieces[i]) group++;
+
+        bool pawn = pieces[i] % 6 == WP;
+        int reduced[TB_MAX_PIECES];
+        for (int j = 0; j < group; j++) {
+            // groups hold a few pieces, insertion keeps them ascending
+            int square = reduceSquare(squares[i + j], flips) - (pawn ? 8 : 0);
+            int k = j;
+            for (; k > 0 && reduced[k - 1] > square; k--) reduced[k] = reduced[k - 1];
+            reduced[k] = square;
+        }
+
+        uint64_t combination = 0;
+        for (int j = 0; j < group; j++) combination += binomials.values[reduced[j]][j + 1];
+
+        index = index * binomials.values[pawn ? 48 : 64][group] + combination;
+        i += group;
+    }
+    return index;
+}
+
+uint64_t TbMaterial::index(const int squares[]) const {
+    int king = squares[0];
+    int flips = 0;
+    if (king % 8 > 3) flips |= 1;
+    if (!pawns) {
+        king = reduceSquare(king, flips);
+        if (king / 8 > 3) flips |= 2;
+        king = reduceSquare(squares[0], flips);
+        if (king / 8 > king % 8) flips |= 4;
+        else if (king / 8 == king % 8) {
+            // the white king stays on the diagonal either way, so the black king picks the side and the
+            // smaller index decides when both kings are on it
+            int black = reduceSquare(squares[1], flips);
+            if (black / 8 > black % 8) flips |= 4;
+            else if (black / 8 == black % 8) return std::min(reducedIndex(*this, squares, flips), reducedIndex(*this, squares, flips | 4));
+        }
+    }
+    return reducedIndex(*this, squares, flips);
+}
+
+bool TbMaterial::squares(uint64_t index, int squares[]) const {
+    uint64_t occupied = 0;
+
+    // groups were added last to first, so they come off the index in reverse
+    for (int end = count; end > 2;) {
+        int group = 1;
+        while (end - group - 1 >= 2 && pieces[end - group - 1] == pieces[end - 1]) group++;
+        int first = end - group;
+
+        bool pawn = pieces[first] % 6 == WP;
+        uint64_t groupSize = binomials.values[pawn ? 48 : 64][group];
+        uint64_t combination = index % groupSize;
+        index /= groupSize;
+
+        // largest square first: the highest n with C(n, k) <= what is left
+        int n = pawn ? 48 : 64;
+        for (int j = group - 1; j >= 0; j--) {
+            while (binomials.values[n][j + 1] > combination) n--;
+            combination -= binomials.values[n][j + 1];
+            squares[first + j] = n + (pawn ? 8 : 0);
+        }
+        for (int j = first; j < end; j++) {
+            if (occupied & (1ULL << squares[j])) return false;
+            occupied |= 1ULL << squares[j];
+        }
+        end = first;
+    }
+
+    squares[0] = kingPairs().squares[pawns][index][0];
+    squares[1] = kingPairs().squares[pawns][index][1];
+    return !(occupied & ((1ULL << squares[0]) | (1ULL << squares[1])));
+}
+
+// a registered table file, mapped by the first probe that needs it
+struct TbTable {
+    TbMaterial material;
+    std::string path;
+
+    std::once_flag loadOnce;
+    bool ok = false;
+    MappedFile file;
+    const uint8_t* wdl = nullptr;
+    const uint8_t* dtm = nullptr;
+    int dtmBits = 0;
+
+    void load() {
+        if (!file.open(path, false)) {
+            std::cerr << "info string could not map " << path << std::endl;
+            return;
+        }
+
+        TbHeader header;
+        if (file.size() < sizeof(header)) return;
+        std::memcpy(&header, file.data(), sizeof(header));
+
+        uint64_t positions = 2 * material.size;
+        bool valid = std::memcmp(header.magic, TB_MAGIC, 8) == 0 && header.size == material.size
+            && header.pieces == (uint32_t)material.count && header.dtmBits <= 16
+            && header.wdlOffset + (positions + 3) / 4 <= header.dtmOffset
+            && header.dtmOffset + (positions * header.dtmBits + 7) / 8 + 8 <= file.size();
+        if (!valid) {
+            std::cerr << "info string " << path << " isn't a valid table" << std::endl;
+            file.close();
+            return;
+        }
+
+        wdl = reinterpret_cast<const uint8_t*>(file.data()) + header.wdlOffset;
+        dtm = reinterpret_cast<const uint8_t*>(file.data()) + header.dtmOffset;
+        dtmBits = (int)header.dtmBits;
+        ok = true;
+    }
+};
+
+static std::vector<std::unique_ptr<TbTable>> tables;
+
+// table for a material key, and whether the board has to swap colours to match it
+struct TbEntry {
+    TbTable* table;
+    bool swapColours;
+};
+static std::unordered_map<uint64_t, TbEntry> tablesByKey;
+
+void Tablebase::init(const std::string &path, bool quiet) {
+    tablesByKey.clear();
+    tables.clear();
+    largest = 0;
+
+    size_t start = 0;
+    while (start <= path.size() && !path.empty()) {
+        size_t end = path.find_first_of(":;", start);
+        if (end == std::string::npos) end = path.size();
+        std::string directory = path.substr(start, end - start);
+        start = end + 1;
+
+        std::error_code error;
+        if (directory.empty() || !std::filesystem::is_directory(directory, error)) continue;
+
+        for (const auto &file : std::filesystem::directory_iterator(directory, error)) {
+            if (file.path().extension() != TB_EXTENSION) continue;
+
+            auto table = std::make_unique<TbTable>();
+            if (!TbMaterial::parse(file.path().stem().string(), table->material)) continue;
+            table->path = file.path().string();
+
+            // the same material with the colours swapped is probed through the same table
+            uint64_t key = table->material.key();
+            uint64_t swapped = (key >> 24) | ((key & 0xFFFFFF) << 24);
+            if (tablesByKey.count(key)) continue;
+            tablesByKey[key] = TbEntry{table.get(), false};
+            if (swapped != key) tablesByKey[swapped] = TbEntry{table.get(), true};
+
+            largest = std::max(largest, table->material.count);
+            tables.push_back(std::move(table));
+        }
+    }
+
+    if (!quiet) std::cout << "info string found " << tables.size() << " tables with up to " << largest << " pieces" << std::endl;
+    setProbeLimit(requestedLimit);
+}
+
+void Tablebase::setProbeLimit(int pieces) {
+    requestedLimit = pieces;
+    limit = std::min(pieces, largest);
+}
+
+uint64_t Tablebase::pieceCounts(const Board &board) {
+    uint64_t key = 0;
+    for (int piece = WP; piece <= BK; piece++) key += (uint64_t)popCount(board.bitboards[piece]) << (4 * piece);
+    return key;
+}
+
+bool Tablebase::locate(const Board &board, TbTable* &table, uint64_t &index) {
+    if (board.castlingRights) return false;
+    if (board.ep_target != NO_SQ) {
+        // only a capture that can be played makes the position differ from the table's
+        int file = board.ep_target % 8;
+        int pawnSquare = board.ep_target + (board.activeColour == WHITE ? -8 : 8);
+        int ownPawn = board.activeColour == WHITE ? WP : BP;
+        if ((file > 0 && board.boardArr[pawnSquare - 1] == ownPawn) || (file < 7 && board.boardArr[pawnSquare + 1] == ownPawn)) return false;
+    }
+
+    auto found = tablesByKey.find(pieceCounts(board));
+    if (found == tablesByKey.end()) return false;
+
+    table = found->second.table;
+    std::call_once(table->loadOnce, [table] { table->load(); });
+    if (!table->ok) return false;
+
+    // squares in the table's piece order, with the colours swapped when the table has the other side as white
+    bool swap = found->second.swapColours;
+    const TbMaterial &material = table->material;
+    int squares[TB_MAX_PIECES];
+    U64 used = 0;
+    for (int i = 0; i < material.count; i++) {
+        int piece = material.pieces[i];
+        if (swap) piece = (piece < 6) ? piece + 6 : piece - 6;
+
+        U64 candidates = board.bitboards[piece] & ~used;
+        int square = getLSB(candidates);
+        used |= 1ULL << square;
+        squares[i] = swap ? square ^ 56 : square;
+    }
+
+    int side = swap ? board.activeColour ^ 1 : board.activeColour;
+    index = side * material.size + material.index(squares);
+    return true;
+}
+
+static int readWdl(const TbTable &table, uint64_t index) {
+    return (table.wdl[index / 4] >> (2 * (index % 4))) & 3;
+}
+
+static int readDtm(const TbTable &table, uint64_t index) {
+    uint64_t bit = index * table.dtmBits;
+    uint64_t word;
+    std::memcpy(&word, table.dtm + bit / 8, sizeof(word)); // the file is padded for this read
+    return (int)((word >> (bit % 8)) & ((1ULL << table.dtmBits) - 1));
+}
+
+// only the two kings are left
+static bool bareKings(uint64_t pieceCounts) {
+    return pieceCounts == ((1ULL << (4 * WK)) | (1ULL << (4 * BK)));
+}
+
+bool Tablebase::probeWdl(const Board &board, int &result) {
+    if (bareKings(pieceCounts(board))) {
+        result = TB_DRAW;
+        return true;
+    }
+
+    TbTable* table;
+    uint64_t index;
+    if (!locate(board, table, index)) return false;
+
+    result = readWdl(*table, index);
+    if (result == TB_INVALID) return false;
+    return result == TB_DRAW || readDtm(*table, index) <= TB_FIFTY_MOVE_PLIES - board.halfMoves;
+}
+
+bool Tablebase::probeDtm(const Board &board, int &result, int &plies) {
+    if (bareKings(pieceCounts(board))) {
+        result = TB_DRAW;
+        plies = 0;
+        return true;
+    }
+
+    TbTable* table;
+    uint64_t index;
+    if (!locate(board, table, index)) return false;
+
+    result = readWdl(*table, index);
+    plies = readDtm(*table, index);
+    return result != TB_INVALID;
+}
+
+bool Tablebase::filterRootMoves(const Board &board, std::vector<Move> &moves) {
+    std::vector<std::pair<Move, int>> ranked; // move and its rank, higher is better
+    int best = -1000000;
+
+    for (Move move : moves) {
+        if (!MoveGen::isLegal(board, move)) continue;
+
+        Board next = board;
+        next.makeMove(move);
+
+        int result, plies;
+        if (!probeDtm(next, result, plies)) return false;
+        if (result != TB_DRAW && plies > TB_FIFTY_MOVE_PLIES - next.halfMoves) return false;
+
+        // wins as fast as possible, losses as slow as possible, every draw alike
+        int rank = 0;
+        if (result == TB_LOSS) rank = 1000 - plies;     // the opponent is lost, so this move wins
+        else if (result == TB_WIN) rank = -1000 + plies;
+
+        ranked.push_back({move, rank});
+        best = std::max(best, rank);
+    }
+    if (ranked.empty()) return false;
+
+    moves.clear();
+    for (const auto &[move, rank] : ranked) {
+        if (rank == best) moves.push_back(move);
+    }
+    return true;
+}
+
+int Tablebase::run(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cout << "usage: nice.exe tbprobe <directory> <fen> [fen..]" << std::endl;
+        return 1;
+    }
+
+    init(argv[2], true);
+    Syzygy::init(argv[2], true);
+    if (!largest && !Syzygy::tableCount()) {
+        std::cerr << "no " << TB_EXTENSION << " or syzygy tables in " << argv[2] << std::endl;
+        return 1;
+    }
+
+    for (int i = 3; i < argc; i++) {
+        Board board;
+        const char *error = "";
+        if (!board.setFen(argv[i], &error)) {
+            std::cout << argv[i] << " : invalid fen (" << error << ")" << std::endl;
+            continue;
+        }
+
+        int result, plies, counted;
+        std::cout << argv[i] << " : ";
+        if (largest) {
+            if (!probeDtm(board, result, plies)) std::cout << "not in the tables";
+            else if (result == TB_DRAW) std::cout << "draw";
+            else {
+                std::cout << (result == TB_WIN ? "win, mate in " : "loss, mated in ") << plies << " plies";
+                if (!probeWdl(board, counted)) std::cout << " (too late for the fifty move rule)";
+            }
+        }
+
+        if (Syzygy::tableCount()) {
+            static const char* wdlNames[] = {"loss", "blessed loss", "draw", "cursed win", "win"};
+            int dtz;
+            std::cout << (largest ? "; " : "") << "syzygy ";
+            if (!Syzygy::probeWdl(board, result)) std::cout << "not in the tables";
+            else {
+                std::cout << wdlNames[result - SYZYGY_LOSS];
+                if (result != SYZYGY_DRAW && Syzygy::probeDtz(board, dtz)) std::cout << ", dtz " << dtz << " plies";
+            }
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+#ifndef CHESS_TABLEBASE_HPP
+#define CHESS_TABLEBASE_HPP
+
+#include "Types.hpp"
+#include "Move.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Board;
+struct TbTable;
+
+// most pieces (kings included) a table can describe
+#define TB_MAX_PIECES 5
+
+#define TB_EXTENSION ".nctb"
+#define TB_MAGIC "NICETB01"
+
+// a win or loss only counts while its mate comes before the fifty move rule would draw the game
+#define TB_FIFTY_MOVE_PLIES 100
+
+// value of a position for the side to move, with best play and without the fifty move rule
+enum TbResult {
+    TB_LOSS    = 0,
+    TB_DRAW    = 1,
+    TB_WIN     = 2,
+    TB_INVALID = 3     // index that isn't a legal position
+};
+
+/*
+material of a table, named like "KQvKR" with the side written first playing as white in the table
+pieces are indexed in the order: white king, black king, white queens .. pawns, black queens .. pawns
+index of a position for one side to move:
+    king pair   : white king reduced by symmetry (a1-d1-d4 triangle without pawns, files a-d with pawns),
+                  paired with every black king square that isn't on or next to it (nor above a1-h8 while the
+                  white king is on it)
+    other groups: identical pieces of one colour form a group, indexed by the combination of their squares
+                  (pawns only use ranks 2-7)
+    index = ((kingPair * group1 + combination1) * group2 + combination2) ...
+every position a symmetry maps onto another gets the same index, with both kings on a1-h8 the smaller of the
+two indices is used and the other one is left unused
+*/
+struct TbMaterial {
+    int count = 0;
+    int pieces[TB_MAX_PIECES];
+    bool pawns = false;
+    uint64_t size = 0;          // positions per side to move
+
+    // "KQvKR", false if the name isn't a material set with 2 .. TB_MAX_PIECES pieces and one king per side
+    static bool parse(std::string_view name, TbMaterial &material);
+    std::string name() const;
+
+    // material key of the table's side as white (pieceCounts packs a 4 bit count per piece code)
+    uint64_t key() const;
+
+    // index of the pieces' squares (in the order of pieces), symmetry is applied here
+    uint64_t index(const int squares[]) const;
+
+    // squares of an index, false if pieces would share a square (unused indices still decode)
+    bool squares(uint64_t index, int squares[]) const;
+};
+
+/*
+table file, little endian
+    char[8] "NICETB01", char[16] material name, uint32 pieces, uint32 dtm bits, uint64 positions per side to move,
+    uint64 wdl offset, uint64 dtm offset, padded to 64 bytes
+    wdl: 2 bit TbResult per position (white to move first, then black), low bits first
+    dtm: dtm bits per position, plies to mate for won and lost positions (0 otherwise), followed by 8 bytes of padding
+*/
+struct TbHeader {
+    char magic[8];
+    char name[16];
+    uint32_t pieces;
+    uint32_t dtmBits;
+    uint64_t size;
+    uint64_t wdlOffset;
+    uint64_t dtmOffset;
+    char reserved[8];
+};
+
+static_assert(sizeof(TbHeader) == 64, "TbHeader must stay 64 bytes");
+
+class Tablebase {
+    public:
+        // registers the tables of the directories in path (':' or ';' separated) without reading them,
+        // tables are memory mapped on their first probe; not to be called while a search runs
+        static void init(const std::string &path, bool quiet = false);
+
+        // positions with at most this many pieces are probed (largest table found, lowered by setProbeLimit)
+        static int probeLimit() { return limit; }
+        static void setProbeLimit(int pieces);
+
+        // result for the side to move, false if no table covers the position (castling rights or a possible en passant capture included)
+        // probeWdl also fails for a win or loss whose mate doesn't fit before the fifty move rule, probeDtm is the raw table
+        static bool probeWdl(const Board &board, int &result);
+        static bool probeDtm(const Board &board, int &result, int &plies);
+
+        // keeps the root moves that hold the best result with the best distance to mate, false if not every
+        // move could be probed or a result may be changed by the fifty move rule (the moves are left alone then)
+        static bool filterRootMoves(const Board &board, std::vector<Move> &moves);
+
+        // entry point for "nice.exe tbprobe <directory> <fen> [fen..]", prints what the tables (and syzygy tables
+        // in the same directory) know of each fen
+        static int run(int argc, char* argv[]);
+
+        static uint64_t pieceCounts(const Board &board);
+
+    private:
+        // table and index of a position, false if there is no table for it
+        static bool locate(const Board &board, TbTable* &table, uint64_t &index);
+
+        static int limit;
+        static int requestedLimit;
+        static int largest;
+};
+
+#endif
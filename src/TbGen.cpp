@@ -0,0 +1,527 @@
+#include "TbGen.hpp"
+#include "Board.hpp"
+#include "BitUtils.hpp"
+#include "MoveGen.hpp"
+#include "ThreadPool.hpp"
+#include "Parse.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// state of a position while its table is generated
+enum TbGenState : uint8_t {
+    GEN_UNKNOWN,
+    GEN_WIN,
+    GEN_LOSS,
+    GEN_DRAW,
+    GEN_INVALID
+};
+
+// crossLoss of a position with a capture or promotion that doesn't lose
+#define GEN_ESCAPE 255
+
+// dtm is kept in a byte during generation
+#define GEN_MAX_ROUND 254
+
+static void atomicMax(std::atomic<int> &value, int candidate) {
+    int current = value.load();
+    while (candidate > current && !value.compare_exchange_weak(current, candidate)) {}
+}
+
+// positions of the side that moved last which reach the position with a move inside the table, deduplicated
+static int predecessors(const TbMaterial &material, const int squares[], int side, uint64_t found[]) {
+    int mover = side ^ 1;
+    U64 occupied = 0;
+    for (int i = 0; i < material.count; i++) occupied |= 1ULL << squares[i];
+
+    int previous[TB_MAX_PIECES];
+    for (int i = 0; i < material.count; i++) previous[i] = squares[i];
+
+    int count = 0;
+    for (int i = 0; i < material.count; i++) {
+        int piece = material.pieces[i];
+        if ((piece < BP ? WHITE : BLACK) != mover) continue;
+
+        int to = squares[i];
+        U64 origins = 0;
+        switch (piece % 6) {
+            case WN: origins = MoveGen::knightAttacksFrom(to); break;
+            case WB: origins = MoveGen::bishopAttacks(to, occupied); break;
+            case WR: origins = MoveGen::rookAttacks(to, occupied); break;
+            case WQ: origins = MoveGen::bishopAttacks(to, occupied) | MoveGen::rookAttacks(to, occupied); break;
+            case WK: origins = MoveGen::kingAttacksFrom(to) & ~MoveGen::kingAttacksFrom(squares[mover == WHITE ? 1 : 0]); break;
+            default: {
+                // pushes only, captures and promotions come from other tables
+                int back = mover == WHITE ? -8 : 8;
+                int origin = to + back;
+                if (origin >= 8 && origin < 56 && !(occupied & (1ULL << origin))) {
+                    origins |= 1ULL << origin;
+                    int start = origin + back;
+                    if (start / 8 == (mover == WHITE ? 1 : 6)) origins |= 1ULL << start;
+                }
+            }
+        }
+        origins &= ~occupied;
+
+        while (origins) {
+            previous[i] = popLSB(origins);
+            found[count++] = material.index(previous);
+        }
+        previous[i] = to;
+    }
+
+    std::sort(found, found + count);
+    return (int)(std::unique(found, found + count) - found);
+}
+
+// one entry per position in every array, white to move first
+struct TbGenTable {
+    TbMaterial material;
+    uint64_t positions = 0;
+
+    std::vector<uint8_t> state;
+    std::vector<uint8_t> dtm;
+    std::vector<uint8_t> remaining;     // moves within the table not yet known to lose
+    std::vector<uint8_t> crossWin;      // plies to mate through the best winning capture or promotion, 0 if none
+    std::vector<uint8_t> crossLoss;     // plies to be mated once every capture and promotion loses
+    std::vector<U64> frontier;          // positions decided in the previous round
+    std::vector<U64> next;              // positions decided in this round
+
+    std::atomic<int> maxCross{0};       // last round a capture or promotion decides a position
+    std::atomic<bool> missing{false};   // a capture or promotion led to a table that isn't there
+
+    explicit TbGenTable(const TbMaterial &tableMaterial) : material(tableMaterial) {
+        positions = 2 * material.size;
+        state.assign(positions, GEN_UNKNOWN);
+        dtm.assign(positions, 0);
+        remaining.assign(positions, 0);
+        crossWin.assign(positions, 0);
+        crossLoss.assign(positions, 0);
+        frontier.assign((positions + 63) / 64, 0);
+        next.assign((positions + 63) / 64, 0);
+    }
+
+    void decide(uint64_t position, uint8_t result, int round) {
+        uint8_t expected = GEN_UNKNOWN;
+        if (!std::atomic_ref<uint8_t>(state[position]).compare_exchange_strong(expected, result)) return;
+        dtm[position] = (uint8_t)round;
+        std::atomic_ref<U64>(next[position / 64]).fetch_or(1ULL << (position % 64));
+    }
+
+    // sets up every position of the range and decides the ones without moves, they form the first frontier
+    void initialise(uint64_t begin, uint64_t end) {
+        Board board;
+        uint64_t children[256];
+
+        for (uint64_t position = begin; position < end && !missing; position++) {
+            int side = position >= material.size ? BLACK : WHITE;
+            uint64_t index = position - (side == BLACK ? material.size : 0);
+
+            // indices that don't decode to their own reduced squares are never probed
+            int squares[TB_MAX_PIECES];
+            if (!material.squares(index, squares) || material.index(squares) != index) {
+                state[position] = GEN_INVALID;
+                continue;
+            }
+
+            TbGen::setupBoard(board, material, squares, side);
+            if (MoveGen::isSquareAttacked(board, squares[side == WHITE ? 1 : 0], side)) {
+                state[position] = GEN_INVALID;
+                continue;
+            }
+
+            std::vector<Move> moves = MoveGen::generateLegalMoves(board);
+            if (moves.empty()) {
+                state[position] = MoveGen::inCheck(board) ? GEN_LOSS : GEN_DRAW;
+                if (state[position] == GEN_LOSS) frontier[position / 64] |= 1ULL << (position % 64);
+                continue;
+            }
+
+            int count = 0;
+            int win = 0, loss = 0;
+            bool escape = false;
+            for (Move move : moves) {
+                if (moveFlags(move) & (CAPTURE | PROMOTION)) {
+                    Board child = board;
+                    child.makeMove(move);
+
+                    int result, plies;
+                    if (!Tablebase::probeDtm(child, result, plies)) {
+                        missing = true;
+                        return;
+                    }
+                    if (result == TB_LOSS) win = win ? std::min(win, plies + 1) : plies + 1;
+                    else if (result == TB_WIN) loss = std::max(loss, plies + 1);
+                    if (result != TB_WIN) escape = true;
+                    continue;
+                }
+
+                // the child's index (a double push counts as the position without en passant rights)
+                int moved[TB_MAX_PIECES];
+                for (int i = 0; i < material.count; i++) moved[i] = squares[i] == fromSq(move) ? toSq(move) : squares[i];
+                children[count++] = material.index(moved);
+            }
+            std::sort(children, children + count);
+
+            remaining[position] = (uint8_t)(std::unique(children, children + count) - children);
+            crossWin[position] = (uint8_t)win;
+            crossLoss[position] = escape ? GEN_ESCAPE : (uint8_t)loss;
+            atomicMax(maxCross, std::max(win, escape ? 0 : loss));
+        }
+    }
+
+    // positions a capture or promotion decides in this round
+    void decideCross(uint64_t begin, uint64_t end, int round) {
+        for (uint64_t position = begin; position < end; position++) {
+            if (state[position] != GEN_UNKNOWN) continue;
+            if (crossWin[position] == round) decide(position, GEN_WIN, round);
+            else if (remaining[position] == 0 && crossLoss[position] == round) decide(position, GEN_LOSS, round);
+        }
+    }
+
+    // walks back from the frontier positions of the range
+    void propagate(uint64_t begin, uint64_t end, int round) {
+        uint64_t found[256];
+
+        for (uint64_t word = begin / 64; word < (end + 63) / 64; word++) {
+            for (U64 bits = frontier[word]; bits;) {
+                uint64_t position = word * 64 + popLSB(bits);
+                int side = position >= material.size ? BLACK : WHITE;
+                uint64_t base = side == WHITE ? material.size : 0;
+
+                int squares[TB_MAX_PIECES];
+                material.squares(position - (side == BLACK ? material.size : 0), squares);
+                bool lost = state[position] == GEN_LOSS;
+
+                int count = predecessors(material, squares, side, found);
+                for (int i = 0; i < count; i++) {
+                    uint64_t previous = base + found[i];
+                    if (std::atomic_ref<uint8_t>(state[previous]).load(std::memory_order_relaxed) != GEN_UNKNOWN) continue;
+
+                    if (lost) {
+                        decide(previous, GEN_WIN, round);
+                    } else if (std::atomic_ref<uint8_t>(remaining[previous]).fetch_sub(1) == 1 && crossLoss[previous] <= round) {
+                        decide(previous, GEN_LOSS, round);
+                    }
+                }
+            }
+        }
+    }
+};
+
+void TbGen::setupBoard(Board &board, const TbMaterial &material, const int squares[], int side) {
+    std::fill(board.bitboards, board.bitboards + 16, 0ULL);
+    std::fill(board.boardArr, board.boardArr + 64, (int)NO_PIECE);
+    for (int i = 0; i < material.count; i++) {
+        board.bitboards[material.pieces[i]] |= 1ULL << squares[i];
+        board.boardArr[squares[i]] = material.pieces[i];
+    }
+    board.bitboards[WHITE_OCC] = board.bitboards[WP] | board.bitboards[WN] | board.bitboards[WB] | board.bitboards[WR] | board.bitboards[WQ] | board.bitboards[WK];
+    board.bitboards[BLACK_OCC] = board.bitboards[BP] | board.bitboards[BN] | board.bitboards[BB] | board.bitboards[BR] | board.bitboards[BQ] | board.bitboards[BK];
+    board.bitboards[ALL_OCC] = board.bitboards[WHITE_OCC] | board.bitboards[BLACK_OCC];
+
+    board.activeColour = side;
+    board.castlingRights = 0;
+    board.ep_target = NO_SQ;
+    board.halfMoves = 0;
+    board.fullMoves = 1;
+    board.hashKey = board.computeHash();
+}
+
+// runs work(begin, end) over every chunk of the positions on the pool
+template <typename Work>
+static void forChunks(ThreadPool &pool, uint64_t positions, Work work) {
+    for (uint64_t begin = 0; begin < positions; begin += TBGEN_CHUNK) {
+        uint64_t end = std::min(positions, begin + TBGEN_CHUNK);
+        pool.submit([&work, begin, end]() { work(begin, end); });
+    }
+    pool.wait();
+}
+
+// false if a capture or promotion needs a table that hasn't been generated
+static bool generate(TbGenTable &table, int threads) {
+    ThreadPool pool(threads);
+    forChunks(pool, table.positions, [&](uint64_t begin, uint64_t end) { table.initialise(begin, end); });
+    if (table.missing) return false;
+
+    for (int round = 1;; round++) {
+        bool frontier = std::any_of(table.frontier.begin(), table.frontier.end(), [](U64 word) { return word != 0; });
+        if (!frontier && round > table.maxCross) break;
+        if (round > GEN_MAX_ROUND) {
+            std::cerr << "distance to mate doesn't fit, stopped at " << GEN_MAX_ROUND << " plies" << std::endl;
+            break;
+        }
+
+        std::fill(table.next.begin(), table.next.end(), 0);
+        if (round <= table.maxCross) forChunks(pool, table.positions, [&](uint64_t begin, uint64_t end) { table.decideCross(begin, end, round); });
+        forChunks(pool, table.positions, [&](uint64_t begin, uint64_t end) { table.propagate(begin, end, round); });
+        std::swap(table.frontier, table.next);
+    }
+
+    for (uint8_t &state : table.state) {
+        if (state == GEN_UNKNOWN) state = GEN_DRAW;
+    }
+    return true;
+}
+
+struct TbGenCounts {
+    uint64_t wins = 0, draws = 0, losses = 0;
+    int maxDtm = 0;
+};
+
+// bit packed table in the layout Tablebase maps
+static bool writeTable(const TbGenTable &table, const std::string &path, TbGenCounts &counts) {
+    for (uint64_t position = 0; position < table.positions; position++) {
+        if (table.state[position] == GEN_WIN) counts.wins++;
+        else if (table.state[position] == GEN_LOSS) counts.losses++;
+        else if (table.state[position] == GEN_DRAW) counts.draws++;
+        if (table.state[position] == GEN_WIN || table.state[position] == GEN_LOSS) counts.maxDtm = std::max(counts.maxDtm, (int)table.dtm[position]);
+    }
+    int bits = 1;
+    while ((1 << bits) <= counts.maxDtm) bits++;
+
+    TbHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, TB_MAGIC, sizeof(header.magic));
+    std::string name = table.material.name();
+    std::memcpy(header.name, name.c_str(), std::min(name.size(), sizeof(header.name) - 1));
+    header.pieces = (uint32_t)table.material.count;
+    header.dtmBits = (uint32_t)bits;
+    header.size = table.material.size;
+    header.wdlOffset = sizeof(header);
+    header.dtmOffset = header.wdlOffset + (table.positions + 3) / 4;
+
+    std::vector<uint8_t> wdl((table.positions + 3) / 4, 0);
+    std::vector<uint8_t> dtm((table.positions * bits + 7) / 8 + 8, 0);
+    for (uint64_t position = 0; position < table.positions; position++) {
+        int result = TB_DRAW, plies = 0;
+        switch (table.state[position]) {
+            case GEN_WIN: result = TB_WIN; plies = table.dtm[position]; break;
+            case GEN_LOSS: result = TB_LOSS; plies = table.dtm[position]; break;
+            case GEN_INVALID: result = TB_INVALID; break;
+        }
+        wdl[position / 4] |= (uint8_t)(result << (2 * (position % 4)));
+
+        uint64_t bit = position * bits;
+        for (int i = 0; i < bits; i++, bit++) {
+            if ((plies >> i) & 1) dtm[bit / 8] |= (uint8_t)(1 << (bit % 8));
+        }
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(wdl.data()), wdl.size());
+    out.write(reinterpret_cast<const char*>(dtm.data()), dtm.size());
+    return (bool)out;
+}
+
+// order pieces are written in a name, from the strongest
+static const char sideLetters[] = "KQRBNP";
+
+// the stronger side (more pieces, then better pieces) comes first, Tablebase finds the other colours through it
+static std::string canonicalName(const std::string &first, const std::string &second) {
+    auto strength = [](const std::string &side) {
+        std::string ranks;
+        for (char c : side) ranks += (char)('0' + std::string_view(sideLetters).find(c));
+        return ranks;
+    };
+    bool swap = first.size() < second.size() || (first.size() == second.size() && strength(first) > strength(second));
+    return swap ? second + "v" + first : first + "v" + second;
+}
+
+// side of a name from counts of Q, R, B, N, P
+static std::string sideName(const int counts[5]) {
+    std::string side = "K";
+    for (int type = 0; type < 5; type++) side += std::string(counts[type], sideLetters[type + 1]);
+    return side;
+}
+
+// tables a capture or promotion of the material leads to (bare kings need none)
+static std::vector<std::string> dependencies(const TbMaterial &material) {
+    int counts[2][5] = {};
+    for (int i = 2; i < material.count; i++) {
+        int piece = material.pieces[i];
+        counts[piece < BP ? 0 : 1][std::string_view(sideLetters).find("PNBRQ"[piece % 6]) - 1]++;
+    }
+
+    std::vector<std::string> names;
+    for (int colour = 0; colour < 2; colour++) {
+        for (int type = 0; type < 5; type++) {
+            if (!counts[colour][type]) continue;
+
+            counts[colour][type]--;
+            if (material.count > 3) names.push_back(canonicalName(sideName(counts[0]), sideName(counts[1])));
+            if (type == 4) {
+                for (int promotion = 0; promotion < 4; promotion++) {
+                    counts[colour][promotion]++;
+                    names.push_back(canonicalName(sideName(counts[0]), sideName(counts[1])));
+                    counts[colour][promotion]--;
+                }
+            }
+            counts[colour][type]++;
+        }
+    }
+    return names;
+}
+
+// every side with a king and the given number (up to 2) of other pieces
+static std::vector<std::string> sidesWith(int pieces) {
+    std::vector<std::string> sides;
+    if (pieces == 0) sides.push_back("K");
+    for (int first = 1; first < 6; first++) {
+        if (pieces == 1) sides.push_back(std::string("K") + sideLetters[first]);
+        for (int second = first; second < 6 && pieces == 2; second++) {
+            sides.push_back(std::string("K") + sideLetters[first] + sideLetters[second]);
+        }
+    }
+    return sides;
+}
+
+// every material set with the given numbers of pieces
+static std::vector<std::string> allTables(int fewest, int most) {
+    std::vector<std::string> names;
+    for (int extra = fewest - 2; extra <= most - 2; extra++) {
+        for (int white = extra; white >= 0; white--) {
+            for (const std::string &first : sidesWith(white)) {
+                for (const std::string &second : sidesWith(extra - white)) names.push_back(canonicalName(first, second));
+            }
+        }
+    }
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    return names;
+}
+
+int TbGen::run(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "usage: nice.exe tbgen <directory> [tables all|3|4|KQvK,KRvK..] [threads N[,N..]]" << std::endl;
+        return 1;
+    }
+
+    std::string directory = argv[2];
+    std::string tableList = "all";
+    std::vector<int> threadCounts;
+
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string name = argv[i];
+        std::string value = argv[i + 1];
+
+        if (name == "tables") tableList = value;
+        else if (name == "threads") {
+            // several counts generate every table once per count to compare the times
+            std::stringstream counts(value);
+            for (std::string count; std::getline(counts, count, ',');) {
+                int threads = 1;
+                if (!parseOption(name, count, 1, 128, threads)) return 1;
+                threadCounts.push_back(threads);
+            }
+        } else {
+            std::cerr << "unknown option " << name << std::endl;
+        }
+    }
+    if (threadCounts.empty()) threadCounts.push_back((int)std::max(1u, std::thread::hardware_concurrency()));
+
+    std::vector<std::string> requested;
+    if (tableList == "all") requested = allTables(3, TBGEN_MAX_PIECES);
+    else if (tableList == "3" || tableList == "4") requested = allTables(tableList[0] - '0', tableList[0] - '0');
+    else {
+        std::stringstream names(tableList);
+        for (std::string name; std::getline(names, name, ',');) {
+            TbMaterial material;
+            if (!TbMaterial::parse(name, material) || material.count < 3 || material.count > TBGEN_MAX_PIECES) {
+                std::cerr << name << " isn't a material set of 3 to " << TBGEN_MAX_PIECES << " pieces" << std::endl;
+                return 1;
+            }
+            size_t separator = name.find('v');
+            requested.push_back(canonicalName(name.substr(0, separator), name.substr(separator + 1)));
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (!std::filesystem::is_directory(directory, error)) {
+        std::cerr << "could not create " << directory << std::endl;
+        return 1;
+    }
+    auto pathOf = [&](const std::string &name) { return (std::filesystem::path(directory) / (name + TB_EXTENSION)).string(); };
+
+    // tables the requested ones capture or promote into are generated first unless they are already there
+    std::vector<TbMaterial> queue;
+    std::vector<std::string> pending = requested;
+    std::vector<std::string> seen;
+    while (!pending.empty()) {
+        std::string name = pending.back();
+        pending.pop_back();
+        if (std::find(seen.begin(), seen.end(), name) != seen.end()) continue;
+        seen.push_back(name);
+
+        bool wanted = std::find(requested.begin(), requested.end(), name) != requested.end();
+        if (!wanted && std::filesystem::exists(pathOf(name), error)) continue;
+
+        TbMaterial material;
+        TbMaterial::parse(name, material);
+        queue.push_back(material);
+        for (const std::string &dependency : dependencies(material)) pending.push_back(dependency);
+    }
+
+    // fewer pieces first, then fewer pawns as a promotion keeps the piece count
+    auto pawnCount = [](const TbMaterial &material) { return (int)std::count_if(material.pieces, material.pieces + material.count, [](int piece) { return piece % 6 == WP; }); };
+    std::sort(queue.begin(), queue.end(), [&](const TbMaterial &a, const TbMaterial &b) {
+        if (a.count != b.count) return a.count < b.count;
+        if (pawnCount(a) != pawnCount(b)) return pawnCount(a) < pawnCount(b);
+        return a.name() < b.name();
+    });
+
+    uint64_t totalPositions = 0;
+    std::vector<double> totalSeconds(threadCounts.size(), 0.0);
+
+    for (const TbMaterial &material : queue) {
+        std::string name = material.name();
+        Tablebase::init(directory, true);
+
+        TbGenCounts counts;
+        std::cout << std::left << std::setw(8) << name << std::right << std::setw(10) << 2 * material.size << " positions" << std::flush;
+        for (size_t run = 0; run < threadCounts.size(); run++) {
+            auto start = std::chrono::steady_clock::now();
+
+            TbGenTable table(material);
+            if (!generate(table, threadCounts[run])) {
+                std::cout << std::endl;
+                std::cerr << "a table " << name << " captures or promotes into is missing from " << directory << std::endl;
+                return 1;
+            }
+            if (run + 1 == threadCounts.size() && !writeTable(table, pathOf(name), counts)) {
+                std::cout << std::endl;
+                std::cerr << "could not write " << pathOf(name) << std::endl;
+                return 1;
+            }
+
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            totalSeconds[run] += seconds;
+            std::cout << std::fixed << std::setprecision(2) << "  " << threadCounts[run] << (threadCounts[run] == 1 ? " thread " : " threads ")
+                      << seconds << " s" << std::setprecision(6) << std::defaultfloat << std::flush;
+        }
+        totalPositions += 2 * material.size;
+        std::cout << "  (W " << counts.wins << " D " << counts.draws << " L " << counts.losses << ", longest mate " << counts.maxDtm << " plies)" << std::endl;
+    }
+    Tablebase::init(directory, true);
+
+    std::cout << "===========================" << std::endl;
+    std::cout << "Tables          : " << queue.size() << " (" << totalPositions << " positions) in " << directory << std::endl;
+    for (size_t run = 0; run < threadCounts.size(); run++) {
+        std::cout << "Time (s)        : " << totalSeconds[run] << " with " << threadCounts[run] << (threadCounts[run] == 1 ? " thread (" : " threads (")
+                  << (uint64_t)(totalPositions / std::max(1e-9, totalSeconds[run])) << " positions/s)" << std::endl;
+    }
+    std::cout << "===========================" << std::endl;
+    return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef CHESS_TBGEN_HPP
+#define CHESS_TBGEN_HPP
+
+#include "Tablebase.hpp"
+
+class Board;
+
+// largest tables tbgen builds, every position of a 4 piece set fits in memory with a few bytes each
+#define TBGEN_MAX_PIECES 4
+
+// positions a worker takes at a time, a multiple of 64 so every bitmap word belongs to one worker
+#define TBGEN_CHUNK 65536
+
+/*
+retrograde generator for the tables Tablebase probes
+    every position of a table is set up once on a Board: illegal ones are dropped, mates and stalemates are
+    decided, captures and promotions are probed in the smaller tables (generated first) and the moves that
+    stay in the table are counted
+    the rounds then walk back from the positions decided in the previous round (a bitmap), un-moving the other
+    side: a lost position makes its predecessors won, a won one takes a move from their count and a predecessor
+    left without moves (nor a capture or promotion that holds) is lost
+    positions nothing decides are draws
+*/
+class TbGen {
+    public:
+        // ./engine tbgen <directory> [tables all|3|4|KQvK,KRvK..] [threads N[,N..]]
+        static int run(int argc, char* argv[]);
+
+    private:
+        // board of a table position, without castling rights or en passant square
+        static void setupBoard(Board &board, const TbMaterial &material, const int squares[], int side);
+
+        friend struct TbGenTable;
+};
+
+#endif
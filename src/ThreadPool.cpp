@@ -0,0 +1,98 @@
+#include "ThreadPool.hpp"
+
+// index of the pool worker running on this thread, -1 outside the pool
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local int currentWorker = -1;
+
+ThreadPool::ThreadPool(int threads) {
+    if (threads < 1) threads = 1;
+
+    for (int i = 0; i < threads; ++i) queues.push_back(std::make_unique<WorkerQueue>());
+    for (int i = 0; i < threads; ++i) workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (std::thread &worker : workers) worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    int index = (currentPool == this) ? currentWorker : nextQueue.fetch_add(1, std::memory_order_relaxed) % size();
+
+    pending.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+
+    // the lock makes sure a worker about to sleep sees the new task
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    workAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    allDone.wait(lock, [this] { return pending.load() == 0; });
+}
+
+// own queue from the back (depth first), then steal from the front of the others (largest subtrees)
+bool ThreadPool::popTask(int index, std::function<void()> &task) {
+    {
+        WorkerQueue &own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (int i = 1; i < size(); ++i) {
+        WorkerQueue &victim = *queues[(index + i) % size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::workerLoop(int index) {
+    currentPool = this;
+    currentWorker = index;
+
+    std::function<void()> task;
+    while (true) {
+        if (popTask(index, task)) {
+            task();
+            task = nullptr;
+
+            if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                allDone.notify_all();
+            }
+            continue;
+        }
+
+        // nothing to run or steal, sleep until a submit (rechecked under the lock so no wake up is lost)
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        if (stopping) return;
+        workAvailable.wait(lock, [&] {
+            if (stopping) return true;
+            for (auto &queue : queues) {
+                std::lock_guard<std::mutex> queueLock(queue->mutex);
+                if (!queue->tasks.empty()) return true;
+            }
+            return false;
+        });
+        if (stopping) return;
+    }
+}
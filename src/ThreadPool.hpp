@@ -0,0 +1,50 @@
+#ifndef CHESS_THREADPOOL_HPP
+#define CHESS_THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed size pool where every worker owns a task queue
+// a worker runs its newest task first and steals the oldest task of another worker when its own queue is empty,
+// so a task that submits its subtasks keeps them local until someone runs out of work
+class ThreadPool {
+    public:
+        explicit ThreadPool(int threads);
+        ~ThreadPool(); // finishes every submitted task before the workers stop
+
+        // tasks submitted by a worker go to its own queue, others are handed out round robin
+        void submit(std::function<void()> task);
+
+        // blocks until every submitted task (including tasks they submitted) has finished
+        void wait();
+
+        int size() const { return (int)workers.size(); }
+
+    private:
+        struct WorkerQueue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::vector<std::unique_ptr<WorkerQueue>> queues;
+        std::vector<std::thread> workers;
+
+        std::atomic<int> pending{0};    // submitted but not finished
+        std::atomic<int> nextQueue{0};  // round robin target for outside submits
+        bool stopping = false;
+
+        std::mutex sleepMutex;
+        std::condition_variable workAvailable;
+        std::condition_variable allDone;
+
+        bool popTask(int index, std::function<void()> &task);
+        void workerLoop(int index);
+};
+
+#endif
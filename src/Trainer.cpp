@@ -0,0 +1,383 @@
+#include "Trainer.hpp"
+#include "NNUE.hpp"
+#include "Types.hpp"
+#include "PackedReader.hpp"
+#include "Parse.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <memory>
+
+// centipawns for a network output of 1.0, also the scale of the score sigmoid
+#define EVAL_SCALE 400.0f
+
+// float parameters are stored in one flat array so Adam can run over all of them at once
+#define FT_WEIGHTS 0
+#define FT_BIAS (FT_WEIGHTS + NNUE_INPUTS * NNUE_HIDDEN)
+#define L1_WEIGHTS (FT_BIAS + NNUE_HIDDEN)
+#define L1_BIAS (L1_WEIGHTS + NNUE_L2 * 2 * NNUE_HIDDEN)
+#define OUT_WEIGHTS (L1_BIAS + NNUE_L2)
+#define OUT_BIAS (OUT_WEIGHTS + NNUE_L2)
+#define PARAM_COUNT (OUT_BIAS + 1)
+
+// largest weight the int8 layers can represent
+#define MAX_LAYER_WEIGHT (127.0f / NNUE_WEIGHT_SCALE)
+
+static float clampf(float v, float lo, float hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static float sigmoid(float x) {
+    return 1.0f / (1.0f + std::exp(-x));
+}
+
+TrainingSample Trainer::sampleFromBoard(const Board &board, int whiteScore, float whiteResult) {
+    TrainingSample sample{};
+    sample.sideToMove = (uint8_t)board.activeColour;
+
+    for (int square = 0; square < 64; ++square) {
+        int piece = board.boardArr[square];
+        if (piece == NO_PIECE || sample.pieceCount == 32) continue;
+
+        if (piece == WK) sample.kings[WHITE] = (uint8_t)square;
+        if (piece == BK) sample.kings[BLACK] = (uint8_t)square;
+
+        sample.pieces[sample.pieceCount] = (uint8_t)piece;
+        sample.squares[sample.pieceCount++] = (uint8_t)square;
+    }
+
+    // everything is stored from the side to move's point of view
+    bool white = board.activeColour == WHITE;
+    sample.score = (int16_t)clampf((float)(white ? whiteScore : -whiteScore), -32000.0f, 32000.0f);
+    sample.result = white ? whiteResult : 1.0f - whiteResult;
+
+    return sample;
+}
+
+static bool parseResult(std::string text, float &result) {
+    text.erase(std::remove_if(text.begin(), text.end(), [](char c) { return c == ' ' || c == '[' || c == ']' || c == '"'; }), text.end());
+
+    if (text == "1-0" || text == "1" || text == "1.0") result = 1.0f;
+    else if (text == "0-1" || text == "0" || text == "0.0") result = 0.0f;
+    else if (text == "1/2-1/2" || text == "0.5") result = 0.5f;
+    else return false;
+
+    return true;
+}
+
+bool Trainer::loadText(const std::string &path, std::vector<TrainingSample> &samples) {
+    std::ifstream in(path);
+    if (!in) return false;
+
+    std::string line;
+    size_t skipped = 0;
+
+    while (std::getline(in, line)) {
+        size_t first = line.find('|');
+        size_t second = (first == std::string::npos) ? first : line.find('|', first + 1);
+        if (second == std::string::npos) {
+            skipped++;
+            continue;
+        }
+
+        float result;
+        if (!parseResult(line.substr(second + 1), result)) {
+            skipped++;
+            continue;
+        }
+
+        Board board;
+        if (!board.setFen(std::string_view(line).substr(0, first))) {
+            skipped++;
+            continue;
+        }
+        samples.push_back(sampleFromBoard(board, std::atoi(line.c_str() + first + 1), result));
+    }
+
+    if (skipped > 0) std::cout << "skipped " << skipped << " malformed lines" << std::endl;
+    return true;
+}
+
+bool Trainer::loadPacked(const std::string &path, std::vector<TrainingSample> &samples) {
+    PackedReader reader;
+    if (!reader.open(path)) return false;
+
+    const float results[3] = {0.0f, 0.5f, 1.0f}; // indexed by PackedResult
+    Board board;
+    size_t skipped = 0, invalid = 0;
+    samples.reserve(samples.size() + reader.size());
+
+    for (size_t i = 0; i < reader.size(); i++) {
+        if (i % 65536 == 0) reader.prefetch(i + 65536, 65536);
+
+        const PackedPosition &packed = reader[i];
+        if (!packed.valid()) {
+            invalid++;
+            continue;
+        }
+        if (packed.result() == RESULT_UNKNOWN) {
+            skipped++;
+            continue;
+        }
+
+        packed.unpack(board);
+        samples.push_back(sampleFromBoard(board, packed.score, results[packed.result()]));
+    }
+
+    if (skipped > 0) std::cout << "skipped " << skipped << " positions without a result" << std::endl;
+    if (invalid > 0) std::cout << "skipped " << invalid << " invalid records" << std::endl;
+    return true;
+}
+
+// forward and backward pass for one sample, the forward pass uses the quantised weights (straight through estimator)
+static float accumulateGradient(const TrainingSample &sample, const float* q, float* grad, float lambda) {
+    int perspectives[2] = {sample.sideToMove, sample.sideToMove ^ 1};
+    int features[2][32];
+
+    float acc[2 * NNUE_HIDDEN];
+    float x[2 * NNUE_HIDDEN];
+
+    // feature transformer
+    for (int p = 0; p < 2; ++p) {
+        float* a = &acc[p * NNUE_HIDDEN];
+        for (int j = 0; j < NNUE_HIDDEN; ++j) a[j] = q[FT_BIAS + j];
+
+        for (int i = 0; i < sample.pieceCount; ++i) {
+            int perspective = perspectives[p];
+            features[p][i] = NNUE::featureIndex(perspective, sample.kings[perspective], sample.pieces[i], sample.squares[i]);
+
+            const float* row = &q[FT_WEIGHTS + features[p][i] * NNUE_HIDDEN];
+            for (int j = 0; j < NNUE_HIDDEN; ++j) a[j] += row[j];
+        }
+    }
+    for (int i = 0; i < 2 * NNUE_HIDDEN; ++i) x[i] = clampf(acc[i], 0.0f, 1.0f);
+
+    // hidden layer
+    float z[NNUE_L2], h[NNUE_L2];
+    for (int k = 0; k < NNUE_L2; ++k) {
+        const float* w = &q[L1_WEIGHTS + k * 2 * NNUE_HIDDEN];
+        float sum = q[L1_BIAS + k];
+        for (int i = 0; i < 2 * NNUE_HIDDEN; ++i) sum += w[i] * x[i];
+        z[k] = sum;
+        h[k] = clampf(sum, 0.0f, 1.0f);
+    }
+
+    // output
+    float y = q[OUT_BIAS];
+    for (int k = 0; k < NNUE_L2; ++k) y += q[OUT_WEIGHTS + k] * h[k];
+
+    // loss against a blend of the score and the game result in win probability space
+    float target = lambda * sigmoid(sample.score / EVAL_SCALE) + (1.0f - lambda) * sample.result;
+    float prediction = sigmoid(y);
+    float error = prediction - target;
+
+    // backward
+    float dy = 2.0f * error * prediction * (1.0f - prediction);
+
+    grad[OUT_BIAS] += dy;
+
+    float dx[2 * NNUE_HIDDEN] = {};
+    for (int k = 0; k < NNUE_L2; ++k) {
+        grad[OUT_WEIGHTS + k] += dy * h[k];
+
+        if (z[k] <= 0.0f || z[k] >= 1.0f) continue; // clipped, no gradient
+        float dz = dy * q[OUT_WEIGHTS + k];
+
+        grad[L1_BIAS + k] += dz;
+        const float* w = &q[L1_WEIGHTS + k * 2 * NNUE_HIDDEN];
+        float* gw = &grad[L1_WEIGHTS + k * 2 * NNUE_HIDDEN];
+        for (int i = 0; i < 2 * NNUE_HIDDEN; ++i) {
+            gw[i] += dz * x[i];
+            dx[i] += dz * w[i];
+        }
+    }
+
+    for (int p = 0; p < 2; ++p) {
+        float da[NNUE_HIDDEN];
+        for (int j = 0; j < NNUE_HIDDEN; ++j) {
+            float a = acc[p * NNUE_HIDDEN + j];
+            da[j] = (a > 0.0f && a < 1.0f) ? dx[p * NNUE_HIDDEN + j] : 0.0f;
+            grad[FT_BIAS + j] += da[j];
+        }
+
+        for (int i = 0; i < sample.pieceCount; ++i) {
+            float* row = &grad[FT_WEIGHTS + features[p][i] * NNUE_HIDDEN];
+            for (int j = 0; j < NNUE_HIDDEN; ++j) row[j] += da[j];
+        }
+    }
+
+    return error * error;
+}
+
+// rounds every weight to the grid of its integer type, this is what the engine will see
+static void quantise(const std::vector<float> &params, std::vector<float> &q) {
+    for (int i = 0; i < PARAM_COUNT; ++i) {
+        if (i < L1_WEIGHTS) {
+            q[i] = std::round(params[i] * NNUE_ACTIVATION_SCALE) / NNUE_ACTIVATION_SCALE;
+        } else if ((i >= L1_WEIGHTS && i < L1_BIAS) || (i >= OUT_WEIGHTS && i < OUT_BIAS)) {
+            q[i] = std::round(params[i] * NNUE_WEIGHT_SCALE) / NNUE_WEIGHT_SCALE;
+        } else {
+            q[i] = params[i]; // int32 biases, the rounding error is negligible
+        }
+    }
+}
+
+static void exportNetwork(const std::vector<float> &params, NetworkWeights &weights) {
+    auto toInt16 = [](float v) { return (int16_t)clampf(std::round(v * NNUE_ACTIVATION_SCALE), -32767.0f, 32767.0f); };
+    auto toInt8 = [](float v) { return (int8_t)clampf(std::round(v * NNUE_WEIGHT_SCALE), -127.0f, 127.0f); };
+    auto toInt32 = [](float v) { return (int32_t)std::round(v * NNUE_ACTIVATION_SCALE * NNUE_WEIGHT_SCALE); };
+
+    for (int i = 0; i < NNUE_INPUTS * NNUE_HIDDEN; ++i) weights.featureWeights[i] = toInt16(params[FT_WEIGHTS + i]);
+    for (int i = 0; i < NNUE_HIDDEN; ++i) weights.featureBias[i] = toInt16(params[FT_BIAS + i]);
+    for (int i = 0; i < NNUE_L2 * 2 * NNUE_HIDDEN; ++i) weights.hiddenWeights[i] = toInt8(params[L1_WEIGHTS + i]);
+    for (int i = 0; i < NNUE_L2; ++i) weights.hiddenBias[i] = toInt32(params[L1_BIAS + i]);
+    for (int i = 0; i < NNUE_L2; ++i) weights.outputWeights[i] = toInt8(params[OUT_WEIGHTS + i]);
+    weights.outputBias = toInt32(params[OUT_BIAS]);
+    weights.outputScale = (int32_t)EVAL_SCALE;
+}
+
+bool Trainer::train(const std::vector<TrainingSample> &samples, const TrainerOptions &options) {
+    if (samples.empty()) return false;
+
+    int threads = options.threads > 0 ? options.threads : (int)std::max(1u, std::thread::hardware_concurrency());
+    std::mt19937 rng(options.seed);
+
+    // initialisation scaled by fan in, the feature transformer sees about 32 active inputs
+    std::vector<float> params(PARAM_COUNT, 0.0f);
+    std::normal_distribution<float> ftInit(0.0f, 1.0f / std::sqrt(32.0f) * 0.5f);
+    std::normal_distribution<float> l1Init(0.0f, 1.0f / std::sqrt((float)(2 * NNUE_HIDDEN)));
+    std::normal_distribution<float> outInit(0.0f, 1.0f / std::sqrt((float)NNUE_L2));
+
+    for (int i = FT_WEIGHTS; i < FT_BIAS; ++i) params[i] = ftInit(rng);
+    for (int i = FT_BIAS; i < L1_WEIGHTS; ++i) params[i] = 0.5f;
+    for (int i = L1_WEIGHTS; i < L1_BIAS; ++i) params[i] = l1Init(rng);
+    for (int i = OUT_WEIGHTS; i < OUT_BIAS; ++i) params[i] = outInit(rng);
+
+    std::vector<float> q(PARAM_COUNT), m(PARAM_COUNT, 0.0f), v(PARAM_COUNT, 0.0f);
+    std::vector<std::vector<float>> grads(threads, std::vector<float>(PARAM_COUNT));
+    std::vector<double> losses(threads);
+
+    std::vector<size_t> order(samples.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+
+    const float beta1 = 0.9f, beta2 = 0.999f, epsilon = 1e-8f;
+    int step = 0;
+
+    std::cout << "training on " << samples.size() << " positions with " << threads << " threads" << std::endl;
+
+    for (int epoch = 1; epoch <= options.epochs; ++epoch) {
+        auto start = std::chrono::steady_clock::now();
+        std::shuffle(order.begin(), order.end(), rng);
+        double epochLoss = 0.0;
+
+        for (size_t batchStart = 0; batchStart < order.size(); batchStart += options.batchSize) {
+            size_t batchEnd = std::min(order.size(), batchStart + (size_t)options.batchSize);
+            quantise(params, q);
+
+            // each thread sums the gradient of its slice of the batch into its own buffer
+            auto work = [&](int t) {
+                std::vector<float> &grad = grads[t];
+                std::fill(grad.begin(), grad.end(), 0.0f);
+                double loss = 0.0;
+
+                size_t count = batchEnd - batchStart;
+                size_t from = batchStart + count * t / threads;
+                size_t to = batchStart + count * (t + 1) / threads;
+                for (size_t i = from; i < to; ++i) {
+                    loss += accumulateGradient(samples[order[i]], q.data(), grad.data(), options.lambda);
+                }
+                losses[t] = loss;
+            };
+
+            std::vector<std::thread> pool;
+            for (int t = 1; t < threads; ++t) pool.emplace_back(work, t);
+            work(0);
+            for (std::thread &thread : pool) thread.join();
+
+            for (int t = 1; t < threads; ++t) {
+                for (int i = 0; i < PARAM_COUNT; ++i) grads[0][i] += grads[t][i];
+            }
+            for (int t = 0; t < threads; ++t) epochLoss += losses[t];
+
+            // adam step on the mean gradient
+            step++;
+            float scale = 1.0f / (float)(batchEnd - batchStart);
+            float correction1 = 1.0f - std::pow(beta1, (float)step);
+            float correction2 = 1.0f - std::pow(beta2, (float)step);
+
+            for (int i = 0; i < PARAM_COUNT; ++i) {
+                float g = grads[0][i] * scale;
+                m[i] = beta1 * m[i] + (1.0f - beta1) * g;
+                v[i] = beta2 * v[i] + (1.0f - beta2) * g * g;
+                params[i] -= options.learningRate * (m[i] / correction1) / (std::sqrt(v[i] / correction2) + epsilon);
+            }
+
+            // keep the int8 layers inside their representable range
+            for (int i = L1_WEIGHTS; i < L1_BIAS; ++i) params[i] = clampf(params[i], -MAX_LAYER_WEIGHT, MAX_LAYER_WEIGHT);
+            for (int i = OUT_WEIGHTS; i < OUT_BIAS; ++i) params[i] = clampf(params[i], -MAX_LAYER_WEIGHT, MAX_LAYER_WEIGHT);
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "epoch " << epoch
+                  << " loss " << epochLoss / samples.size()
+                  << " time " << seconds << "s"
+                  << " pos/s " << (size_t)(samples.size() / std::max(seconds, 1e-9))
+                  << std::endl;
+    }
+
+    auto weights = std::make_unique<NetworkWeights>();
+    exportNetwork(params, *weights);
+    return NNUE::save(options.outputPath, *weights);
+}
+
+int Trainer::run(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "usage: nice.exe train <data> [output] [epochs N] [batch N] [lr X] [lambda X] [threads N] [seed N]" << std::endl;
+        return 1;
+    }
+
+    TrainerOptions options;
+    options.dataPath = argv[2];
+
+    // options come in name value pairs, so an even argument count means an output path was given
+    int i = 3;
+    if (argc % 2 == 0) options.outputPath = argv[i++];
+
+    for (; i + 1 < argc; i += 2) {
+        std::string name = argv[i];
+        std::string value = argv[i + 1];
+
+        bool valid = true;
+        if (name == "epochs") valid = parseOption(name, value, 0, 1000000, options.epochs);
+        else if (name == "batch") valid = parseOption(name, value, 1, 1 << 24, options.batchSize);
+        else if (name == "lr") valid = parseOption(name, value, 0.0f, 1.0f, options.learningRate);
+        else if (name == "lambda") valid = parseOption(name, value, 0.0f, 1.0f, options.lambda);
+        else if (name == "threads") valid = parseOption(name, value, 0, 128, options.threads);
+        else if (name == "seed") valid = parseOption(name, value, (uint32_t)0, UINT32_MAX, options.seed);
+        else std::cout << "unknown option " << name << std::endl;
+        if (!valid) return 1;
+    }
+
+    std::vector<TrainingSample> samples;
+    auto start = std::chrono::steady_clock::now();
+    bool loaded = PackedReader::isPackedPath(options.dataPath) ? loadPacked(options.dataPath, samples) : loadText(options.dataPath, samples);
+    if (!loaded) {
+        std::cout << "could not read " << options.dataPath << std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "loaded " << samples.size() << " positions in " << seconds << "s" << std::endl;
+
+    if (!train(samples, options)) {
+        std::cout << "training failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "saved network to " << options.outputPath << std::endl;
+    return 0;
+}
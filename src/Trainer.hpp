@@ -0,0 +1,48 @@
+#ifndef CHESS_TRAINER_HPP
+#define CHESS_TRAINER_HPP
+
+#include "Board.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// one training position, pieces are stored as a list so features can be built for either perspective
+struct TrainingSample {
+    uint8_t pieceCount;
+    uint8_t sideToMove;
+    uint8_t kings[2];    // white and black king squares
+    uint8_t pieces[32];
+    uint8_t squares[32];
+    int16_t score;       // centipawns, side to move
+    float result;        // 1 win, 0.5 draw, 0 loss for the side to move
+};
+
+struct TrainerOptions {
+    std::string dataPath;
+    std::string outputPath = "nice.nnue";
+    int epochs = 10;
+    int batchSize = 16384;
+    int threads = 0;         // 0 = all cores
+    float learningRate = 0.001f;
+    float lambda = 0.75f;    // weight of the search score against the game result
+    uint32_t seed = 1;
+};
+
+class Trainer {
+    public:
+        // entry point for "nice.exe train <data> [output] [option value]..."
+        static int run(int argc, char* argv[]);
+
+        // reads "fen | score | result" lines, score in centipawns and result for white (1, 0.5, 0 or 1-0 style)
+        static bool loadText(const std::string &path, std::vector<TrainingSample> &samples);
+
+        // reads a .bin file of PackedPosition records, records without a result are skipped
+        static bool loadPacked(const std::string &path, std::vector<TrainingSample> &samples);
+
+        static TrainingSample sampleFromBoard(const Board &board, int whiteScore, float whiteResult);
+
+        // trains a network and writes it in the format NNUE::load reads
+        static bool train(const std::vector<TrainingSample> &samples, const TrainerOptions &options);
+};
+
+#endif
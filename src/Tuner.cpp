@@ -0,0 +1,398 @@
+#include "Tuner.hpp"
+#include "PackedReader.hpp"
+#include "Board.hpp"
+#include "Evaluation.hpp"
+#include "Search.hpp"
+#include "Types.hpp"
+#include "Parse.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cmath>
+
+// one block of parameters in EvalParams.hpp
+struct ParamBlock {
+    const char* name;
+    const char* comment;
+    const int* values;
+    int size;            // 1 for scalars
+};
+
+// order must match traceFields below
+static const ParamBlock paramBlocks[] = {
+    {"pieceValues", "// values in order pawn, knight, bishop, rook, queen, king\n// standard piece values times 100 with a bishop weighinh slightly better than kight", pieceValues, 6},
+    {"pawnTable", "// bonus points for pawn positions", pawnTable, 64},
+    {"knightTable", "// bonus points for knight positions", knightTable, 64},
+    {"bishopTable", "// bonus points for bishop positions", bishopTable, 64},
+    {"rookTable", "// bonus points for rook positions", rookTable, 64},
+    {"queenTable", "// bonus points for queen positions", queenTable, 64},
+    {"kingTable", "// bonus points for king positions", kingTable, 64},
+    {"kingEndgameTable", "// bonus points for king positions once the enemy queen is gone", kingEndgameTable, 64},
+    {"doubledPawnPenalty", "// pawn structure terms\n// for every extra pawn on a file", &doubledPawnPenalty, 1},
+    {"isolatedPawnPenalty", "// pawn with no friendly pawns on the neighbouring files", &isolatedPawnPenalty, 1},
+    {"passedPawnBonus", "// indexed by relative rank", passedPawnBonus, 8},
+    {"mobilityWeights", "// mobility points per reachable square in order pawn, knight, bishop, rook, queen, king", mobilityWeights, 6},
+    {"kingAttackWeight", "// king safety terms\n// per attack on a square next to the enemy king", &kingAttackWeight, 1},
+    {"pawnShieldBonus", "// per pawn directly in front of the king", &pawnShieldBonus, 1},
+};
+
+static const int paramBlockCount = sizeof(paramBlocks) / sizeof(paramBlocks[0]);
+
+static void traceFields(const EvalTrace &t, const int* fields[]) {
+    const int* list[] = {
+        t.pieceValues, t.pawnTable, t.knightTable, t.bishopTable, t.rookTable, t.queenTable,
+        t.kingTable, t.kingEndgameTable, &t.doubledPawnPenalty, &t.isolatedPawnPenalty,
+        t.passedPawnBonus, t.mobilityWeights, &t.kingAttackWeight, &t.pawnShieldBonus,
+    };
+    for (int i = 0; i < paramBlockCount; ++i) fields[i] = list[i];
+}
+
+static int threadCount(int requested) {
+    return requested > 0 ? requested : (int)std::max(1u, std::thread::hardware_concurrency());
+}
+
+// runs work(thread, from, to) over [0, count) split evenly between threads
+template <typename F>
+static void parallelFor(size_t count, int threads, F work) {
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) {
+        pool.emplace_back(work, t, count * t / threads, count * (t + 1) / threads);
+    }
+    work(0, 0, count / threads);
+    for (std::thread &thread : pool) thread.join();
+}
+
+// accepts "fen [1.0]", "fen; c9 \"1-0\";", "fen | score | 1-0" and "fen 1/2-1/2" style lines
+static bool parseLine(const std::string &line, std::string &fen, float &result) {
+    std::string resultText;
+    size_t bar = line.find('|');
+
+    if (bar != std::string::npos) {
+        fen = line.substr(0, bar);
+        resultText = line.substr(line.rfind('|') + 1);
+    } else {
+        size_t bracket = line.find('[');
+        size_t c9 = line.find("c9");
+        std::istringstream ss(line);
+        std::string token;
+
+        // board, side, castling and en passant are always there, the clocks are optional
+        for (int i = 0; i < 4 && ss >> token; ++i) fen += token + " ";
+
+        if (bracket != std::string::npos) {
+            resultText = line.substr(bracket + 1, line.find(']', bracket) - bracket - 1);
+        } else if (c9 != std::string::npos) {
+            resultText = line.substr(c9 + 2);
+        } else {
+            while (ss >> token) resultText = token;
+        }
+    }
+
+    resultText.erase(std::remove_if(resultText.begin(), resultText.end(), [](char c) { return c == ' ' || c == '"' || c == ';'; }), resultText.end());
+
+    if (resultText == "1-0" || resultText == "1.0" || resultText == "1") result = 1.0f;
+    else if (resultText == "0-1" || resultText == "0.0" || resultText == "0") result = 0.0f;
+    else if (resultText == "1/2-1/2" || resultText == "0.5") result = 0.5f;
+    else return false;
+
+    return true;
+}
+
+// reads the file, quiets every position and keeps only its non zero coefficients
+bool Tuner::loadData(const TunerOptions &options, TunerData &data) {
+    // .bin files are used in place, text is read into memory first
+    bool packed = PackedReader::isPackedPath(options.dataPath);
+    PackedReader reader;
+    std::vector<std::string> lines;
+
+    if (packed) {
+        if (!reader.open(options.dataPath)) return false;
+    } else {
+        std::ifstream in(options.dataPath);
+        if (!in) return false;
+
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty()) lines.push_back(line);
+        }
+    }
+    size_t count = packed ? reader.size() : lines.size();
+
+    int threads = threadCount(options.threads);
+    std::vector<TunerData> parts(threads);
+    std::vector<size_t> mismatches(threads, 0);
+    std::vector<size_t> invalid(threads, 0);
+
+    parallelFor(count, threads, [&](int t, size_t from, size_t to) {
+        TunerData &part = parts[t];
+        EvalTrace trace;
+        const int* fields[paramBlockCount];
+
+        for (size_t i = from; i < to; ++i) {
+            Board root;
+            float result;
+
+            if (packed) {
+                if (!reader[i].valid()) {
+                    invalid[t]++;
+                    continue;
+                }
+                if (reader[i].result() == RESULT_UNKNOWN) continue;
+                reader[i].unpack(root);
+                result = reader[i].result() * 0.5f; // PackedResult counts half points for white
+            } else {
+                std::string fen;
+                if (!parseLine(lines[i], fen, result) || !root.setFen(fen)) continue;
+            }
+
+            Board leaf = Search::quietPosition(root);
+            Evaluation::trace(leaf, trace);
+            traceFields(trace, fields);
+
+            TunerPosition position{(uint32_t)part.indices.size(), 0, result};
+            int index = 0;
+            long long linearEval = 0;
+
+            for (int b = 0; b < paramBlockCount; ++b) {
+                for (int j = 0; j < paramBlocks[b].size; ++j, ++index) {
+                    int coefficient = fields[b][j];
+                    if (coefficient == 0) continue;
+
+                    part.indices.push_back((uint16_t)index);
+                    part.coefficients.push_back((int16_t)coefficient);
+                    position.coefficientCount++;
+                    linearEval += (long long)coefficient * paramBlocks[b].values[j];
+                }
+            }
+
+            // the linear model has to agree with the real evaluation or the tuned values are meaningless
+            int eval = Evaluation::evaluate(leaf);
+            if ((leaf.activeColour == WHITE ? eval : -eval) != linearEval) mismatches[t]++;
+
+            part.positions.push_back(position);
+        }
+    });
+
+    // stitch the per thread parts together
+    for (TunerData &part : parts) {
+        uint32_t offset = (uint32_t)data.indices.size();
+        for (TunerPosition position : part.positions) {
+            position.firstCoefficient += offset;
+            data.positions.push_back(position);
+        }
+        data.indices.insert(data.indices.end(), part.indices.begin(), part.indices.end());
+        data.coefficients.insert(data.coefficients.end(), part.coefficients.begin(), part.coefficients.end());
+    }
+
+    size_t totalInvalid = 0;
+    for (size_t n : invalid) totalInvalid += n;
+    if (totalInvalid > 0) std::cout << "skipped " << totalInvalid << " invalid records" << std::endl;
+
+    size_t totalMismatches = 0;
+    for (size_t m : mismatches) totalMismatches += m;
+    if (totalMismatches > 0) {
+        std::cout << "warning: linear model disagrees with the evaluation on " << totalMismatches << " positions" << std::endl;
+    }
+
+    return true;
+}
+
+static double sigmoid(double k, double eval) {
+    return 1.0 / (1.0 + std::exp(-k * eval / 400.0));
+}
+
+static double linearEval(const TunerData &data, const TunerPosition &position, const std::vector<double> &params) {
+    double eval = 0.0;
+    for (uint32_t i = position.firstCoefficient; i < position.firstCoefficient + position.coefficientCount; ++i) {
+        eval += data.coefficients[i] * params[data.indices[i]];
+    }
+    return eval;
+}
+
+// mean squared error between the predicted win probability and the game result
+static double computeLoss(const TunerData &data, const std::vector<double> &params, double k, int threads) {
+    std::vector<double> partial(threads, 0.0);
+
+    parallelFor(data.positions.size(), threads, [&](int t, size_t from, size_t to) {
+        double sum = 0.0;
+        for (size_t i = from; i < to; ++i) {
+            double error = data.positions[i].result - sigmoid(k, linearEval(data, data.positions[i], params));
+            sum += error * error;
+        }
+        partial[t] = sum;
+    });
+
+    double total = 0.0;
+    for (double p : partial) total += p;
+    return total / data.positions.size();
+}
+
+// gradient of the loss, every thread sums into its own vector
+static double computeGradient(const TunerData &data, const std::vector<double> &params, double k, int threads, std::vector<double> &gradient) {
+    std::vector<std::vector<double>> partial(threads, std::vector<double>(params.size(), 0.0));
+    std::vector<double> losses(threads, 0.0);
+
+    parallelFor(data.positions.size(), threads, [&](int t, size_t from, size_t to) {
+        std::vector<double> &grad = partial[t];
+        double loss = 0.0;
+
+        for (size_t i = from; i < to; ++i) {
+            const TunerPosition &position = data.positions[i];
+            double s = sigmoid(k, linearEval(data, position, params));
+            double error = s - position.result;
+            loss += error * error;
+
+            // d/d param of (s - r)^2 = 2 (s - r) s (1 - s) k / 400 * coefficient
+            double factor = 2.0 * error * s * (1.0 - s) * k / 400.0;
+            for (uint32_t c = position.firstCoefficient; c < position.firstCoefficient + position.coefficientCount; ++c) {
+                grad[data.indices[c]] += factor * data.coefficients[c];
+            }
+        }
+        losses[t] = loss;
+    });
+
+    std::fill(gradient.begin(), gradient.end(), 0.0);
+    double loss = 0.0;
+    for (int t = 0; t < threads; ++t) {
+        for (size_t i = 0; i < gradient.size(); ++i) gradient[i] += partial[t][i] / data.positions.size();
+        loss += losses[t];
+    }
+    return loss / data.positions.size();
+}
+
+// golden section search for the sigmoid scale that best fits the current parameters
+static double fitK(const TunerData &data, const std::vector<double> &params, int threads) {
+    double lo = 0.1, hi = 5.0;
+    const double ratio = 0.6180339887;
+
+    for (int i = 0; i < 40; ++i) {
+        double a = hi - ratio * (hi - lo);
+        double b = lo + ratio * (hi - lo);
+        if (computeLoss(data, params, a, threads) < computeLoss(data, params, b, threads)) hi = b;
+        else lo = a;
+    }
+    return (lo + hi) / 2.0;
+}
+
+// writes the parameters back out in the layout of EvalParams.hpp
+static bool writeHeader(const std::string &path, const std::vector<double> &params) {
+    std::ofstream out(path);
+    if (!out) return false;
+
+    out << "#ifndef CHESS_EVALPARAMS_HPP\n";
+    out << "#define CHESS_EVALPARAMS_HPP\n\n";
+    out << "// parameters of the hand written evaluation, regenerate with: nice.exe tune <data> src/EvalParams.hpp\n";
+
+    int index = 0;
+    for (int b = 0; b < paramBlockCount; ++b) {
+        const ParamBlock &block = paramBlocks[b];
+        out << "\n" << block.comment << "\n";
+
+        if (block.size == 1) {
+            out << "constexpr int " << block.name << " = " << (int)std::lround(params[index++]) << ";\n";
+        } else if (block.size == 64) {
+            out << "constexpr int " << block.name << "[] = {\n";
+            for (int rank = 0; rank < 8; ++rank) {
+                out << "    ";
+                for (int file = 0; file < 8; ++file) {
+                    out << std::setw(3) << (int)std::lround(params[index++]) << (file < 7 ? "," : ",\n");
+                }
+            }
+            out << "};\n";
+        } else {
+            out << "constexpr int " << block.name << "[] = {";
+            for (int j = 0; j < block.size; ++j) {
+                out << (int)std::lround(params[index++]) << (j + 1 < block.size ? ", " : "");
+            }
+            out << "};\n";
+        }
+    }
+
+    out << "\n#endif\n";
+    return (bool)out;
+}
+
+int Tuner::run(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "usage: nice.exe tune <data> [output header] [epochs N] [lr X] [k X] [threads N]" << std::endl;
+        return 1;
+    }
+
+    TunerOptions options;
+    options.dataPath = argv[2];
+
+    // options come in name value pairs, so an even argument count means an output path was given
+    int i = 3;
+    if (argc % 2 == 0) options.outputPath = argv[i++];
+
+    for (; i + 1 < argc; i += 2) {
+        std::string name = argv[i];
+        std::string value = argv[i + 1];
+
+        bool valid = true;
+        if (name == "epochs") valid = parseOption(name, value, 0, 1000000, options.epochs);
+        else if (name == "lr") valid = parseOption(name, value, 0.0, 1000.0, options.learningRate);
+        else if (name == "k") valid = parseOption(name, value, 0.0, 100.0, options.k);
+        else if (name == "threads") valid = parseOption(name, value, 0, 128, options.threads);
+        else std::cout << "unknown option " << name << std::endl;
+        if (!valid) return 1;
+    }
+
+    int threads = threadCount(options.threads);
+
+    // start from the current values
+    std::vector<double> params;
+    for (int b = 0; b < paramBlockCount; ++b) {
+        for (int j = 0; j < paramBlocks[b].size; ++j) params.push_back(paramBlocks[b].values[j]);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    TunerData data;
+    if (!loadData(options, data)) {
+        std::cout << "could not read " << options.dataPath << std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "loaded " << data.positions.size() << " positions (" << data.coefficients.size() << " coefficients) in "
+              << seconds << "s with " << threads << " threads" << std::endl;
+
+    if (data.positions.empty()) return 1;
+
+    double k = (options.k > 0.0) ? options.k : fitK(data, params, threads);
+    std::cout << "k " << k << " initial loss " << computeLoss(data, params, k, threads) << std::endl;
+
+    // adam, the learning rate is in centipawns per step
+    std::vector<double> gradient(params.size()), m(params.size(), 0.0), v(params.size(), 0.0);
+    const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+
+    start = std::chrono::steady_clock::now();
+    for (int epoch = 1; epoch <= options.epochs; ++epoch) {
+        double loss = computeGradient(data, params, k, threads, gradient);
+
+        double correction1 = 1.0 - std::pow(beta1, epoch);
+        double correction2 = 1.0 - std::pow(beta2, epoch);
+        for (size_t p = 0; p < params.size(); ++p) {
+            m[p] = beta1 * m[p] + (1.0 - beta1) * gradient[p];
+            v[p] = beta2 * v[p] + (1.0 - beta2) * gradient[p] * gradient[p];
+            params[p] -= options.learningRate * (m[p] / correction1) / (std::sqrt(v[p] / correction2) + epsilon);
+        }
+
+        if (epoch % 50 == 0 || epoch == options.epochs) {
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "epoch " << epoch << " loss " << loss << " " << elapsed / epoch << "s/epoch" << std::endl;
+        }
+    }
+
+    if (!writeHeader(options.outputPath, params)) {
+        std::cout << "could not write " << options.outputPath << std::endl;
+        return 1;
+    }
+
+    std::cout << "wrote " << options.outputPath << std::endl;
+    return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef CHESS_TUNER_HPP
+#define CHESS_TUNER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// a tuning position reduced to the coefficients of the parameters it uses
+struct TunerPosition {
+    uint32_t firstCoefficient; // index into the shared coefficient arrays
+    uint16_t coefficientCount;
+    float result;              // 1 white win, 0.5 draw, 0 black win
+};
+
+// the preloaded data set, coefficients of all positions are stored back to back
+struct TunerData {
+    std::vector<TunerPosition> positions;
+    std::vector<uint16_t> indices;
+    std::vector<int16_t> coefficients;
+};
+
+struct TunerOptions {
+    std::string dataPath;
+    std::string outputPath = "src/EvalParams.hpp";
+    int epochs = 500;
+    int threads = 0;            // 0 = all cores
+    double learningRate = 1.0;
+    double k = 0.0;             // sigmoid scale, 0 = fit it before tuning
+};
+
+class Tuner {
+    public:
+        // entry point for "nice.exe tune <data> [output] [option value]..."
+        static int run(int argc, char* argv[]);
+
+    private:
+        // reads the file (text or .bin records), quiets every position and keeps only its non zero coefficients
+        static bool loadData(const TunerOptions &options, TunerData &data);
+};
+
+#endif
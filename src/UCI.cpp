@@ -4,12 +4,23 @@
 #include <vector>
 #include <random>
 #include <chrono>
+#include <algorithm>
+#include <string_view>
 
 #include "UCI.hpp"
 #include "MoveGen.hpp"
 #include "Move.hpp"
 #include "Board.hpp"
 #include "Search.hpp"
+#include "Evaluation.hpp"
+#include "NNUE.hpp"
+#include "Perft.hpp"
+#include "Bench.hpp"
+#include "Profile.hpp"
+#include "Book.hpp"
+#include "Tablebase.hpp"
+#include "Syzygy.hpp"
+#include "Parse.hpp"
 
 // converts engine moves into uci strings
 std::string moveToString(Move m, Board &board){
@@ -29,22 +40,116 @@ std::string moveToString(Move m, Board &board){
     return result;
 }
 
-// find the move that corresponses to uci input
-Move parseMove(std::string moveString, Board &board){
-    std::vector<Move> moves = MoveGen::generateLegalMoves(board);
+// square index of a coordinate like "e4", -1 if it isn't one
+static int parseSquare(char file, char rank){
+    if (file < 'a' || file > 'h' || rank < '1' || rank > '8') return -1;
+    return (rank - '1') * 8 + (file - 'a');
+}
+
+// find the move that corresponses to uci input, only the matching move is checked for legality
+Move parseMove(std::string_view moveString, const Board &board){
+    if (moveString.size() != 4 && moveString.size() != 5) return 0;
+
+    int from = parseSquare(moveString[0], moveString[1]);
+    int to = parseSquare(moveString[2], moveString[3]);
+    if (from < 0 || to < 0) return 0;
+
+    char promotion = (moveString.size() == 5) ? moveString[4] : 0;
 
-    for(const Move& m: moves){
-        if (moveToString(m, board) == moveString){
-            return m;
+    for (const Move& m: MoveGen::generateMoves(board)){
+        if (fromSq(m) != from || toSq(m) != to) continue;
+
+        if (moveFlags(m) & PROMOTION) {
+            // piece codes repeat every 6 (pawn, knight, bishop, rook, queen, king) for both colours
+            if ("pnbrqk"[promo(m) % 6] != promotion) continue;
+        } else if (promotion) {
+            continue;
         }
+
+        return MoveGen::isLegal(board, m) ? m : 0;
     }
 
     return 0;
 }
 
+Move parseSan(std::string_view san, const Board &board){
+    // check, mate and annotation marks don't change the move
+    while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?')) {
+        san.remove_suffix(1);
+    }
+    if (san.empty()) return 0;
+
+    // pseudo legal moves, only the ones matching the san are checked for legality (pgn decoding calls this every ply)
+    std::vector<Move> moves = MoveGen::generateMoves(board);
+
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+        int file = (san.size() == 3) ? 6 : 2; // king ends on g or c
+        for (const Move& m: moves){
+            if ((moveFlags(m) & CASTLING) && toSq(m) % 8 == file) return MoveGen::isLegal(board, m) ? m : 0;
+        }
+        return 0;
+    }
+
+    // piece letter, pawns have none
+    int pieceType = WP;
+    const char pieceLetters[] = "PNBRQK";
+    for (int type = WN; type <= WK; type++) {
+        if (san[0] == pieceLetters[type]) pieceType = type;
+    }
+    if (pieceType != WP) san.remove_prefix(1);
+
+    // promotion piece, with or without the '='
+    int promotionType = 0;
+    if (!san.empty() && std::string_view("NBRQ").find(san.back()) != std::string_view::npos) {
+        promotionType = (int)std::string_view("PNBRQ").find(san.back());
+        san.remove_suffix(1);
+        if (!san.empty() && san.back() == '=') san.remove_suffix(1);
+    }
+
+    if (san.size() < 2) return 0;
+    int to = parseSquare(san[san.size() - 2], san[san.size() - 1]);
+    if (to < 0) return 0;
+    san.remove_suffix(2);
+
+    // what is left is the disambiguation file and/or rank and the capture mark
+    int fromFile = -1, fromRank = -1;
+    for (char c : san) {
+        if (c >= 'a' && c <= 'h') fromFile = c - 'a';
+        else if (c >= '1' && c <= '8') fromRank = c - '1';
+        else if (c != 'x' && c != ':') return 0;
+    }
+
+    Move found = 0;
+    for (const Move& m: moves){
+        if (toSq(m) != to || board.pieceOn(fromSq(m)) % 6 != pieceType) continue;
+        if (fromFile >= 0 && fromSq(m) % 8 != fromFile) continue;
+        if (fromRank >= 0 && fromSq(m) / 8 != fromRank) continue;
+
+        bool promotion = moveFlags(m) & PROMOTION;
+        if (promotion != (promotionType != 0) || (promotion && promo(m) % 6 != promotionType)) continue;
+        if (!MoveGen::isLegal(board, m)) continue;
+
+        if (found) return 0; // ambiguous
+        found = m;
+    }
+
+    return found;
+}
+
 void UCI::loop(){
     Board board;
     std::string line, token;
+    int threads = 1;
+
+    // last position command, a gui sends the whole game every move so only the new moves get played
+    std::string positionBase;
+    std::vector<std::string> positionMoves;
+    int evalCache = 4;
+
+    // opening book, played instead of searching while the position is in it
+    Book book;
+    bool ownBook = false;
+    bool bookBestMove = false;
 
     // get random seed number from time
     unsigned int seed = std::chrono::system_clock::now().time_since_epoch().count();
@@ -66,39 +171,143 @@ void UCI::loop(){
             std::cout << "option name Move Overhead type spin default 10 min 0 max 5000" << std::endl;
             std::cout << "option name Threads type spin default 1 min 1 max 128" << std::endl;
             std::cout << "option name Hash type spin default 16 min 1 max 2048" << std::endl;
+            std::cout << "option name EvalCache type spin default 4 min 0 max 1024" << std::endl;
+            std::cout << "option name UseNNUE type check default false" << std::endl;
+            std::cout << "option name EvalFile type string default <built-in>" << std::endl;
+            std::cout << "option name PerftHash type spin default 0 min 0 max 4096" << std::endl;
+            std::cout << "option name OwnBook type check default false" << std::endl;
+            std::cout << "option name BookFile type string default <empty>" << std::endl;
+            std::cout << "option name BookBestMove type check default false" << std::endl;
+            std::cout << "option name TablebasePath type string default <empty>" << std::endl;
+            std::cout << "option name TablebaseProbeLimit type spin default " << TB_MAX_PIECES << " min 0 max " << TB_MAX_PIECES << std::endl;
+            std::cout << "option name SyzygyPath type string default <empty>" << std::endl;
+            std::cout << "option name SyzygyProbeLimit type spin default " << SYZYGY_MAX_PIECES << " min 0 max " << SYZYGY_MAX_PIECES << std::endl;
 
             std::cout << "uciok" << std::endl;
         } else if (token == "setoption") {
-            continue; // TODO later perhaps
+            // setoption name <id> value <x>
+            std::string name, value;
+            ss >> token; // "name"
+            while (ss >> token && token != "value") name += (name.empty() ? "" : " ") + token;
+            while (ss >> token) value += (value.empty() ? "" : " ") + token;
+
+            // spin values are checked before anything is changed, a bad one is reported and ignored
+            int spin = 0;
+            bool isSpin = name == "Threads" || name == "PerftHash" || name == "EvalCache" || name == "TablebaseProbeLimit"
+                || name == "SyzygyProbeLimit";
+            if (isSpin) {
+                int min = (name == "Threads") ? 1 : 0;
+                int max = (name == "Threads") ? 128 : (name == "PerftHash") ? 4096 : (name == "EvalCache") ? 1024
+                    : (name == "SyzygyProbeLimit") ? SYZYGY_MAX_PIECES : TB_MAX_PIECES;
+                if (!parseValue(value, min, max, spin)) {
+                    std::cout << "info string error: invalid value " << value << " for " << name << std::endl;
+                    continue;
+                }
+            }
+
+            if (name == "Threads") {
+                threads = spin;
+            } else if (name == "PerftHash") {
+                Perft::setHashSize(spin);
+            } else if (name == "EvalCache") {
+                evalCache = spin;
+                Evaluation::setCacheSize(evalCache);
+            } else if (name == "UseNNUE") {
+                NNUE::setEnabled(value == "true");
+                Evaluation::clearCache();
+            } else if (name == "EvalFile") {
+                if (value.empty() || value == "<built-in>") {
+                    NNUE::useBuiltIn();
+                } else if (!NNUE::load(value)) {
+                    std::cout << "info string failed to load network " << value << ", keeping " << NNUE::networkName() << std::endl;
+                }
+                Evaluation::clearCache();
+                std::cout << "info string using network " << NNUE::networkName() << std::endl;
+            } else if (name == "OwnBook") {
+                ownBook = value == "true";
+            } else if (name == "BookBestMove") {
+                bookBestMove = value == "true";
+            } else if (name == "TablebasePath") {
+                // the engine's own tables (nice.exe tbgen), probed where no syzygy table covers a position
+                Tablebase::init(value == "<empty>" ? "" : value);
+            } else if (name == "TablebaseProbeLimit") {
+                Tablebase::setProbeLimit(spin);
+            } else if (name == "SyzygyPath") {
+                Syzygy::init(value == "<empty>" ? "" : value);
+            } else if (name == "SyzygyProbeLimit") {
+                Syzygy::setProbeLimit(spin);
+            } else if (name == "BookFile") {
+                if (value.empty() || value == "<empty>") {
+                    book.close();
+                } else {
+                    const char *error = "";
+                    if (book.open(value, &error)) {
+                        std::cout << "info string book " << value << " with " << book.size() << " entries" << std::endl;
+                    } else {
+                        std::cout << "info string error: failed to open book " << value << ": " << error << std::endl;
+                    }
+                }
+            }
         } else if (token == "isready") {
             std::cout << "readyok" << std::endl;
         } else if (token == "ucinewgame") {
             board = Board();
+            positionBase.clear();
+            positionMoves.clear();
         } else if (token == "position") {
-            ss >> token;
-
-            if (token == "startpos") {
-               board = Board();
-               ss >> token;
-            } else if (token == "fen") {
-                std::string fen;
-                while (ss >> token && token != "moves") {
-                    fen += token + " ";
-                }
-                board = Board(fen); 
+            std::string base;
+            while (ss >> token && token != "moves") {
+                base += token + " ";
             }
 
-            while (ss >> token){
-                if (token == "moves") continue;
-                Move m = parseMove(token, board);
+            std::vector<std::string> moves;
+            while (ss >> token) moves.push_back(token);
+
+            // the board still holds the last position, reuse it when the new move list extends the old one
+            bool extends = !positionBase.empty() && base == positionBase && moves.size() >= positionMoves.size()
+                && std::equal(positionMoves.begin(), positionMoves.end(), moves.begin());
+
+            size_t first = 0;
+            if (extends) {
+                first = positionMoves.size();
+            } else if (base.rfind("startpos", 0) == 0) {
+                board = Board();
+            } else if (base.rfind("fen ", 0) == 0) {
+                board = Board(base.substr(4));
+            } else {
+                continue;
+            }
+
+            for (size_t i = first; i < moves.size(); i++){
+                Move m = parseMove(moves[i], board);
                 if (m != 0) { // move is valid in current position 
                     board.makeMove(m);
                 }
             }
 
+            positionBase = base;
+            positionMoves = std::move(moves);
+
             //board.printBoard();
         } else if (token == "go") {
-            
+
+            // go perft <depth>: parallel divide with the Threads and PerftHash options
+            if (ss >> token && token == "perft") {
+                int depth = 1;
+                ss >> depth;
+                Perft::perftDivideParallel(board, depth, threads);
+                continue;
+            }
+
+            // a book move is answered straight away
+            if (ownBook && book.isOpen()) {
+                Move bookMove = book.probe(board, bookBestMove, g);
+                if (bookMove != 0) {
+                    std::cout << "bestmove " << moveToString(bookMove, board) << std::endl;
+                    continue;
+                }
+            }
+
             // find best move
             Move bestMove = Search::searchPosition(board, 7);
 
@@ -108,8 +317,40 @@ void UCI::loop(){
                 std::cout << "bestmove (none)" << std::endl; 
             }
 
+        } else if (token == "bench") {
+            // bench [depth] [threads] [hash]
+            int args[3] = {BENCH_DEPTH, 1, BENCH_HASH};
+            // same ranges as the Threads and EvalCache options, anything that isn't a number keeps the default
+            const int minArgs[3] = {1, 1, 0}, maxArgs[3] = {MAX_PLY, 128, 1024};
+            for (int i = 0; i < 3 && ss >> token; ++i) parseValue(token, minArgs[i], maxArgs[i], args[i]);
+
+            Bench::search(args[0], args[1], args[2]);
+            Evaluation::setCacheSize(evalCache);
         } else if (token == "print") {
             board.printBoard(); 
+        } else if (token == "evalstats") {
+            // how often the lazy evaluation skipped its later stages
+            const EvalStats &stats = Evaluation::stats();
+            double calls = (stats.calls > 0) ? (double)stats.calls : 1.0;
+
+            std::cout << "info string eval calls " << stats.calls
+                      << " skipped pawns " << stats.skippedPawns
+                      << " (" << 100.0 * stats.skippedPawns / calls << "%)"
+                      << " skipped mobility " << stats.skippedPawns + stats.skippedMobility
+                      << " (" << 100.0 * (stats.skippedPawns + stats.skippedMobility) / calls << "%)"
+                      << std::endl;
+
+            double probes = (stats.cacheProbes > 0) ? (double)stats.cacheProbes : 1.0;
+            std::cout << "info string eval cache probes " << stats.cacheProbes
+                      << " hits " << stats.cacheHits
+                      << " (" << 100.0 * stats.cacheHits / probes << "%)"
+                      << std::endl;
+        } else if (token == "debug") {
+            // debug stats prints the profiling table of a PROFILE=1 build, debug clear resets it (on/off are ignored)
+            std::string option;
+            ss >> option;
+            if (option == "stats") Profile::print(std::cout);
+            else if (option == "clear") Profile::clear();
         } else if (token == "quit"){
             break;
         } else if (token == "stop"){
@@ -2,6 +2,18 @@
 #define CHESS_UCI_HPP
 
 #include "Board.hpp"
+#include "Move.hpp"
+#include <string>
+#include <string_view>
+
+// converts engine moves into uci strings (e2e4, e7e8q)
+std::string moveToString(Move m, Board &board);
+
+// finds the legal move for a uci string without building strings, 0 if there is none
+Move parseMove(std::string_view moveString, const Board &board);
+
+// finds the legal move for standard algebraic notation (Nf3, exd5, e8=Q+, O-O), 0 if there is none or it is ambiguous
+Move parseSan(std::string_view san, const Board &board);
 
 class UCI {
     public:
@@ -0,0 +1,40 @@
+#ifndef CHESS_ZOBRIST_HPP
+#define CHESS_ZOBRIST_HPP
+
+#include "Types.hpp"
+
+// random keys used to hash a position, a position's key is the xor of the keys of everything on it
+struct ZobristKeys {
+    U64 pieces[12][64];
+    U64 castling[16]; // one key per castling rights bitmask
+    U64 enPassant[8]; // indexed by file of the en passant target
+    U64 side;         // xored in when black is to move
+};
+
+// xorshift64* generator so the keys are the same on every build and platform
+constexpr U64 nextZobristKey(U64 &state) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+constexpr ZobristKeys generateZobristKeys() {
+    ZobristKeys keys{};
+    U64 state = 0x4E4943454E494345ULL; // arbitrary non zero seed
+
+    for (int piece = 0; piece < 12; ++piece) {
+        for (int square = 0; square < 64; ++square) {
+            keys.pieces[piece][square] = nextZobristKey(state);
+        }
+    }
+    for (int i = 0; i < 16; ++i) keys.castling[i] = nextZobristKey(state);
+    for (int i = 0; i < 8; ++i) keys.enPassant[i] = nextZobristKey(state);
+    keys.side = nextZobristKey(state);
+
+    return keys;
+}
+
+inline constexpr ZobristKeys zobristKeys = generateZobristKeys();
+
+#endif
@@ -6,6 +6,18 @@
 #include "MoveGen.hpp"
 #include "Perft.hpp"
 #include "UCI.hpp"
+#include "Trainer.hpp"
+#include "Tuner.hpp"
+#include "Bench.hpp"
+#include "Analyze.hpp"
+#include "EpdTest.hpp"
+#include "Datagen.hpp"
+#include "DataTools.hpp"
+#include "Book.hpp"
+#include "Match.hpp"
+#include "Tablebase.hpp"
+#include "TbGen.hpp"
+#include "Parse.hpp"
 
 int main(int argc, char* argv[]) {
 
@@ -13,22 +25,106 @@ int main(int argc, char* argv[]) {
       UCI::loop();
       return 0;
     }
+
+    std::string mode = argv[1];
+
+    // nnue trainer: ./engine train data.txt [output.nnue] [options]
+    if (mode == "train") {
+      return Trainer::run(argc, argv);
+    }
+
+    // texel tuner: ./engine tune data.epd [EvalParams.hpp] [options]
+    if (mode == "tune") {
+      return Tuner::run(argc, argv);
+    }
+
+    // perft regression suite: ./engine perftsuite suite.epd [depth N] [threads N] [hash MB]
+    if (mode == "perftsuite") {
+      return Perft::runSuite(argc, argv);
+    }
+
+    // search benchmark and node count signature: ./engine bench [depth] [threads] [hash]
+    if (mode == "bench") {
+      return Bench::run(argc, argv);
+    }
+
+    // batched evaluation benchmark: ./engine evalbench [positions N] [threads N]
+    if (mode == "evalbench") {
+      return Bench::evalBatch(argc, argv);
+    }
+
+    // batch analysis of a fen/epd file: ./engine analyze positions.epd [output] [depth N] [nodes N] [movetime ms] [threads N] [format json|csv]
+    if (mode == "analyze") {
+      return Analyze::run(argc, argv);
+    }
+
+    // tactical suite with bm/am opcodes, reports time to solution: ./engine epdtest suite.epd [movetime ms] [nodes N] [depth N] [threads N]
+    if (mode == "epdtest") {
+      return EpdTest::run(argc, argv);
+    }
+
+    // self play training data as packed records: ./engine datagen prefix [games N] [threads N] [depth N] [nodes N] [plies N]
+    if (mode == "datagen") {
+      return Datagen::run(argc, argv);
+    }
+
+    // text <-> packed .bin training data: ./engine convert input output
+    if (mode == "convert") {
+      return DataTools::convert(argc, argv);
+    }
+
+    // external shuffle and dedupe of .bin data: ./engine shuffle output.bin input.bin... [memory MB] [threads N] [seed N]
+    if (mode == "shuffle") {
+      return DataTools::shuffle(argc, argv);
+    }
+
+    // polyglot opening book from pgn games: ./engine makebook games.pgn book.bin [depth N] [mingames N] [results all|wins|nolosses] [threads N]
+    if (mode == "makebook") {
+      return Book::make(argc, argv);
+    }
+
+    // engine vs engine games in one process with a live sprt: ./engine match openings.epd [games N] [concurrency N] [tc base+inc] [a.option value] [b.option value]
+    if (mode == "match") {
+      return Match::run(argc, argv);
+    }
+
+    // endgame tables by retrograde analysis: ./engine tbgen directory [tables all|3|4|KQvK,KRvK..] [threads N[,N..]]
+    if (mode == "tbgen") {
+      return TbGen::run(argc, argv);
+    }
+
+    // what the endgame tables know of positions: ./engine tbprobe directory fen [fen..]
+    if (mode == "tbprobe") {
+      return Tablebase::run(argc, argv);
+    }
     
     // Default to Start Position if no args provided (for quick testing)
     std::string fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
     int depth = 1;
+    int threads = 1;
 
     // optional commands for testing
-    // Usage: ./engine "FEN" depth
+    // Usage: ./engine "FEN" depth [--threads N] [--hash MB]
     if (argc >= 3) {
         fen = argv[1];
-        depth = std::stoi(argv[2]);
+        if (!parseOption("depth", argv[2], 1, PERFT_MAX_DEPTH, depth)) return 1;
+    }
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        bool valid = true;
+        if (option == "--threads") valid = parseOption(option, argv[i + 1], 1, 128, threads);
+        else if (option == "--hash") {
+            int hash = 0;
+            valid = parseOption(option, argv[i + 1], 0, 4096, hash);
+            if (valid) Perft::setHashSize(hash);
+        }
+        if (!valid) return 1;
     }
 
     Board board(fen);
     
     // Run the divide function (shows detail)
-    uint64_t result = Perft::perft(board, depth);
+    uint64_t result = Perft::perftParallel(board, depth, threads);
     // board.printBoard();
     // Perft::perftDivide(board, depth);
     
@@ -0,0 +1,75 @@
+import re
+import subprocess
+import sys
+import tempfile
+
+# --- CONFIGURATION ---
+# Path to your compiled executable.
+# Windows users: Change to "./engine.exe"
+ENGINE_PATH = "./nice.exe"
+
+# Known longest mates (plies, either side to move) of the generated tables
+LONGEST_MATES = {"KQvK": 20, "KRvK": 32}
+
+# Positions with what the tables must report for them
+PROBES = [
+    ("Rook mate in one", "k7/8/1K6/8/8/8/8/7R w - - 0 1", "win, mate in 1 plies"),
+    ("Only move, then mate", "k7/8/1K6/8/8/8/8/7R b - - 0 1", "loss, mated in 2 plies"),
+    ("Colours swapped", "K7/8/1k6/8/8/8/8/7r b - - 0 1", "win, mate in 1 plies"),
+    ("Stalemate", "k7/2Q5/1K6/8/8/8/8/8 b - - 0 1", "draw"),
+    ("Queen can be taken", "k7/1Q6/8/8/8/8/8/7K b - - 0 1", "draw"),
+    ("Bare kings", "8/8/8/8/8/8/8/K6k w - - 0 1", "draw"),
+    ("Fifty move rule", "k7/8/1K6/8/8/8/8/7R b - - 99 1", "loss, mated in 2 plies (too late for the fifty move rule)"),
+    ("Castling rights", "4k3/8/8/8/8/8/8/4K2R w K - 0 1", "not in the tables"),
+]
+
+# --- HELPER FUNCTIONS ---
+
+def run_engine(args):
+    result = subprocess.run([ENGINE_PATH] + args, capture_output=True, text=True, check=True)
+    return result.stdout
+
+def generate(directory):
+    """
+    Builds the tables with tbgen and checks the longest mate it reports for each.
+    """
+    print("==================================================")
+    print(f"TEST: tbgen {','.join(LONGEST_MATES)}")
+    output = run_engine(["tbgen", directory, "tables", ",".join(LONGEST_MATES), "threads", "2"])
+
+    passed = True
+    for table, expected in LONGEST_MATES.items():
+        match = re.search(rf"^{table}\b.*longest mate (\d+) plies", output, re.MULTILINE)
+        actual = int(match.group(1)) if match else None
+        ok = actual == expected
+        passed &= ok
+        print(f"{table}: longest mate {actual} plies, expected {expected} -> {'✅ PASS' if ok else '❌ FAIL'}")
+    return passed
+
+def probe(directory):
+    """
+    Probes the positions through tbprobe and compares every answer.
+    """
+    print("==================================================")
+    print("TEST: tbprobe")
+    output = run_engine(["tbprobe", directory] + [fen for _, fen, _ in PROBES])
+    answers = dict(line.rsplit(" : ", 1) for line in output.splitlines() if " : " in line)
+
+    passed = True
+    for name, fen, expected in PROBES:
+        actual = answers.get(fen)
+        ok = actual == expected
+        passed &= ok
+        print(f"{name}: {actual} -> {'✅ PASS' if ok else f'❌ FAIL (expected {expected})'}")
+    return passed
+
+# --- TEST SUITE ---
+
+if __name__ == "__main__":
+    with tempfile.TemporaryDirectory() as directory:
+        passed = generate(directory)
+        passed &= probe(directory)
+
+    print("==================================================")
+    print("RESULT: ✅ PASS" if passed else "RESULT: ❌ FAIL")
+    sys.exit(0 if passed else 1)
@@ -0,0 +1,270 @@
+// microbenchmarks of the board, move generation, attack and evaluation primitives
+// usage: microbench.exe [reps N] [warmup N] [save baseline.json] [compare baseline.json] [threshold percent]
+
+#include "../src/Board.hpp"
+#include "../src/MoveGen.hpp"
+#include "../src/Evaluation.hpp"
+#include "../src/BitUtils.hpp"
+#include "../src/Bench.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <cmath>
+#include <map>
+
+// a repetition runs the primitive over the corpus until it has taken at least this long
+#define MIN_REP_SECONDS 0.02
+
+struct Result {
+    std::string name;
+    double nsPerOp;
+    double stddev;    // of ns/op between repetitions
+    double opsPerSec;
+};
+
+// the bench positions and every position one legal move away from them
+struct Corpus {
+    std::vector<Board> boards;
+    std::vector<std::vector<Move>> moves;  // pseudo legal moves of each board
+    std::vector<std::string> fens;
+    size_t moveCount = 0;
+};
+
+static Corpus buildCorpus() {
+    Corpus corpus;
+
+    for (const std::string &fen : Bench::positions()) {
+        Board root(fen);
+        corpus.boards.push_back(root);
+        corpus.fens.push_back(fen);
+
+        for (Move move : MoveGen::generateLegalMoves(root)) {
+            Board child = root;
+            child.makeMove(move);
+            corpus.boards.push_back(child);
+        }
+    }
+
+    for (const Board &board : corpus.boards) {
+        corpus.moves.push_back(MoveGen::generateMoves(board));
+        corpus.moveCount += corpus.moves.back().size();
+    }
+
+    return corpus;
+}
+
+// keeps the compiler from dropping the work
+static volatile uint64_t sink;
+
+static void keep(uint64_t value) {
+    sink = value;
+}
+
+// pass runs the primitive once over the corpus and returns how many operations that was
+static Result measure(const std::string &name, int warmup, int reps, const std::function<size_t()> &pass) {
+    for (int i = 0; i < warmup; ++i) pass();
+
+    // enough passes per repetition that timer resolution doesn't matter
+    int passes = 1;
+    while (true) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < passes; ++i) pass();
+        if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= MIN_REP_SECONDS) break;
+        passes *= 2;
+    }
+
+    std::vector<double> samples;
+    for (int r = 0; r < reps; ++r) {
+        size_t ops = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < passes; ++i) ops += pass();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        samples.push_back(seconds * 1e9 / ops);
+    }
+
+    double mean = 0;
+    for (double s : samples) mean += s;
+    mean /= samples.size();
+
+    double variance = 0;
+    for (double s : samples) variance += (s - mean) * (s - mean);
+    variance /= std::max<size_t>(1, samples.size() - 1);
+
+    return Result{name, mean, std::sqrt(variance), 1e9 / mean};
+}
+
+static std::vector<Result> runAll(const Corpus &corpus, int warmup, int reps) {
+    std::vector<Result> results;
+
+    results.push_back(measure("Board(fen)", warmup, reps, [&] {
+        for (const std::string &fen : corpus.fens) {
+            Board board(fen);
+            keep(board.getHash());
+        }
+        return corpus.fens.size();
+    }));
+
+    results.push_back(measure("Board::setFen", warmup, reps, [&] {
+        Board board;
+        for (const std::string &fen : corpus.fens) {
+            board.setFen(fen);
+            keep(board.getHash());
+        }
+        return corpus.fens.size();
+    }));
+
+    results.push_back(measure("Board::toFen", warmup, reps, [&] {
+        char fen[MAX_FEN_LENGTH];
+        for (const Board &board : corpus.boards) keep(board.toFen(fen));
+        return corpus.boards.size();
+    }));
+
+    results.push_back(measure("Board::makeMove", warmup, reps, [&] {
+        for (size_t i = 0; i < corpus.boards.size(); ++i) {
+            for (Move move : corpus.moves[i]) {
+                Board child = corpus.boards[i];
+                child.makeMove(move);
+                keep(child.getHash());
+            }
+        }
+        return corpus.moveCount;
+    }));
+
+    results.push_back(measure("MoveGen::generateMoves", warmup, reps, [&] {
+        for (const Board &board : corpus.boards) keep(MoveGen::generateMoves(board).size());
+        return corpus.boards.size();
+    }));
+
+    results.push_back(measure("MoveGen::generateLegalMoves", warmup, reps, [&] {
+        for (const Board &board : corpus.boards) keep(MoveGen::generateLegalMoves(board).size());
+        return corpus.boards.size();
+    }));
+
+    results.push_back(measure("MoveGen::countLegalMoves", warmup, reps, [&] {
+        for (const Board &board : corpus.boards) keep(MoveGen::countLegalMoves(board));
+        return corpus.boards.size();
+    }));
+
+    // every square of every position, by both colours
+    results.push_back(measure("MoveGen::isSquareAttacked", warmup, reps, [&] {
+        for (const Board &board : corpus.boards) {
+            for (int square = 0; square < 64; ++square) {
+                keep(MoveGen::isSquareAttacked(board, square, WHITE) + MoveGen::isSquareAttacked(board, square, BLACK));
+            }
+        }
+        return corpus.boards.size() * 128;
+    }));
+
+    // without the eval cache, every call runs all three stages
+    Evaluation::setCacheSize(0);
+    std::vector<Board> boards = corpus.boards;
+    results.push_back(measure("Evaluation::evaluate", warmup, reps, [&] {
+        for (Board &board : boards) keep(Evaluation::evaluate(board));
+        return boards.size();
+    }));
+
+    return results;
+}
+
+static bool saveBaseline(const std::string &path, const std::vector<Result> &results) {
+    std::ofstream out(path);
+    out << "{\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        out << "    {\"name\": \"" << results[i].name << "\", \"nsPerOp\": " << results[i].nsPerOp
+            << ", \"stddev\": " << results[i].stddev << ", \"opsPerSec\": " << results[i].opsPerSec << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return (bool)out;
+}
+
+// reads back the entries written by saveBaseline (ops/s is recomputed)
+static bool loadBaseline(const std::string &path, std::map<std::string, Result> &baseline) {
+    std::ifstream in(path);
+    if (!in) return false;
+
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t name = line.find("\"name\": \"");
+        size_t ns = line.find("\"nsPerOp\": ");
+        size_t stddev = line.find("\"stddev\": ");
+        if (name == std::string::npos || ns == std::string::npos || stddev == std::string::npos) continue;
+
+        name += 9;
+        Result result;
+        result.name = line.substr(name, line.find('"', name) - name);
+        result.nsPerOp = std::stod(line.substr(ns + 11));
+        result.stddev = std::stod(line.substr(stddev + 10));
+        result.opsPerSec = 1e9 / result.nsPerOp;
+        baseline[result.name] = result;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int reps = 10;
+    int warmup = 2;
+    double threshold = 5.0; // percent slower than the baseline that counts as a regression (if it is also above the noise)
+    std::string savePath, comparePath;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string name = argv[i];
+        std::string value = argv[i + 1];
+
+        if (name == "reps") reps = std::max(2, std::stoi(value));
+        else if (name == "warmup") warmup = std::stoi(value);
+        else if (name == "save") savePath = value;
+        else if (name == "compare") comparePath = value;
+        else if (name == "threshold") threshold = std::stod(value);
+        else std::cout << "unknown option " << name << std::endl;
+    }
+
+    std::map<std::string, Result> baseline;
+    if (!comparePath.empty() && !loadBaseline(comparePath, baseline)) {
+        std::cout << "could not read " << comparePath << std::endl;
+        return 1;
+    }
+
+    Corpus corpus = buildCorpus();
+    std::cout << "corpus: " << corpus.boards.size() << " positions, " << corpus.moveCount << " moves, "
+              << reps << " repetitions" << std::endl;
+
+    std::vector<Result> results = runAll(corpus, warmup, reps);
+
+    int regressions = 0;
+    for (const Result &result : results) {
+        char line[200];
+        std::snprintf(line, sizeof(line), "%-28s %10.2f ns/op  +- %6.2f  %14.0f ops/s",
+                      result.name.c_str(), result.nsPerOp, result.stddev, result.opsPerSec);
+        std::cout << line;
+
+        auto base = baseline.find(result.name);
+        if (base != baseline.end()) {
+            // slower by more than the threshold and by more than the noise of both runs
+            double difference = result.nsPerOp - base->second.nsPerOp;
+            double noise = 2.0 * std::sqrt(result.stddev * result.stddev + base->second.stddev * base->second.stddev);
+            double change = 100.0 * difference / base->second.nsPerOp;
+            bool regressed = change > threshold && difference > noise;
+            regressions += regressed;
+
+            std::snprintf(line, sizeof(line), "  %+6.1f%%%s", change, regressed ? "  REGRESSION" : "");
+            std::cout << line;
+        }
+        std::cout << std::endl;
+    }
+
+    if (!savePath.empty()) {
+        if (!saveBaseline(savePath, results)) {
+            std::cout << "could not write " << savePath << std::endl;
+            return 1;
+        }
+        std::cout << "wrote " << savePath << std::endl;
+    }
+
+    return regressions ? 1 : 0;
+}